@@ -3,6 +3,9 @@
 //
 
 #include <span>
+#include <fstream>
+#include <sstream>
+#include <iostream>
 
 #include <cxxopts.hpp>
 
@@ -12,11 +15,17 @@
 #include <base/pipeline.h>
 
 #include <util/ies.h>
+#include <util/image_cache.h>
 
 [[nodiscard]] auto parse_cli_options(int argc, const char *const *argv) noexcept {
     cxxopts::Options cli{"megakernel_path_tracing"};
     cli.add_option("", "b", "backend", "Compute backend name", cxxopts::value<luisa::string>(), "<backend>");
     cli.add_option("", "d", "device", "Compute device index", cxxopts::value<uint32_t>()->default_value("0"), "<index>");
+    cli.add_option("", "", "texture-cache", "Cache converted textures on disk in the directory (disabled by default)", cxxopts::value<std::filesystem::path>(), "<dir>");
+    cli.add_option("", "", "texture-cache-size", "Texture cache capacity in MiB, least recently used entries are evicted beyond", cxxopts::value<uint32_t>()->default_value("4096"), "<size>");
+    cli.add_option("", "", "build-stats", "Print per-mesh geometry build statistics (measures BLAS build times)", cxxopts::value<bool>()->default_value("false"));
+    cli.add_option("", "", "build-stats-json", "Dump geometry build statistics as JSON to the file", cxxopts::value<std::filesystem::path>(), "<file>");
+    cli.add_option("", "", "server", "Keep the scene loaded and serve render/update requests read line by line from stdin", cxxopts::value<bool>()->default_value("false"));
     cli.add_option("", "", "scene", "Path to scene description file", cxxopts::value<std::filesystem::path>(), "<file>");
     cli.allow_unrecognised_options();
     cli.parse_positional("scene");
@@ -51,6 +60,170 @@ using namespace luisa;
 using namespace luisa::compute;
 using namespace luisa::render;
 
+// Serves requests from stdin, one per line, until `quit` or end of input:
+//   render [camera <index>] [spp <n>] [output <file>]
+//   update <file>
+//   stats
+//   quit
+// Each request is answered with a single line starting with `ok` or `error`
+// on stdout. The device, scene, pipeline and compiled kernels are kept alive
+// across requests so that only the first render pays for loading the scene.
+// Note that update files are only checked for syntax, references and tags
+// before being applied: an unknown plugin or an invalid property value is
+// still fatal when the updated nodes are created, as it is on scene loading.
+void serve(Stream &stream, SceneDesc &scene_desc, Scene &scene,
+           luisa::unique_ptr<Pipeline> &pipeline,
+           const luisa::function<luisa::unique_ptr<Pipeline>()> &recreate_pipeline) noexcept {
+
+    auto reply = [](bool ok, luisa::string_view message) noexcept {
+        std::cout << (ok ? "ok" : "error");
+        if (!message.empty()) { std::cout << " " << message; }
+        std::cout << std::endl;
+    };
+
+    // films abort on unsupported or unwritable outputs, so they are checked here
+    auto check_output = [](const std::filesystem::path &file) noexcept -> luisa::string {
+        auto ext = file.extension().string();
+        for (auto &c : ext) { c = static_cast<char>(tolower(c)); }
+        if (ext != ".exr") {
+            return luisa::format("unsupported output extension '{}' (expected .exr)", ext);
+        }
+        auto folder = file.parent_path();
+        if (folder.empty()) { folder = std::filesystem::current_path(); }
+        if (std::error_code ec; !std::filesystem::is_directory(folder, ec)) {
+            return luisa::format("output directory '{}' does not exist", folder.string());
+        }
+        std::error_code ec;
+        auto existed = std::filesystem::exists(file, ec);
+        if (std::ofstream probe{file, std::ios::binary | std::ios::app}; !probe) {
+            return luisa::format("output file '{}' is not writable", file.string());
+        }
+        if (!existed) { std::filesystem::remove(file, ec); }
+        return {};
+    };
+
+    auto render_count = 0u;
+    auto update_count = 0u;
+    auto last_render_time = 0.0;
+    LUISA_INFO("Render server ready with {} camera(s).", pipeline->camera_count());
+    for (std::string line; std::getline(std::cin, line);) {
+        std::istringstream iss{line};
+        std::string command;
+        if (!(iss >> command)) { continue; }
+        if (command == "quit") {
+            reply(true, "bye");
+            break;
+        }
+        if (command == "stats") {
+            reply(true, luisa::format(
+                            "cameras {} renders {} updates {} "
+                            "kernel_generation {} last_render_ms {}",
+                            pipeline->camera_count(), render_count, update_count,
+                            pipeline->kernel_generation(), last_render_time));
+            continue;
+        }
+        if (command == "update") {
+            std::string file;
+            if (!(iss >> file)) {
+                reply(false, "missing update file");
+                continue;
+            }
+            std::filesystem::path update_path{file};
+            if (std::error_code ec; !std::filesystem::exists(update_path, ec)) {
+                reply(false, luisa::format("update file '{}' not found", file));
+                continue;
+            }
+            // malformed updates are rejected before the description is changed;
+            // plugins and property values are only resolved by the scene below
+            if (auto error = SceneParser::check_update(scene_desc, update_path)) {
+                reply(false, luisa::format("invalid update file '{}': {}", file, *error));
+                continue;
+            }
+            Clock clock;
+            auto descs = SceneParser::parse_update(scene_desc, update_path);
+            // the scene is only changed if the pipeline can follow in place...
+            auto replacements = scene.try_update(descs, [&pipeline](auto r) noexcept {
+                return pipeline->can_update(r);
+            });
+            auto in_place = replacements.has_value();
+            if (in_place) {
+                auto command_buffer = stream.command_buffer();
+                static_cast<void>(pipeline->update(command_buffer, *replacements));
+                command_buffer << compute::commit();
+                stream << compute::synchronize();
+            } else {
+                // ...otherwise both are re-created from the updated description
+                LUISA_INFO("Scene update cannot be applied in place. Re-creating the pipeline.");
+                pipeline = nullptr;
+                replacements = scene.update(descs);
+                pipeline = recreate_pipeline();
+            }
+            update_count++;
+            reply(true, luisa::format(
+                            "nodes {} in_place {} ms {}",
+                            replacements->size(), in_place, clock.toc()));
+            continue;
+        }
+        if (command == "render") {
+            luisa::optional<uint> camera_index;
+            luisa::optional<uint> spp;
+            luisa::optional<std::filesystem::path> output;
+            luisa::string error;
+            for (std::string key; error.empty() && iss >> key;) {
+                if (key == "camera") {
+                    if (uint i; iss >> i && i < pipeline->camera_count()) {
+                        camera_index = i;
+                    } else {
+                        error = "invalid camera index";
+                    }
+                } else if (key == "spp") {
+                    if (uint n; iss >> n && n != 0u) {
+                        spp = n;
+                    } else {
+                        error = "invalid spp";
+                    }
+                } else if (key == "output") {
+                    if (std::string f; iss >> f) {
+                        output = std::filesystem::path{f};
+                    } else {
+                        error = "missing output file";
+                    }
+                } else {
+                    error = luisa::format("unknown render option '{}'", key);
+                }
+            }
+            if (output && !camera_index && pipeline->camera_count() > 1u) {
+                error = "output requires a camera index when the scene has multiple cameras";
+            }
+            if (error.empty() && output) { error = check_output(*output); }
+            if (!error.empty()) {
+                reply(false, error);
+                continue;
+            }
+            for (auto i = 0u; i < pipeline->camera_count(); i++) {
+                auto camera = std::get<0>(pipeline->camera(i));
+                camera->set_enabled(!camera_index || *camera_index == i);
+                camera->set_spp(spp);
+                camera->set_file(output);
+            }
+            Clock clock;
+            pipeline->render(stream);
+            stream.synchronize();
+            last_render_time = clock.toc();
+            for (auto i = 0u; i < pipeline->camera_count(); i++) {
+                auto camera = std::get<0>(pipeline->camera(i));
+                camera->set_enabled(true);
+                camera->set_spp(luisa::nullopt);
+                camera->set_file(luisa::nullopt);
+            }
+            render_count++;
+            reply(true, luisa::format("ms {}", last_render_time));
+            continue;
+        }
+        reply(false, luisa::format("unknown command '{}'", command));
+    }
+}
+
 int main(int argc, char *argv[]) {
 
     log_level_info();
@@ -91,9 +264,41 @@ int main(int argc, char *argv[]) {
         "file '{}' in {} ms.",
         path.string(), clock.toc());
 
+    // textures start loading while the scene is created, so the cache has to be set up before
+    if (options["texture-cache"].count() != 0u) {
+        ImageCache::set_disk_cache(
+            options["texture-cache"].as<std::filesystem::path>(),
+            static_cast<size_t>(options["texture-cache-size"].as<uint32_t>()) << 20u);
+    }
     auto scene = Scene::create(context, scene_desc.get());
     auto stream = device.create_stream();
-    auto pipeline = Pipeline::create(device, stream, *scene);
+    auto print_build_stats = options["build-stats"].as<bool>();
+    auto build_stats_json = options["build-stats-json"].count() == 0u ?
+                                std::filesystem::path{} :
+                                options["build-stats-json"].as<std::filesystem::path>();
+    auto pipeline = Pipeline::create(
+        device, stream, *scene,
+        print_build_stats || !build_stats_json.empty());
+    if (print_build_stats) {
+        LUISA_INFO("Geometry build statistics:\n{}", pipeline->build_stats().table());
+    }
+    if (!build_stats_json.empty()) {
+        if (std::ofstream file{build_stats_json}; file) {
+            file << pipeline->build_stats().json();
+        } else [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Failed to write build statistics to '{}'.",
+                build_stats_json.string());
+        }
+    }
+    if (options["server"].as<bool>()) {
+        serve(stream, *scene_desc, *scene, pipeline, [&] {
+            return Pipeline::create(
+                device, stream, *scene,
+                print_build_stats || !build_stats_json.empty());
+        });
+        return 0;
+    }
     pipeline->render(stream);
     stream.synchronize();
 }
@@ -0,0 +1,146 @@
+#include <cmath>
+#include <array>
+#include <limits>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+#include <core/clock.h>
+#include <util/half.h>
+#include <util/imageio.h>
+#include <util/spectrum.h>
+#include <util/texel_conversion.h>
+
+using namespace luisa;
+using namespace luisa::compute;
+using namespace luisa::render;
+
+// Compares the conversion of color textures to spectrum coefficients before
+// convert_texels() (serial, one luisa::function call per texel) with the
+// current chunked conversion on random images:
+//   luisa-render-texel-bench [<width> [<height> [<repeats>]]]
+
+namespace {
+
+// the conversion loop of ColorTexture before convert_texels()
+void convert_serial(LoadedImage &image, luisa::string_view encoding, float3 gamma) noexcept {
+    auto process = [&]() -> luisa::function<float3(float3)> {
+        auto rgb2spec = [](auto p) noexcept {
+            auto rsp = RGB2SpectrumTable::srgb().decode_albedo(p);
+            return make_float3(rsp.x, rsp.y, rsp.z);
+        };
+        if (encoding == "srgb") {
+            return [rgb2spec](auto p) noexcept {
+                auto s2l = [](auto x) noexcept {
+                    return x <= 0.04045f ?
+                               x * (1.0f / 12.92f) :
+                               std::pow((x + 0.055f) * (1.0f / 1.055f), 2.4f);
+                };
+                return rgb2spec(make_float3(s2l(p.x), s2l(p.y), s2l(p.z)));
+            };
+        }
+        if (encoding == "gamma") {
+            return [rgb2spec, g = gamma](auto p) noexcept {
+                return rgb2spec(make_float3(
+                    std::pow(p.x, g.x), std::pow(p.y, g.y), std::pow(p.z, g.z)));
+            };
+        }
+        return rgb2spec;
+    }();
+    auto n = static_cast<size_t>(image.size().x) * image.size().y;
+    if (image.pixel_storage() == PixelStorage::HALF4) {
+        auto pixels = static_cast<std::array<uint16_t, 4u> *>(image.pixels());
+        for (auto i = 0u; i < n; i++) {
+            auto [x, y, z, _] = pixels[i];
+            auto rsp = process(make_float3(half_to_float(x), half_to_float(y), half_to_float(z)));
+            pixels[i][0] = float_to_half(rsp.x);
+            pixels[i][1] = float_to_half(rsp.y);
+            pixels[i][2] = float_to_half(rsp.z);
+        }
+    } else {
+        auto pixels = static_cast<float4 *>(image.pixels());
+        for (auto i = 0u; i < n; i++) {
+            auto p = pixels[i];
+            pixels[i] = make_float4(process(make_float3(p.x, p.y, p.z)), p.w);
+        }
+    }
+}
+
+void convert_chunked(LoadedImage &image, luisa::string_view encoding, float3 gamma) noexcept {
+    auto rgb2spec = RGB2SpectrumTable::srgb();
+    auto convert = [&](const auto &decode) noexcept {
+        convert_texels(image, decode, [&rgb2spec](float3 linear, float alpha, size_t) noexcept {
+            return make_float4(rgb2spec.decode_albedo(linear), alpha);
+        });
+    };
+    if (encoding == "srgb") {
+        convert(SRGBTexelDecoder{});
+    } else if (encoding == "gamma") {
+        convert(GammaTexelDecoder{gamma});
+    } else {
+        convert(LinearTexelDecoder{});
+    }
+}
+
+[[nodiscard]] LoadedImage random_image(uint2 size, PixelStorage storage, uint seed) noexcept {
+    auto image = LoadedImage::create(size, storage);
+    std::mt19937 rng{seed};
+    std::uniform_real_distribution<float> dist{0.0f, 1.0f};
+    auto n = static_cast<size_t>(size.x) * size.y * 4u;
+    if (storage == PixelStorage::HALF4) {
+        auto texels = static_cast<uint16_t *>(image.pixels());
+        for (auto i = 0u; i < n; i++) { texels[i] = static_cast<uint16_t>(float_to_half(dist(rng))); }
+    } else {
+        auto texels = static_cast<float *>(image.pixels());
+        for (auto i = 0u; i < n; i++) { texels[i] = dist(rng); }
+    }
+    return image;
+}
+
+[[nodiscard]] float max_difference(const LoadedImage &a, const LoadedImage &b) noexcept {
+    auto n = static_cast<size_t>(a.size().x) * a.size().y * 4u;
+    auto diff = 0.0f;
+    if (a.pixel_storage() == PixelStorage::HALF4) {
+        auto pa = static_cast<const uint16_t *>(a.pixels());
+        auto pb = static_cast<const uint16_t *>(b.pixels());
+        for (auto i = 0u; i < n; i++) { diff = std::max(diff, std::abs(half_to_float(pa[i]) - half_to_float(pb[i]))); }
+    } else {
+        auto pa = static_cast<const float *>(a.pixels());
+        auto pb = static_cast<const float *>(b.pixels());
+        for (auto i = 0u; i < n; i++) { diff = std::max(diff, std::abs(pa[i] - pb[i])); }
+    }
+    return diff;
+}
+
+}// namespace
+
+int main(int argc, char *argv[]) {
+    auto width = argc > 1 ? static_cast<uint>(std::stoul(argv[1])) : 4096u;
+    auto height = argc > 2 ? static_cast<uint>(std::stoul(argv[2])) : width;
+    auto repeats = argc > 3 ? std::max(static_cast<uint>(std::stoul(argv[3])), 1u) : 3u;
+    auto size = make_uint2(width, height);
+    auto gamma = make_float3(2.2f);
+    std::cout << "storage encoding serial_ms chunked_ms speedup max_diff\n";
+    for (auto storage : {PixelStorage::HALF4, PixelStorage::FLOAT4}) {
+        for (auto encoding : {"linear", "srgb", "gamma"}) {
+            // best of `repeats` runs, each on a fresh copy of the same image
+            auto best_serial = std::numeric_limits<double>::max();
+            auto best_chunked = std::numeric_limits<double>::max();
+            auto diff = 0.0f;
+            for (auto r = 0u; r < repeats; r++) {
+                auto serial = random_image(size, storage, r);
+                auto chunked = random_image(size, storage, r);
+                Clock clock;
+                convert_serial(serial, encoding, gamma);
+                best_serial = std::min(best_serial, clock.toc());
+                clock.tic();
+                convert_chunked(chunked, encoding, gamma);
+                best_chunked = std::min(best_chunked, clock.toc());
+                diff = std::max(diff, max_difference(serial, chunked));
+            }
+            std::cout << (storage == PixelStorage::HALF4 ? "half4" : "float4") << " "
+                      << encoding << " " << best_serial << " " << best_chunked << " "
+                      << best_serial / best_chunked << " " << diff << "\n";
+        }
+    }
+}
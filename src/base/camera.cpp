@@ -140,9 +140,13 @@ auto Camera::shutter_weight(float time) const noexcept -> float {
 }
 
 auto Camera::shutter_samples() const noexcept -> vector<ShutterSample> {
+    return shutter_samples(_spp);
+}
+
+auto Camera::shutter_samples(uint spp) const noexcept -> vector<ShutterSample> {
     if (_shutter_span.x == _shutter_span.y) {
         ShutterPoint sp{_shutter_span.x, 1.0f};
-        return {ShutterSample{sp, _spp}};
+        return {ShutterSample{sp, spp}};
     }
     auto duration = _shutter_span.y - _shutter_span.x;
     auto inv_n = 1.0f / static_cast<float>(_shutter_samples);
@@ -160,8 +164,8 @@ auto Camera::shutter_samples() const noexcept -> vector<ShutterSample> {
     luisa::vector<uint> indices(_shutter_samples);
     std::iota(indices.begin(), indices.end(), 0u);
     std::shuffle(indices.begin(), indices.end(), random);
-    auto remainder = _spp % _shutter_samples;
-    auto samples_per_bucket = _spp / _shutter_samples;
+    auto remainder = spp % _shutter_samples;
+    auto samples_per_bucket = spp / _shutter_samples;
     for (auto i = 0u; i < remainder; i++) { buckets[indices[i]].spp = samples_per_bucket + 1u; }
     for (auto i = remainder; i < _shutter_samples; i++) { buckets[indices[i]].spp = samples_per_bucket; }
     auto sum_weights = std::accumulate(buckets.cbegin(), buckets.cend(), 0.0, [](auto lhs, auto rhs) noexcept {
@@ -173,7 +177,7 @@ auto Camera::shutter_samples() const noexcept -> vector<ShutterSample> {
             "Falling back to uniform shutter curve.");
         for (auto &s : buckets) { s.point.weight = 1.0f; }
     } else {
-        auto scale = _spp / sum_weights;
+        auto scale = spp / sum_weights;
         for (auto &s : buckets) {
             s.point.weight = static_cast<float>(s.point.weight * scale);
         }
@@ -181,4 +185,16 @@ auto Camera::shutter_samples() const noexcept -> vector<ShutterSample> {
     return buckets;
 }
 
+uint Camera::Instance::spp() const noexcept {
+    return _spp.value_or(_camera->spp());
+}
+
+std::filesystem::path Camera::Instance::file() const noexcept {
+    return _file.value_or(_camera->file());
+}
+
+luisa::vector<Camera::ShutterSample> Camera::Instance::shutter_samples() const noexcept {
+    return _camera->shutter_samples(spp());
+}
+
 }// namespace luisa::render
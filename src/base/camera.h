@@ -29,29 +29,43 @@ public:
         Float weight;
     };
 
+    struct ShutterPoint {
+        float time;
+        float weight;
+    };
+
+    struct ShutterSample {
+        ShutterPoint point;
+        uint spp;
+    };
+
     class Instance {
 
     private:
         const Camera *_camera;
+        // per-job overrides of the node settings (e.g., from the render server)
+        luisa::optional<uint> _spp;
+        luisa::optional<std::filesystem::path> _file;
+        bool _enabled{true};
 
     public:
         explicit Instance(const Camera *camera) noexcept : _camera{camera} {}
         virtual ~Instance() noexcept = default;
         [[nodiscard]] auto node() const noexcept { return _camera; }
+        [[nodiscard]] uint spp() const noexcept;
+        [[nodiscard]] std::filesystem::path file() const noexcept;
+        [[nodiscard]] luisa::vector<ShutterSample> shutter_samples() const noexcept;
+        [[nodiscard]] auto enabled() const noexcept { return _enabled; }
+        void set_spp(luisa::optional<uint> spp) noexcept { _spp = spp; }
+        void set_file(luisa::optional<std::filesystem::path> file) noexcept { _file = std::move(file); }
+        void set_enabled(bool enabled) noexcept { _enabled = enabled; }
 
         // generate ray in camera space, should not consider _filter and/or _transform
         [[nodiscard]] virtual Sample generate_ray(
             Sampler::Instance &sampler, Expr<float2> pixel, Expr<float> time) const noexcept = 0;
-    };
-
-    struct ShutterPoint {
-        float time;
-        float weight;
-    };
-
-    struct ShutterSample {
-        ShutterPoint point;
-        uint spp;
+        // approximate angle subtended by a pixel, which is the spread of the ray
+        // cones used for texture filtering; zero disables texture LOD selection
+        [[nodiscard]] virtual float pixel_spread_angle() const noexcept { return 0.0f; }
     };
 
 private:
@@ -72,6 +86,7 @@ public:
     [[nodiscard]] auto shutter_span() const noexcept { return _shutter_span; }
     [[nodiscard]] auto shutter_weight(float time) const noexcept -> float;
     [[nodiscard]] auto shutter_samples() const noexcept -> luisa::vector<ShutterSample>;
+    [[nodiscard]] auto shutter_samples(uint spp) const noexcept -> luisa::vector<ShutterSample>;
     [[nodiscard]] auto spp() const noexcept { return _spp; }
     [[nodiscard]] auto file() const noexcept { return _file; }
     [[nodiscard]] virtual luisa::unique_ptr<Instance> build(
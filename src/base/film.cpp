@@ -2,6 +2,7 @@
 // Created by Mike on 2021/12/14.
 //
 
+#include <luisa-compute.h>
 #include <base/film.h>
 
 namespace luisa::render {
@@ -11,6 +12,68 @@ Film::Film(Scene *scene, const SceneNodeDesc *desc) noexcept
       _resolution{desc->property_uint2_or_default(
           "resolution", lazy_construct([desc] {
               return make_uint2(desc->property_uint_or_default("resolution", 1024u));
-          }))} {}
+          }))},
+      _tile_size{desc->property_uint2_or_default(
+          "tile_size", lazy_construct([desc] {
+              return make_uint2(desc->property_uint_or_default("tile_size", 0u));
+          }))} {
+    // a zero tile size disables tiling
+    if (_tile_size.x == 0u || _tile_size.y == 0u) {
+        _tile_size = _resolution;
+    } else {
+        _tile_size = min(_tile_size, _resolution);
+    }
+}
+
+void Film::Instance::save(Stream &stream, const std::filesystem::path &path) const noexcept {
+    save_async(stream, path).wait();
+}
+
+std::shared_future<void> Film::Instance::save_async(Stream &stream, const std::filesystem::path &path) const noexcept {
+    if (_film->is_tiled()) [[unlikely]] {
+        LUISA_ERROR_WITH_LOCATION(
+            "Tiled film cannot be saved as a whole. "
+            "Use save_tile() for each tile instead.");
+    }
+    auto framebuffer = luisa::make_shared<luisa::vector<float4>>(framebuffer_size());
+    auto command_buffer = stream.command_buffer();
+    download(command_buffer, framebuffer->data());
+    command_buffer << compute::commit();
+    stream << compute::synchronize();
+    return ThreadPool::global().async([this, framebuffer, path] {
+        Clock clock;
+        write(path, framebuffer->data());
+        LUISA_INFO("Saved image '{}' in {} ms.", path.string(), clock.toc());
+    });
+}
+
+void Film::Instance::begin_tile(CommandBuffer &command_buffer, uint2 offset, uint2 extent) noexcept {
+    _tile_offset = offset;
+    _tile_extent = extent;
+    clear(command_buffer);
+}
+
+void Film::Instance::save_tile(Stream &stream) const noexcept {
+    luisa::vector<float4> framebuffer(framebuffer_size());
+    auto command_buffer = stream.command_buffer();
+    download(command_buffer, framebuffer.data());
+    command_buffer << compute::commit();
+    stream << compute::synchronize();
+    write_tile(_tile_offset, _tile_extent, framebuffer.data());
+}
+
+void Film::Instance::begin_tiled_output(const std::filesystem::path &path) noexcept {
+    LUISA_ERROR_WITH_LOCATION(
+        "Film '{}' does not support tiled output.",
+        _film->impl_type());
+}
+
+void Film::Instance::write_tile(uint2, uint2, const float4 *) const noexcept {
+    LUISA_ERROR_WITH_LOCATION(
+        "Film '{}' does not support tiled output.",
+        _film->impl_type());
+}
+
+void Film::Instance::end_tiled_output() noexcept {}
 
 }// namespace luisa::render
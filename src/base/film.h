@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <future>
+
 #include <util/spectrum.h>
 #include <base/scene_node.h>
 
@@ -17,24 +19,86 @@ public:
     private:
         const Pipeline &_pipeline;
         const Film *_film;
+        uint2 _tile_offset;
+        uint2 _tile_extent;
 
     public:
         explicit Instance(const Pipeline &pipeline, const Film *film) noexcept
-            : _pipeline{pipeline}, _film{film} {}
+            : _pipeline{pipeline}, _film{film},
+              _tile_offset{}, _tile_extent{film->tile_size()} {}
         virtual ~Instance() noexcept = default;
         [[nodiscard]] auto node() const noexcept { return _film; }
         [[nodiscard]] auto &pipeline() const noexcept { return _pipeline; }
+        // pixels are relative to the current tile, see begin_tile()
         virtual void accumulate(Expr<uint2> pixel, Expr<float3> rgb) const noexcept = 0;// TODO: spectrum
+        // clears the current tile; pixels outside tile_extent() are left inactive
         virtual void clear(CommandBuffer &command_buffer) noexcept = 0;
-        virtual void save(Stream &stream, const std::filesystem::path &path) const noexcept = 0;
+        // adaptive sampling: films that track per-pixel variance override these;
+        // the tracking is only set up by enable_adaptive(), which integrators call
+        // before clear() and before building kernels that accumulate to the film
+        [[nodiscard]] virtual bool is_adaptive() const noexcept { return false; }
+        virtual void enable_adaptive() noexcept {}
+        [[nodiscard]] virtual Bool is_active(Expr<uint2> pixel) const noexcept { return def(true); }
+        // marks pixels whose relative standard error falls below `threshold` after at
+        // least `min_samples` samples as converged, and reports the number of pixels
+        // still active in `active_count` once the command buffer has been executed
+        virtual void update_active_mask(CommandBuffer &command_buffer, float threshold,
+                                        uint min_samples, uint *active_count) noexcept {}
+        // per-pixel cost heatmap (traced rays and bounces), recorded only by films
+        // that have it enabled; it is written as an extra layer of the output
+        [[nodiscard]] virtual bool has_heatmap() const noexcept { return false; }
+        virtual void accumulate_heatmap(Expr<uint2> pixel, Expr<uint> rays, Expr<uint> bounces) const noexcept {}
+        // arbitrary output variables (AOVs) of the first visible surface, recorded
+        // by films that request them; `albedo` is a one-sample estimate of its
+        // directional albedo and `instance_id` is ~0u if the camera ray escapes
+        [[nodiscard]] virtual bool has_aovs() const noexcept { return false; }
+        virtual void accumulate_aovs(Expr<uint2> pixel, Expr<float3> albedo, Expr<float3> normal,
+                                     Expr<float> depth, Expr<uint> instance_id) const noexcept {}
+        // number of tile-sized float4 layers in a downloaded frame buffer: the
+        // beauty layer first, followed by auxiliary layers like the heatmap
+        [[nodiscard]] virtual uint layer_count() const noexcept { return 1u; }
+        [[nodiscard]] auto framebuffer_size() const noexcept {
+            auto tile_size = _film->tile_size();
+            return static_cast<size_t>(tile_size.x) * tile_size.y * layer_count();
+        }
+        // copies the accumulated (unscaled) frame buffer of framebuffer_size() pixels
+        // into host memory; the caller must keep `framebuffer` alive until the command
+        // buffer has been executed
+        virtual void download(CommandBuffer &command_buffer, float4 *framebuffer) const noexcept = 0;
+        // encodes a downloaded frame buffer to disk; touches no device resources,
+        // so it is safe to call from a worker thread while rendering continues
+        virtual void write(const std::filesystem::path &path, const float4 *framebuffer) const noexcept = 0;
+        void save(Stream &stream, const std::filesystem::path &path) const noexcept;
+        // waits only for the download; the frame is encoded on the thread pool,
+        // so the next camera can be rendered while the returned future is pending
+        [[nodiscard]] std::shared_future<void> save_async(Stream &stream, const std::filesystem::path &path) const noexcept;
+
+        // Tiled rendering: the film only keeps a single tile of at most
+        // node()->tile_size() pixels on the device. Integrators render the
+        // tiles one after another, each between begin_tile() and save_tile(),
+        // and stream them to the file opened by begin_tiled_output().
+        [[nodiscard]] auto tile_offset() const noexcept { return _tile_offset; }
+        [[nodiscard]] auto tile_extent() const noexcept { return _tile_extent; }
+        void begin_tile(CommandBuffer &command_buffer, uint2 offset, uint2 extent) noexcept;
+        void save_tile(Stream &stream) const noexcept;
+        virtual void begin_tiled_output(const std::filesystem::path &path) noexcept;
+        // `framebuffer` holds the whole tile buffer (all layers) with a row stride of node()->tile_size().x
+        virtual void write_tile(uint2 offset, uint2 extent, const float4 *framebuffer) const noexcept;
+        virtual void end_tiled_output() noexcept;
     };
 
 private:
     uint2 _resolution;
+    uint2 _tile_size;
 
 public:
     Film(Scene *scene, const SceneNodeDesc *desc) noexcept;
     [[nodiscard]] auto resolution() const noexcept { return _resolution; }
+    // equals resolution() unless the film is tiled
+    [[nodiscard]] auto tile_size() const noexcept { return _tile_size; }
+    [[nodiscard]] auto is_tiled() const noexcept {
+        return _tile_size.x < _resolution.x || _tile_size.y < _resolution.y;
+    }
     [[nodiscard]] virtual luisa::unique_ptr<Instance> build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept = 0;
 };
 
@@ -36,6 +36,8 @@ public:
     Integrator(Scene *scene, const SceneNodeDesc *desc) noexcept;
     [[nodiscard]] auto sampler() const noexcept { return _sampler; }
     [[nodiscard]] auto light_sampler() const noexcept { return _light_sampler; }
+    // whether films that request AOVs get them, see Film::Instance::accumulate_aovs()
+    [[nodiscard]] virtual bool records_aovs() const noexcept { return false; }
     [[nodiscard]] virtual luisa::unique_ptr<Instance> build(
         Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept = 0;
 };
@@ -18,6 +18,15 @@ using luisa::compute::Float4x4;
 using luisa::compute::Ray;
 using luisa::compute::UInt;
 
+// A ray cone approximates the differentials of a ray by its width at the ray
+// origin and its spread angle, which suffices to select texture LODs (see
+// Akenine-Moller et al., "Texture Level of Detail Strategies for Real-Time
+// Ray Tracing", Ray Tracing Gems, 2019). A zero cone selects the finest level.
+struct RayCone {
+    Float width;
+    Float spread_angle;
+};
+
 class Interaction {
 
 private:
@@ -31,23 +40,28 @@ private:
     UInt _prim_id;
     Float _prim_area;
     Float _alpha;
+    Float _cone_width;  // width of the incoming ray cone at p
+    Float _uv_footprint;// width of the ray cone footprint on the surface, in uv units
 
 public:
-    Interaction() noexcept : _inst_id{~0u}, _prim_id{~0u} {}
+    Interaction() noexcept : _inst_id{~0u}, _prim_id{~0u}, _cone_width{0.f}, _uv_footprint{0.f} {}
     explicit Interaction(Expr<float3> wo, Expr<float> alpha = 1.f) noexcept
-        : _wo{wo}, _inst_id{~0u}, _prim_id{~0u}, _alpha{alpha} {}
+        : _wo{wo}, _inst_id{~0u}, _prim_id{~0u}, _alpha{alpha}, _cone_width{0.f}, _uv_footprint{0.f} {}
     Interaction(Expr<float3> wo, Expr<float2> uv, Expr<float> alpha = 1.f) noexcept
-        : _wo{wo}, _uv{uv}, _inst_id{~0u}, _prim_id{~0u}, _alpha{alpha} {}
+        : _wo{wo}, _uv{uv}, _inst_id{~0u}, _prim_id{~0u}, _alpha{alpha}, _cone_width{0.f}, _uv_footprint{0.f} {}
     Interaction(Var<Shape::Handle> shape, Expr<uint> inst_id, Expr<uint> prim_id, Expr<float> prim_area,
                 Expr<float3> p, Expr<float3> wo, Expr<float3> ng, Expr<float> alpha = 1.f) noexcept
         : _shape{std::move(shape)}, _p{p}, _wo{wo}, _ng{ng}, _shading{Frame::make(_ng)},
-          _inst_id{~0u}, _prim_id{prim_id}, _prim_area{prim_area}, _alpha{alpha} {}
+          _inst_id{~0u}, _prim_id{prim_id}, _prim_area{prim_area}, _alpha{alpha},
+          _cone_width{0.f}, _uv_footprint{0.f} {}
     Interaction(Var<Shape::Handle> shape, Expr<uint> inst_id, Expr<uint> prim_id, Expr<float> prim_area,
                 Expr<float3> p, Expr<float3> wo, Expr<float3> ng, Expr<float2> uv,
-                Expr<float3> ns, Expr<float3> tangent, Expr<float> alpha = 1.f) noexcept
+                Expr<float3> ns, Expr<float3> tangent, Expr<float> alpha = 1.f,
+                Expr<float> cone_width = 0.f, Expr<float> uv_footprint = 0.f) noexcept
         : _shape{std::move(shape)}, _p{p}, _wo{wo}, _ng{ng}, _uv{uv},
           _shading{Frame::make(ite(_shape->two_sided() & (dot(ns, wo) < 0.0f), -ns, ns), tangent)},
-          _inst_id{inst_id}, _prim_id{prim_id}, _prim_area{prim_area}, _alpha{alpha} {}
+          _inst_id{inst_id}, _prim_id{prim_id}, _prim_area{prim_area}, _alpha{alpha},
+          _cone_width{cone_width}, _uv_footprint{uv_footprint} {}
     [[nodiscard]] auto p() const noexcept { return _p; }
     [[nodiscard]] auto ng() const noexcept { return _ng; }
     [[nodiscard]] auto wo() const noexcept { return _wo; }
@@ -57,6 +71,8 @@ public:
     [[nodiscard]] auto triangle_area() const noexcept { return _prim_area; }
     [[nodiscard]] auto valid() const noexcept { return _inst_id != ~0u; }
     [[nodiscard]] auto alpha() const noexcept { return _alpha; }
+    [[nodiscard]] auto cone_width() const noexcept { return _cone_width; }
+    [[nodiscard]] auto uv_footprint() const noexcept { return _uv_footprint; }
     [[nodiscard]] const auto &shading() const noexcept { return _shading; }
     [[nodiscard]] const auto &shape() const noexcept { return _shape; }
     [[nodiscard]] auto wo_local() const noexcept { return _shading.world_to_local(_wo); }
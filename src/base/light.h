@@ -45,6 +45,9 @@ public:
     Light(Scene *scene, const SceneNodeDesc *desc) noexcept;
     [[nodiscard]] virtual bool is_null() const noexcept { return false; }
     [[nodiscard]] virtual bool is_virtual() const noexcept { return false; }
+    // estimated emitted power (in luminance) of the light applied to the
+    // shape, used to build importance-based light selection distributions
+    [[nodiscard]] virtual float power(const Shape *shape, float4x4 shape_to_world) const noexcept = 0;
     [[nodiscard]] virtual uint /* bindless buffer id */ encode(
         Pipeline &pipeline, CommandBuffer &command_buffer,
         uint instance_id, const Shape *shape) const noexcept = 0;
@@ -16,7 +16,8 @@ Light::Evaluation LightSampler::Instance::evaluate(
     _pipeline.decode_light(it.shape()->light_tag(), swl, time, [&](const Light::Closure &light) noexcept {
         eval = light.evaluate(it, p_from);
     });
-    eval.L *= 1.f / pmf(it, swl);
+    auto p = pmf(it, p_from, swl);
+    eval.L *= ite(p > 0.f, 1.f / p, 0.f);
     return eval;
 }
 
@@ -28,7 +29,7 @@ Light::Sample LightSampler::Instance::sample(
     _pipeline.decode_light(selection.light_tag, swl, time, [&](const Light::Closure &light) noexcept {
         light_sample = light.sample(sampler, selection.instance_id, it_from);
     });
-    light_sample.eval.L *= 1.f / selection.pmf;
+    light_sample.eval.L *= ite(selection.pmf > 0.f, 1.f / selection.pmf, 0.f);
     return light_sample;
 }
 
@@ -41,8 +41,12 @@ public:
         [[nodiscard]] auto node() const noexcept { return _sampler; }
         [[nodiscard]] const auto &pipeline() const noexcept { return _pipeline; }
         virtual void update(CommandBuffer &command_buffer, float time) noexcept = 0;
+        // re-encodes the selection data after lights were replaced in place (see
+        // Pipeline::update()), overwriting the buffers that kernels refer to
+        virtual void update_lights(CommandBuffer &command_buffer) noexcept = 0;
+        // probability of selecting the light hit at `it_light` from `p_from`
         [[nodiscard]] virtual Float pmf(
-            const Interaction &it,
+            const Interaction &it_light, Expr<float3> p_from,
             const SampledWavelengths &swl) const noexcept = 0;
         [[nodiscard]] virtual Selection select(
             Sampler::Instance &sampler, const Interaction &it,
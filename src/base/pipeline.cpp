@@ -24,6 +24,22 @@ inline Pipeline::Pipeline(Device &device) noexcept
 
 Pipeline::~Pipeline() noexcept = default;
 
+const Pipeline::RebaseTrianglesShader &Pipeline::_rebase_triangles_shader() noexcept {
+    if (!_rebase_triangles) {
+        using namespace compute;
+        Kernel1D rebase_kernel = [](BufferVar<Triangle> triangles, UInt offset) noexcept {
+            auto i = dispatch_id().x;
+            auto t = def(triangles.read(i));
+            t.i0 += offset;
+            t.i1 += offset;
+            t.i2 += offset;
+            triangles.write(i, t);
+        };
+        _rebase_triangles.emplace(_device.compile(rebase_kernel));
+    }
+    return *_rebase_triangles;
+}
+
 void Pipeline::_build_geometry(
     CommandBuffer &command_buffer, luisa::span<const Shape *const> shapes,
     float init_time, AccelBuildHint hint) noexcept {
@@ -41,8 +57,10 @@ void Pipeline::_process_shape(
     const Surface *overridden_surface,
     const Light *overridden_light) noexcept {
 
-    auto material = overridden_surface == nullptr ? shape->surface() : overridden_surface;
-    auto light = overridden_light == nullptr ? shape->light() : overridden_light;
+    // nodes replaced by incremental updates are resolved to their latest versions
+    auto material = overridden_surface == nullptr ? _scene->resolve(shape->surface()) : overridden_surface;
+    auto light = overridden_light == nullptr ? _scene->resolve(shape->light()) : overridden_light;
+    auto transform = _scene->resolve(shape->transform());
 
     if (shape->is_mesh()) {
         if (shape->deformable()) [[unlikely]] {
@@ -68,7 +86,10 @@ void Pipeline::_process_shape(
                 hash = luisa::detail::xxh3_hash64(attributes.data(), attributes.size_bytes(), hash);
                 hash = luisa::detail::xxh3_hash64(triangles.data(), triangles.size_bytes(), hash);
                 auto [cache_iter, non_existent] = _mesh_cache.try_emplace(hash, MeshGeometry{});
-                if (!non_existent) { return cache_iter->second; }
+                if (!non_existent) {
+                    _build_stats.mesh(cache_iter->second.stats_index).shape_count++;
+                    return cache_iter->second;
+                }
 
                 // create mesh
                 auto position_buffer_view = _position_buffer_arena->allocate<float3>(positions.size());
@@ -76,19 +97,40 @@ void Pipeline::_process_shape(
                 if (position_buffer_view.offset() != attribute_buffer_view.offset()) [[unlikely]] {
                     LUISA_ERROR_WITH_LOCATION("Position and attribute buffer offsets mismatch.");
                 }
+                // upload straight from the shape's storage (possibly a mapped
+                // file) and rebase the indices on the device, so that no
+                // full-size host copy of the triangle list is ever made
                 auto index_offset = static_cast<uint>(position_buffer_view.offset());
-                luisa::vector<Triangle> offset_triangles(triangles.size());
-                std::transform(triangles.cbegin(), triangles.cend(), offset_triangles.begin(), [index_offset](auto t) noexcept {
-                    return Triangle{t.i0 + index_offset, t.i1 + index_offset, t.i2 + index_offset};
-                });
                 auto triangle_buffer = create<Buffer<Triangle>>(triangles.size());
                 command_buffer << position_buffer_view.copy_from(positions.data())
                                << attribute_buffer_view.copy_from(attributes.data())
-                               << triangle_buffer->copy_from(offset_triangles.data())
-                               << compute::commit();
+                               << triangle_buffer->copy_from(triangles.data());
+                if (index_offset != 0u) {
+                    command_buffer << _rebase_triangles_shader()(*triangle_buffer, index_offset)
+                                          .dispatch(static_cast<uint>(triangles.size()));
+                }
+                command_buffer << compute::commit();
                 auto mesh = create<Mesh>(position_buffer_view.original(), *triangle_buffer, shape->build_hint());
-                command_buffer << mesh->build()
-                               << compute::commit();
+                auto stats_index = static_cast<uint>(_build_stats.meshes().size());
+                auto &stats = _build_stats.add_mesh();
+                stats.name = shape->identifier();
+                stats.vertex_count = positions.size();
+                stats.triangle_count = triangles.size();
+                stats.position_bytes = position_buffer_view.size_bytes();
+                stats.attribute_bytes = attribute_buffer_view.size_bytes();
+                stats.triangle_bytes = triangle_buffer->size_bytes();
+                stats.shape_count = 1u;
+                if (_measure_build_time) {
+                    command_buffer.stream() << compute::synchronize();
+                    Clock clock;
+                    command_buffer << mesh->build()
+                                   << compute::commit();
+                    command_buffer.stream() << compute::synchronize();
+                    stats.blas_build_time = clock.toc();
+                } else {
+                    command_buffer << mesh->build()
+                                   << compute::commit();
+                }
                 // compute alias table
                 luisa::vector<float> triangle_areas(triangles.size());
                 std::transform(triangles.cbegin(), triangles.cend(), triangle_areas.begin(), [positions](auto t) noexcept {
@@ -108,7 +150,8 @@ void Pipeline::_process_shape(
                 auto triangle_buffer_id = register_bindless(triangle_buffer->view());
                 auto alias_buffer_id = register_bindless(alias_table_buffer_view);
                 auto pdf_buffer_id = register_bindless(pdf_buffer_view);
-                return cache_iter->second = {mesh, position_buffer_id};
+                stats.general_bytes = alias_table_buffer_view.size_bytes() + pdf_buffer_view.size_bytes();
+                return cache_iter->second = {mesh, position_buffer_id, stats_index};
             }();
             // create alpha texture if any
             auto texture_id = ~0u;
@@ -124,15 +167,17 @@ void Pipeline::_process_shape(
             MeshData mesh{};
             mesh.resource = mesh_geom.resource;
             mesh.buffer_id_base = mesh_geom.buffer_id_base;
+            mesh.stats_index = mesh_geom.stats_index;
             mesh.two_sided = shape->two_sided().value_or(false);
             mesh.alpha_texture_id = texture_id;
             mesh.alpha = shape->alpha();
             iter = _meshes.emplace(shape, mesh).first;
         }
         auto mesh = iter->second;
+        _build_stats.mesh(mesh.stats_index).instance_count++;
         auto two_sided = overridden_two_sided.value_or(mesh.two_sided);
         auto instance_id = static_cast<uint>(_accel.size());
-        auto [t_node, is_static] = _transform_tree.leaf(shape->transform());
+        auto [t_node, is_static] = _transform_tree.leaf(transform);
         InstancedTransform inst_xform{t_node, instance_id};
         if (!is_static) { _dynamic_transforms.emplace_back(inst_xform); }
         auto object_to_world = inst_xform.matrix(_mean_time);
@@ -146,6 +191,7 @@ void Pipeline::_process_shape(
         // create instance
         Shape::Handle instance{};
         instance.buffer_id_base = mesh.buffer_id_base;
+        InstanceBinding binding{nullptr, nullptr, inst_xform, shape->is_virtual()};
         auto shape_properties = 0u;
         if (two_sided) { shape_properties |= Shape::property_flag_two_sided; }
         if (material != nullptr && !material->is_null()) {
@@ -156,6 +202,7 @@ void Pipeline::_process_shape(
                 auto m = _process_surface(command_buffer, instance_id, shape, material);
                 shape_properties |= Shape::property_flag_has_surface;
                 instance.surface_buffer_id_and_tag = Shape::Handle::encode_surface_buffer_id_and_tag(m.buffer_id, m.tag);
+                binding.surface = material;
             }
         }
         if (light != nullptr && !light->is_null()) {
@@ -164,9 +211,10 @@ void Pipeline::_process_shape(
                     "Non-virtual lights will be ignored on "
                     "virtual shapes and vise versa.");
             } else {
-                auto l = _process_light(command_buffer, instance_id, shape, light);
+                auto l = _process_light(command_buffer, inst_xform, shape, light);
                 shape_properties |= Shape::property_flag_has_light;
                 instance.light_buffer_id_and_tag = Shape::Handle::encode_light_buffer_id_and_tag(l.buffer_id, l.tag);
+                binding.light = light;
             }
         }
 
@@ -179,12 +227,13 @@ void Pipeline::_process_shape(
             Shape::Handle::encode_alpha_texture_id_and_properties(
                 alpha_texture, shape_properties);
         _instances.emplace_back(instance);
+        _instance_bindings.emplace_back(binding);
     } else {
-        _transform_tree.push(shape->transform());
+        _transform_tree.push(transform);
         for (auto child : shape->children()) {
             _process_shape(command_buffer, child, shape->two_sided(), material, light);
         }
-        _transform_tree.pop(shape->transform());
+        _transform_tree.pop(transform);
     }
 }
 
@@ -202,11 +251,13 @@ Pipeline::MaterialData Pipeline::_process_surface(CommandBuffer &command_buffer,
         _surface_tags.emplace(std::move(impl_type), t);
         return t;
     }();
+    _arena_owner = material;
     auto buffer_id = material->encode(*this, command_buffer, instance_id, shape);
+    _arena_owner = nullptr;
     return _surfaces.emplace(material, MaterialData{shape, instance_id, buffer_id, tag}).first->second;
 }
 
-Pipeline::LightData Pipeline::_process_light(CommandBuffer &command_buffer, uint instance_id, const Shape *shape, const Light *light) noexcept {
+Pipeline::LightData Pipeline::_process_light(CommandBuffer &command_buffer, InstancedTransform inst_xform, const Shape *shape, const Light *light) noexcept {
     if (auto iter = _lights.find(light); iter != _lights.cend()) { return iter->second; }
     auto tag = [this, light] {
         luisa::string impl_type{light->impl_type()};
@@ -220,13 +271,49 @@ Pipeline::LightData Pipeline::_process_light(CommandBuffer &command_buffer, uint
         _light_tags.emplace(std::move(impl_type), t);
         return t;
     }();
+    auto instance_id = static_cast<uint>(inst_xform.instance_id());
+    _arena_owner = light;
     auto buffer_id = light->encode(*this, command_buffer, instance_id, shape);
-    return _lights.emplace(light, LightData{shape, instance_id, buffer_id, tag}).first->second;
+    _arena_owner = nullptr;
+    return _lights.emplace(light, LightData{shape, instance_id, buffer_id, tag, inst_xform}).first->second;
+}
+
+luisa::optional<Pipeline::ArenaAllocation> Pipeline::_reuse_arena_allocation(size_t size_bytes, size_t alignment) noexcept {
+    if (_arena_owner == nullptr) { return luisa::nullopt; }
+    // best fit, so that small parameter blocks do not take over large tables
+    auto best = _free_arena_allocations.end();
+    for (auto iter = _free_arena_allocations.begin(); iter != _free_arena_allocations.end(); iter++) {
+        if (iter->view.size_bytes() >= size_bytes &&
+            iter->view.offset_bytes() % alignment == 0u &&
+            (best == _free_arena_allocations.end() ||
+             iter->view.size_bytes() < best->view.size_bytes())) { best = iter; }
+    }
+    if (best == _free_arena_allocations.end()) { return luisa::nullopt; }
+    auto allocation = *best;
+    *best = _free_arena_allocations.back();
+    _free_arena_allocations.pop_back();
+    return allocation;
+}
+
+void Pipeline::_record_arena_allocation(ArenaAllocation allocation) noexcept {
+    if (_arena_owner != nullptr) {
+        _owned_arena_allocations[_arena_owner].emplace_back(allocation);
+    }
 }
 
-luisa::unique_ptr<Pipeline> Pipeline::create(Device &device, Stream &stream, const Scene &scene) noexcept {
+void Pipeline::_release_arena_allocations(const SceneNode *owner) noexcept {
+    if (auto iter = _owned_arena_allocations.find(owner);
+        iter != _owned_arena_allocations.end()) {
+        for (auto a : iter->second) { _free_arena_allocations.emplace_back(a); }
+        _owned_arena_allocations.erase(iter);
+    }
+}
+
+luisa::unique_ptr<Pipeline> Pipeline::create(Device &device, Stream &stream, const Scene &scene, bool measure_build_time) noexcept {
     ThreadPool::global().synchronize();
     auto pipeline = luisa::make_unique<Pipeline>(device);
+    pipeline->_scene = &scene;
+    pipeline->_measure_build_time = measure_build_time;
     pipeline->_cameras.reserve(scene.cameras().size());
     pipeline->_films.reserve(scene.cameras().size());
     pipeline->_filters.reserve(scene.cameras().size());
@@ -246,6 +333,12 @@ luisa::unique_ptr<Pipeline> Pipeline::create(Device &device, Stream &stream, con
     for (auto camera : scene.cameras()) {
         pipeline->_cameras.emplace_back(camera->build(*pipeline, command_buffer));
         pipeline->_films.emplace_back(camera->film()->build(*pipeline, command_buffer));
+        if (pipeline->_films.back()->has_aovs() && !scene.integrator()->records_aovs()) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Integrator '{}' does not record AOVs. "
+                "The AOV layers of film '{}' are left empty.",
+                scene.integrator()->impl_type(), camera->film()->impl_type());
+        }
         pipeline->_filters.emplace_back(camera->filter()->build(*pipeline, command_buffer));
         mean_time += (camera->shutter_span().x + camera->shutter_span().y) * 0.5f;
     }
@@ -265,8 +358,15 @@ luisa::unique_ptr<Pipeline> Pipeline::create(Device &device, Stream &stream, con
     } else {
         pipeline->_light_sampler = scene.integrator()->light_sampler()->build(*pipeline, command_buffer);
     }
+    if (pipeline->_virtual_textures != nullptr) {
+        static_cast<void>(pipeline->_virtual_textures->commit(command_buffer));
+    }
     command_buffer << pipeline->_bindless_array.update()
                    << compute::commit();
+    pipeline->_build_stats.set_instance_count(pipeline->_instances.size());
+    pipeline->_build_stats.set_bindless_usage(
+        pipeline->_bindless_buffer_count, pipeline->_bindless_tex2d_count,
+        pipeline->_bindless_tex3d_count, bindless_array_capacity);
     return pipeline;
 }
 
@@ -290,11 +390,163 @@ bool Pipeline::update_geometry(CommandBuffer &command_buffer, float time) noexce
             });
         ThreadPool::global().synchronize();
     }
+    if (_light_sampler != nullptr) { _light_sampler->update(command_buffer, time); }
     command_buffer << _accel.update()
                    << luisa::compute::commit();
     return true;
 }
 
+bool Pipeline::can_update(luisa::span<const Scene::NodeReplacement> replacements) const noexcept {
+    for (auto [old_node, new_node] : replacements) {
+        switch (new_node->tag()) {
+            case SceneNodeTag::SURFACE: {
+                auto used = _surfaces.find(static_cast<const Surface *>(old_node)) != _surfaces.cend();
+                if (used && static_cast<const Surface *>(new_node)->is_null()) [[unlikely]] {
+                    LUISA_WARNING_WITH_LOCATION(
+                        "Surface '{}' cannot be changed to a null "
+                        "surface incrementally.",
+                        new_node->identifier());
+                    return false;
+                }
+                break;
+            }
+            case SceneNodeTag::LIGHT: {
+                auto old_light = static_cast<const Light *>(old_node);
+                auto new_light = static_cast<const Light *>(new_node);
+                auto used = _lights.find(old_light) != _lights.cend();
+                if (used && (new_light->is_null() || new_light->is_virtual() != old_light->is_virtual())) [[unlikely]] {
+                    LUISA_WARNING_WITH_LOCATION(
+                        "Light '{}' cannot be changed to a null light "
+                        "or between virtual and non-virtual incrementally.",
+                        new_node->identifier());
+                    return false;
+                }
+                break;
+            }
+            case SceneNodeTag::TRANSFORM: {
+                // identity transforms have no nodes in the transform tree to update
+                auto old_transform = static_cast<const Transform *>(old_node);
+                auto new_transform = static_cast<const Transform *>(new_node);
+                if (old_transform->is_identity() && !new_transform->is_identity()) [[unlikely]] {
+                    LUISA_WARNING_WITH_LOCATION(
+                        "Identity transform '{}' cannot be "
+                        "changed incrementally.",
+                        new_node->identifier());
+                    return false;
+                }
+                break;
+            }
+            case SceneNodeTag::TEXTURE: break;// applied through the dependent surfaces and lights
+            default:
+                LUISA_WARNING_WITH_LOCATION(
+                    "Scene node '{}' ({}::{}) cannot be updated incrementally.",
+                    new_node->identifier(), scene_node_tag_description(new_node->tag()),
+                    new_node->impl_type());
+                return false;
+        }
+    }
+    return true;
+}
+
+Pipeline::UpdateResult Pipeline::update(CommandBuffer &command_buffer, luisa::span<const Scene::NodeReplacement> replacements) noexcept {
+    // check that everything can be applied before touching anything
+    if (!can_update(replacements)) { return {false, false}; }
+    auto surface_tag_count = _surface_interfaces.size();
+    auto light_tag_count = _light_interfaces.size();
+    auto texture_tag_count = _color_texture_interfaces.size() +
+                             _illuminant_texture_interfaces.size() +
+                             _generic_texture_interfaces.size();
+    auto instances_dirty = false;
+    auto lights_dirty = false;
+    auto transforms_dirty = false;
+    for (auto [old_node, new_node] : replacements) {
+        if (new_node->tag() == SceneNodeTag::SURFACE) {
+            auto old_surface = static_cast<const Surface *>(old_node);
+            auto new_surface = static_cast<const Surface *>(new_node);
+            auto iter = _surfaces.find(old_surface);
+            if (iter == _surfaces.end()) { continue; }
+            auto data = iter->second;
+            _surfaces.erase(iter);
+            _release_arena_allocations(old_surface);
+            auto m = _process_surface(command_buffer, data.instance_id, data.shape, new_surface);
+            auto encoded = Shape::Handle::encode_surface_buffer_id_and_tag(m.buffer_id, m.tag);
+            for (auto i = 0u; i < _instances.size(); i++) {
+                if (_instance_bindings[i].surface == old_surface) {
+                    _instance_bindings[i].surface = new_surface;
+                    _instances[i].surface_buffer_id_and_tag = encoded;
+                }
+            }
+            instances_dirty = true;
+        } else if (new_node->tag() == SceneNodeTag::LIGHT) {
+            auto old_light = static_cast<const Light *>(old_node);
+            auto new_light = static_cast<const Light *>(new_node);
+            auto iter = _lights.find(old_light);
+            if (iter == _lights.end()) { continue; }
+            auto data = iter->second;
+            _lights.erase(iter);
+            _release_arena_allocations(old_light);
+            auto l = _process_light(command_buffer, data.transform, data.shape, new_light);
+            auto encoded = Shape::Handle::encode_light_buffer_id_and_tag(l.buffer_id, l.tag);
+            for (auto i = 0u; i < _instances.size(); i++) {
+                if (_instance_bindings[i].light == old_light) {
+                    _instance_bindings[i].light = new_light;
+                    _instances[i].light_buffer_id_and_tag = encoded;
+                }
+            }
+            instances_dirty = true;
+            lights_dirty = true;
+        } else if (new_node->tag() == SceneNodeTag::TRANSFORM) {
+            if (_transform_tree.replace(
+                    static_cast<const Transform *>(old_node),
+                    static_cast<const Transform *>(new_node)) != 0u) {
+                transforms_dirty = true;
+            }
+        }
+    }
+    if (transforms_dirty) {
+        _dynamic_transforms.clear();
+        for (auto &&b : _instance_bindings) {
+            auto m = b.transform.matrix(_mean_time);
+            if (b.is_virtual) { m = m * make_float4x4(make_float3x3(0.0f)); }
+            _accel.set_transform(b.transform.instance_id(), m);
+            if (auto node = b.transform.node(); node != nullptr && !node->is_static()) {
+                _dynamic_transforms.emplace_back(b.transform);
+            }
+        }
+        command_buffer << _accel.update();
+    }
+    if (instances_dirty) {
+        command_buffer << _instance_buffer.copy_from(_instances.data());
+    }
+    auto kernels_invalidated =
+        _surface_interfaces.size() != surface_tag_count ||
+        _light_interfaces.size() != light_tag_count ||
+        _color_texture_interfaces.size() + _illuminant_texture_interfaces.size() +
+                _generic_texture_interfaces.size() !=
+            texture_tag_count;
+    if (_light_sampler != nullptr) {
+        if (lights_dirty) {
+            // the number of lights is unchanged, so the sampler can overwrite
+            // the buffers that compiled kernels refer to
+            _light_sampler->update_lights(command_buffer);
+        }
+        if (transforms_dirty) {
+            _light_sampler->update(command_buffer, _mean_time);
+        }
+    }
+    // newly registered virtual textures grow the buffers captured by kernels
+    if (_virtual_textures != nullptr && _virtual_textures->commit(command_buffer)) {
+        kernels_invalidated = true;
+    }
+    command_buffer << _bindless_array.update()
+                   << compute::commit();
+    if (kernels_invalidated) { _kernel_generation++; }
+    _build_stats.set_bindless_usage(
+        _bindless_buffer_count, _bindless_tex2d_count,
+        _bindless_tex3d_count, bindless_array_capacity);
+    return {true, kernels_invalidated};
+}
+
 void Pipeline::render(Stream &stream) noexcept {
     _integrator->render(stream);
 }
@@ -354,7 +606,21 @@ std::tuple<Var<float3>, Var<float3>, Var<float2>> Pipeline::surface_point_attrib
 Var<Hit> Pipeline::trace_closest(const Var<Ray> &ray) const noexcept { return _accel.trace_closest(ray); }
 Var<bool> Pipeline::trace_any(const Var<Ray> &ray) const noexcept { return _accel.trace_any(ray); }
 
+Var<float> Pipeline::triangle_uv_area(const Var<Shape::Handle> &instance, const Var<Triangle> &triangle) const noexcept {
+    auto attributes = buffer<Shape::VertexAttribute>(instance->attribute_buffer_id());
+    auto uv0 = attributes.read(triangle.i0)->uv();
+    auto uv1 = attributes.read(triangle.i1)->uv();
+    auto uv2 = attributes.read(triangle.i2)->uv();
+    auto e1 = uv1 - uv0;
+    auto e2 = uv2 - uv0;
+    return 0.5f * abs(e1.x * e2.y - e1.y * e2.x);
+}
+
 luisa::unique_ptr<Interaction> Pipeline::interaction(const Var<Ray> &ray, const Var<Hit> &hit) const noexcept {
+    return interaction(ray, hit, RayCone{.width = def(0.0f), .spread_angle = def(0.0f)});
+}
+
+luisa::unique_ptr<Interaction> Pipeline::interaction(const Var<Ray> &ray, const Var<Hit> &hit, const RayCone &cone) const noexcept {
     using namespace luisa::compute;
     Interaction it;
     $if(hit->miss()) {
@@ -377,9 +643,15 @@ luisa::unique_ptr<Interaction> Pipeline::interaction(const Var<Ray> &ray, const
         $if(shape->has_alpha_texture()) {
             alpha = tex2d(shape_ref->alpha_texture_id()).sample(uv_ref).x;
         };
+        // the cone footprint is stretched by the incident angle and converted
+        // to uv units with the uv-to-world area ratio of the triangle
+        auto cone_width = cone.width + cone.spread_angle * distance(ray->origin(), p);
+        auto uv_density = sqrt(triangle_uv_area(shape, tri) / max(area, 1e-20f));
+        auto uv_footprint = cone_width / max(abs(dot(ng, wo)), 1e-2f) * uv_density;
         it = Interaction{
             std::move(shape), hit.inst, hit.prim,
-            area, p, wo, ng, uv, ns, t, alpha};
+            area, p, wo, ng, uv, ns, t, alpha,
+            cone_width, uv_footprint};
     };
     return luisa::make_unique<Interaction>(std::move(it));
 }
@@ -519,6 +791,35 @@ const TextureHandle *Pipeline::encode_texture(CommandBuffer &command_buffer, con
     }
     return iter->second.get();
 }
+uint Pipeline::register_image_texture(
+    const LoadedImage &image, TextureSampler sampler, bool mipmapped,
+    const luisa::function<const Image<float> *()> &upload) noexcept {
+    auto &&shared = _shared_images[&image];
+    if (auto slot = std::find_if(shared.slots.cbegin(), shared.slots.cend(), [sampler](auto s) noexcept {
+            return s.first.filter() == sampler.filter() &&
+                   s.first.address() == sampler.address();
+        });
+        slot != shared.slots.cend()) {
+        return slot->second;
+    }
+    auto &&device_image = shared.device_images[mipmapped ? 1u : 0u];
+    if (device_image == nullptr) { device_image = upload(); }
+    auto tex_id = register_bindless(*device_image, sampler);
+    shared.slots.emplace_back(sampler, tex_id);
+    return tex_id;
+}
+
+uint Pipeline::register_virtual_texture(const LoadedImage &image, TextureSampler::Address address) noexcept {
+    if (_virtual_textures == nullptr) {
+        _virtual_textures = luisa::make_unique<VirtualTextureManager>(*this);
+    }
+    return _virtual_textures->register_texture(image, address);
+}
+
+uint Pipeline::stream_virtual_textures(Stream &stream, uint max_uploads, bool up_to_date) noexcept {
+    return _virtual_textures == nullptr ? 0u : _virtual_textures->stream(stream, max_uploads, up_to_date);
+}
+
 Float4 Pipeline::evaluate_color_texture(
     const Var<TextureHandle> &handle, const Interaction &it,
     const SampledWavelengths &swl, Expr<float> time, Float *max_value) const noexcept {
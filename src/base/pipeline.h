@@ -4,10 +4,12 @@
 
 #pragma once
 
+#include <array>
 #include <optional>
 
 #include <luisa-compute.h>
 #include <util/spectrum.h>
+#include <util/build_stats.h>
 #include <base/shape.h>
 #include <base/light.h>
 #include <base/camera.h>
@@ -20,6 +22,8 @@
 #include <base/light_sampler.h>
 #include <base/environment.h>
 #include <base/texture.h>
+#include <base/virtual_texture.h>
+#include <base/scene.h>
 
 namespace luisa::render {
 
@@ -56,11 +60,13 @@ public:
     struct MeshGeometry {
         Mesh *resource;
         uint buffer_id_base;
+        uint stats_index;
     };
 
     struct MeshData {
         Mesh *resource;
         uint buffer_id_base;
+        uint stats_index;
         uint alpha_texture_id;
         float alpha;
         bool two_sided;
@@ -72,6 +78,7 @@ public:
         uint instance_id;
         uint buffer_id;
         uint tag;
+        InstancedTransform transform;
     };
 
     struct MaterialData {
@@ -81,6 +88,25 @@ public:
         uint tag;
     };
 
+    // scene nodes bound to each instance, for incremental updates
+    struct InstanceBinding {
+        const Surface *surface;
+        const Light *light;
+        InstancedTransform transform;
+        bool is_virtual;
+    };
+
+    struct UpdateResult {
+        bool applied;            // false if the pipeline has to be re-created instead
+        bool kernels_invalidated;// true if kernels compiled before the update must be recompiled
+    };
+
+    // a buffer from the general arena with its bindless slot
+    struct ArenaAllocation {
+        BufferView<std::byte> view;
+        uint buffer_id;
+    };
+
 private:
     Device &_device;
     Accel _accel;
@@ -105,8 +131,22 @@ private:
     luisa::vector<const Texture *> _illuminant_texture_interfaces;
     luisa::vector<const Texture *> _generic_texture_interfaces;
     luisa::unordered_map<const Texture *, luisa::unique_ptr<TextureHandle>> _texture_handles;
+    // device copies (single-level and mipmapped) of host images shared by
+    // image textures (see ImageCache), with their bindless slots per sampler
+    struct SharedImage {
+        std::array<const Image<float> *, 2u> device_images{};
+        luisa::vector<std::pair<TextureSampler, uint>> slots;
+    };
+    luisa::unordered_map<const LoadedImage *, SharedImage> _shared_images;
+    luisa::unique_ptr<VirtualTextureManager> _virtual_textures;
     luisa::vector<Shape::Handle> _instances;
+    luisa::vector<InstanceBinding> _instance_bindings;
     luisa::vector<InstancedTransform> _dynamic_transforms;
+    // arena allocations made while encoding each surface and light, which
+    // are recycled for the encodings of their replacements (see update())
+    const SceneNode *_arena_owner{nullptr};
+    luisa::unordered_map<const SceneNode *, luisa::vector<ArenaAllocation>> _owned_arena_allocations;
+    luisa::vector<ArenaAllocation> _free_arena_allocations;
     Buffer<Shape::Handle> _instance_buffer;
     luisa::vector<luisa::unique_ptr<Camera::Instance>> _cameras;
     luisa::vector<luisa::unique_ptr<Filter::Instance>> _filters;
@@ -117,15 +157,25 @@ private:
     luisa::unique_ptr<Environment::Instance> _environment;
     uint _rgb2spec_index{0u};
     float _mean_time{0.0f};
+    using RebaseTrianglesShader = compute::Shader1D<Buffer<Triangle>, uint>;
+    luisa::optional<RebaseTrianglesShader> _rebase_triangles;
+    BuildStats _build_stats;
+    const Scene *_scene{nullptr};
+    uint64_t _kernel_generation{0u};
+    bool _measure_build_time{false};
 
 private:
+    [[nodiscard]] const RebaseTrianglesShader &_rebase_triangles_shader() noexcept;
     void _build_geometry(CommandBuffer &command_buffer, luisa::span<const Shape *const> shapes, float init_time, AccelBuildHint hint) noexcept;
     void _process_shape(
         CommandBuffer &command_buffer, const Shape *shape,
         luisa::optional<bool> overridden_two_sided = luisa::nullopt,
         const Surface *overridden_surface = nullptr, const Light *overridden_light = nullptr) noexcept;
     [[nodiscard]] MaterialData _process_surface(CommandBuffer &command_buffer, uint instance_id, const Shape *shape, const Surface *material) noexcept;
-    [[nodiscard]] LightData _process_light(CommandBuffer &command_buffer, uint instance_id, const Shape *shape, const Light *light) noexcept;
+    [[nodiscard]] LightData _process_light(CommandBuffer &command_buffer, InstancedTransform inst_xform, const Shape *shape, const Light *light) noexcept;
+    [[nodiscard]] luisa::optional<ArenaAllocation> _reuse_arena_allocation(size_t size_bytes, size_t alignment) noexcept;
+    void _record_arena_allocation(ArenaAllocation allocation) noexcept;
+    void _release_arena_allocations(const SceneNode *owner) noexcept;
 
 public:
     // for internal use only; use Pipeline::create() instead
@@ -164,6 +214,15 @@ public:
     }
 
     [[nodiscard]] const TextureHandle *encode_texture(CommandBuffer &command_buffer, const Texture *texture) noexcept;
+    // returns the bindless slot of the device copy of `image` sampled with
+    // `sampler`; `upload` creates the device copy only if no texture sharing
+    // the same host image (and mipmapping) has done so before
+    [[nodiscard]] uint register_image_texture(
+        const LoadedImage &image, TextureSampler sampler, bool mipmapped,
+        const luisa::function<const Image<float> *()> &upload) noexcept;
+    // returns the offset of `image` in the indirection table of the virtual
+    // texture manager, which is created on the first registration
+    [[nodiscard]] uint register_virtual_texture(const LoadedImage &image, TextureSampler::Address address) noexcept;
 
     template<typename T, typename... Args>
         requires std::is_base_of_v<Resource, T>
@@ -176,9 +235,17 @@ public:
 
     template<typename T>
     [[nodiscard]] std::pair<BufferView<T>, uint /* bindless id */> arena_buffer(size_t n) noexcept {
-        auto view = _general_buffer_arena->allocate<T>(
-            std::max(n, static_cast<size_t>(1u)));
+        n = std::max(n, static_cast<size_t>(1u));
+        // take over the buffer and bindless slot of a replaced encoding if one fits
+        if (auto reused = _reuse_arena_allocation(n * sizeof(T), alignof(T))) {
+            auto view = reused->view.template as<T>().subview(0u, n);
+            _bindless_array.emplace(reused->buffer_id, view);
+            _record_arena_allocation(*reused);
+            return std::make_pair(view, reused->buffer_id);
+        }
+        auto view = _general_buffer_arena->allocate<T>(n);
         auto buffer_id = register_bindless(view);
+        _record_arena_allocation({view.template as<std::byte>(), buffer_id});
         return std::make_pair(view, buffer_id);
     }
 
@@ -190,7 +257,11 @@ public:
     [[nodiscard]] auto bindless_tex3d(Expr<uint> tex_id) const noexcept { return _bindless_array.tex3d(tex_id); }
 
 public:
-    [[nodiscard]] static luisa::unique_ptr<Pipeline> create(Device &device, Stream &stream, const Scene &scene) noexcept;
+    // with `measure_build_time`, the stream is synchronized around each BLAS
+    // build so that build_stats() can report per-mesh build times
+    [[nodiscard]] static luisa::unique_ptr<Pipeline> create(
+        Device &device, Stream &stream, const Scene &scene,
+        bool measure_build_time = false) noexcept;
     [[nodiscard]] auto &accel() const noexcept { return _accel; }
     [[nodiscard]] auto &bindless_array() const noexcept { return _bindless_array; }
     [[nodiscard]] auto &transform_tree() const noexcept { return _transform_tree; }
@@ -209,8 +280,28 @@ public:
     [[nodiscard]] auto environment() const noexcept { return _environment.get(); }
     [[nodiscard]] auto light_sampler() const noexcept { return _light_sampler.get(); }
     [[nodiscard]] auto mean_time() const noexcept { return _mean_time; }
+    [[nodiscard]] auto &build_stats() const noexcept { return _build_stats; }
+    // bumped whenever an update invalidates previously compiled kernels
+    [[nodiscard]] auto kernel_generation() const noexcept { return _kernel_generation; }
+    // nullptr if no texture is virtual
+    [[nodiscard]] const VirtualTextureManager *virtual_textures() const noexcept { return _virtual_textures.get(); }
+    // uploads the virtual texture pages requested by the frames rendered before
+    // the last call, or before this one with `up_to_date` (see
+    // VirtualTextureManager::stream()); returns the number of uploaded pages
+    uint stream_virtual_textures(Stream &stream, uint max_uploads = VirtualTextureManager::max_uploads_per_stream,
+                                 bool up_to_date = false) noexcept;
 
     bool update_geometry(CommandBuffer &command_buffer, float time) noexcept;
+    // checks whether update() can apply the replacements in place; meant to be
+    // passed to Scene::update() so that rejected updates leave the scene as is
+    [[nodiscard]] bool can_update(luisa::span<const Scene::NodeReplacement> replacements) const noexcept;
+    // Applies scene node replacements (see Scene::update()) in place: changed
+    // surfaces and lights are re-encoded into the buffers of the nodes they
+    // replace and rebound to their instances, the light sampler re-encodes
+    // its data in place, and changed transforms are re-applied to the accel.
+    // Meshes are not rebuilt and unchanged textures are not uploaded again.
+    // Replacements rejected by can_update() leave the pipeline untouched.
+    [[nodiscard]] UpdateResult update(CommandBuffer &command_buffer, luisa::span<const Scene::NodeReplacement> replacements) noexcept;
     void render(Stream &stream) noexcept;
 
     template<typename T, typename I>
@@ -223,6 +314,7 @@ public:
     [[nodiscard]] Var<Hit> trace_closest(const Var<Ray> &ray) const noexcept;
     [[nodiscard]] Var<bool> trace_any(const Var<Ray> &ray) const noexcept;
     [[nodiscard]] luisa::unique_ptr<Interaction> interaction(const Var<Ray> &ray, const Var<Hit> &hit) const noexcept;
+    [[nodiscard]] luisa::unique_ptr<Interaction> interaction(const Var<Ray> &ray, const Var<Hit> &hit, const RayCone &cone) const noexcept;
     [[nodiscard]] std::pair<Var<Shape::Handle>, Var<float4x4>> instance(Expr<uint> index) const noexcept;
     [[nodiscard]] Var<Triangle> triangle(const Var<Shape::Handle> &instance, Expr<uint> index) const noexcept;
     [[nodiscard]] std::tuple<Var<float3> /* position */, Var<float3> /* ng */, Var<float> /* area */>
@@ -231,7 +323,9 @@ public:
     [[nodiscard]] std::tuple<Var<float3> /* ns */, Var<float3> /* tangent */, Var<float2> /* uv */>
     surface_point_attributes(const Var<Shape::Handle> &instance, const Var<float3x3> &shape_to_world_normal,
                              const Var<Triangle> &triangle, const Var<float3> &uvw) const noexcept;
+    [[nodiscard]] Var<float> triangle_uv_area(const Var<Shape::Handle> &instance, const Var<Triangle> &triangle) const noexcept;
     [[nodiscard]] auto intersect(const Var<Ray> &ray) const noexcept { return interaction(ray, trace_closest(ray)); }
+    [[nodiscard]] auto intersect(const Var<Ray> &ray, const RayCone &cone) const noexcept { return interaction(ray, trace_closest(ray), cone); }
     [[nodiscard]] auto intersect_any(const Var<Ray> &ray) const noexcept { return trace_any(ray); }
 
     [[nodiscard]] Float4 evaluate_texture(
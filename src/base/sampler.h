@@ -21,6 +21,11 @@ public:
     private:
         const Pipeline &_pipeline;
         const Sampler *_sampler;
+        uint64_t _state_version{0u};
+
+    protected:
+        // to be called when reset() re-creates resources referenced by kernels
+        void _invalidate_state() noexcept { _state_version++; }
 
     public:
         explicit Instance(const Pipeline &pipeline, const Sampler *sampler) noexcept
@@ -28,10 +33,16 @@ public:
         virtual ~Instance() noexcept = default;
         [[nodiscard]] auto &pipeline() const noexcept { return _pipeline; }
         [[nodiscard]] auto node() const noexcept { return _sampler; }
+        // kernels compiled against an older version must be recompiled
+        [[nodiscard]] auto state_version() const noexcept { return _state_version; }
 
         // interfaces
         virtual void reset(CommandBuffer &command_buffer, uint2 resolution, uint spp) noexcept = 0;
         virtual void start(Expr<uint2> pixel, Expr<uint> sample_index) noexcept = 0;
+        // Per-pixel state storage is allocated on the first call to save_state()
+        // or load_state() when a kernel is built, so that it does not take up
+        // device memory for integrators that never save states (e.g., when
+        // rendering large images tile by tile).
         virtual void save_state() noexcept = 0;
         virtual void load_state(Expr<uint2> pixel) noexcept = 0;
         [[nodiscard]] virtual Float generate_1d() noexcept = 0;
@@ -26,6 +26,9 @@ namespace luisa::render {
 struct Scene::Config {
     luisa::vector<NodeHandle> internal_nodes;
     luisa::unordered_map<luisa::string, NodeHandle, Hash64> nodes;
+    luisa::unordered_map<luisa::string, const SceneNodeDesc *, Hash64> descs;
+    luisa::vector<NodeHandle> retired_nodes;
+    luisa::unordered_map<const SceneNode *, SceneNode *> replacements;
     Integrator *integrator{nullptr};
     Environment *environment{nullptr};
     luisa::vector<Camera *> cameras;
@@ -103,6 +106,7 @@ SceneNode *Scene::load_node(SceneNodeTag tag, const SceneNodeDesc *desc) noexcep
                 "Constructing scene graph node '{}' (desc = {}).",
                 desc->identifier(), fmt::ptr(desc));
             iter->second = NodeHandle{create(this, desc), destroy};
+            _config->descs.insert_or_assign(luisa::string{desc->identifier()}, desc);
         }
         return std::make_pair(iter->second.get(), success);
     }();
@@ -197,6 +201,104 @@ luisa::unique_ptr<Scene> Scene::create(const Context &ctx, const SceneDesc *desc
     return scene;
 }
 
+luisa::vector<Scene::NodeReplacement> Scene::update(luisa::span<const SceneNodeDesc *const> descs) noexcept {
+    return *try_update(descs, [](auto) noexcept { return true; });
+}
+
+luisa::optional<luisa::vector<Scene::NodeReplacement>> Scene::try_update(
+    luisa::span<const SceneNodeDesc *const> descs,
+    const luisa::function<bool(luisa::span<const NodeReplacement>)> &accept) noexcept {
+    // find the loaded nodes to re-create
+    luisa::unordered_set<luisa::string, Hash64> dirty;
+    luisa::vector<std::pair<luisa::string, NodeHandle>> retired;
+    {
+        std::scoped_lock lock{_mutex};
+        for (auto d : descs) {
+            if (luisa::string identifier{d->identifier()};
+                _config->nodes.find(identifier) != _config->nodes.cend()) {
+                dirty.emplace(std::move(identifier));
+            }
+        }
+        // propagate to dependents until nothing changes
+        for (auto changed = !dirty.empty(); changed;) {
+            changed = false;
+            for (auto &&[identifier, desc] : _config->descs) {
+                if (dirty.find(identifier) != dirty.cend()) { continue; }
+                luisa::unordered_set<luisa::string, Hash64> references;
+                desc->collect_references(references);
+                for (auto &&r : references) {
+                    if (dirty.find(r) == dirty.cend()) { continue; }
+                    auto ref_tag = _config->nodes.at(r)->tag();
+                    if (desc->tag() == SceneNodeTag::SHAPE &&
+                        (ref_tag == SceneNodeTag::SURFACE ||
+                         ref_tag == SceneNodeTag::LIGHT ||
+                         ref_tag == SceneNodeTag::TRANSFORM)) { continue; }
+                    dirty.emplace(identifier);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+        // detach the old nodes so that loading creates new ones
+        retired.reserve(dirty.size());
+        for (auto &&identifier : dirty) {
+            auto iter = _config->nodes.find(identifier);
+            retired.emplace_back(identifier, std::move(iter->second));
+            _config->nodes.erase(iter);
+        }
+    }
+    luisa::vector<NodeReplacement> replacements;
+    replacements.reserve(retired.size());
+    for (auto &&[identifier, old_node] : retired) {
+        auto desc = _config->descs.at(identifier);
+        LUISA_INFO(
+            "Updating scene node '{}' ({}::{}).",
+            identifier, scene_node_tag_description(desc->tag()),
+            desc->impl_type());
+        replacements.emplace_back(NodeReplacement{
+            old_node.get(), load_node(desc->tag(), desc)});
+    }
+    ThreadPool::global().synchronize();
+    std::scoped_lock lock{_mutex};
+    if (!accept(replacements)) {
+        // put the old nodes back; the new ones are kept alive like replaced
+        // nodes, since they may already be referenced by other new nodes
+        for (auto &&[identifier, old_node] : retired) {
+            auto iter = _config->nodes.find(identifier);
+            _config->retired_nodes.emplace_back(std::move(iter->second));
+            iter->second = std::move(old_node);
+        }
+        return luisa::nullopt;
+    }
+    for (auto r : replacements) {
+        // keep older versions pointing to the latest one
+        for (auto &&[_, latest] : _config->replacements) {
+            if (latest == r.old_node) { latest = r.new_node; }
+        }
+        _config->replacements.insert_or_assign(r.old_node, r.new_node);
+        auto patch = [r]<typename T>(T *&p) noexcept {
+            if (p == r.old_node) { p = static_cast<T *>(r.new_node); }
+        };
+        patch(_config->integrator);
+        patch(_config->environment);
+        for (auto &&c : _config->cameras) { patch(c); }
+        for (auto &&shape : _config->shapes) { patch(shape); }
+    }
+    for (auto &&[_, node] : retired) {
+        _config->retired_nodes.emplace_back(std::move(node));
+    }
+    return replacements;
+}
+
+const SceneNode *Scene::resolve(const SceneNode *node) const noexcept {
+    if (node == nullptr || _config->replacements.empty()) { return node; }
+    if (auto iter = _config->replacements.find(node);
+        iter != _config->replacements.cend()) {
+        return iter->second;
+    }
+    return node;
+}
+
 Scene::~Scene() noexcept = default;
 
 }// namespace luisa::render
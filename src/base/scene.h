@@ -43,6 +43,11 @@ public:
 
     struct Config;
 
+    struct NodeReplacement {
+        const SceneNode *old_node;
+        SceneNode *new_node;
+    };
+
 private:
     const Context &_context;
     luisa::unique_ptr<Config> _config;
@@ -76,6 +81,26 @@ public:
     [[nodiscard]] const Environment *environment() const noexcept;
     [[nodiscard]] luisa::span<const Shape *const> shapes() const noexcept;
     [[nodiscard]] luisa::span<const Camera *const> cameras() const noexcept;
+
+    // Re-creates the loaded global nodes whose descriptions are given (e.g., as
+    // returned by SceneParser::parse_update()) together with the nodes depending
+    // on them. Shapes are not re-created for changed surfaces, lights or
+    // transforms; such references are remapped with resolve() instead. The
+    // replaced nodes are kept alive so that outstanding pointers stay valid.
+    [[nodiscard]] luisa::vector<NodeReplacement> update(luisa::span<const SceneNodeDesc *const> descs) noexcept;
+    // same as update(), but the replacements are first passed to `accept`
+    // (e.g., Pipeline::can_update()); if rejected, the new nodes are discarded,
+    // the scene keeps its current nodes and luisa::nullopt is returned
+    [[nodiscard]] luisa::optional<luisa::vector<NodeReplacement>> try_update(
+        luisa::span<const SceneNodeDesc *const> descs,
+        const luisa::function<bool(luisa::span<const NodeReplacement>)> &accept) noexcept;
+    // returns the latest version of a possibly replaced node
+    [[nodiscard]] const SceneNode *resolve(const SceneNode *node) const noexcept;
+    template<typename T>
+        requires std::is_base_of_v<SceneNode, T>
+    [[nodiscard]] auto resolve(const T *node) const noexcept {
+        return static_cast<const T *>(resolve(static_cast<const SceneNode *>(node)));
+    }
 };
 
 }
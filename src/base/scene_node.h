@@ -40,6 +40,7 @@ public:
 
 private:
     const Scene *_scene;
+    luisa::string _identifier;
     Tag _tag;
 
 public:
@@ -51,6 +52,7 @@ public:
     virtual ~SceneNode() noexcept = default;
     [[nodiscard]] auto scene() const noexcept { return _scene; }
     [[nodiscard]] auto tag() const noexcept { return _tag; }
+    [[nodiscard]] auto identifier() const noexcept { return luisa::string_view{_identifier}; }
     [[nodiscard]] virtual std::string_view impl_type() const noexcept = 0;
 };
 
@@ -33,7 +33,8 @@ TextureHandle TextureHandle::encode_texture(uint tag, uint tex_id, float3 v) noe
 }
 
 ImageTexture::ImageTexture(Scene *scene, const SceneNodeDesc *desc) noexcept
-    : Texture{scene, desc} {
+    : Texture{scene, desc},
+      _virtual{desc->property_bool_or_default("virtual", false)} {
     auto filter = desc->property_string_or_default("filter", "bilinear");
     auto address = desc->property_string_or_default("address", "repeat");
     for (auto &c : filter) { c = static_cast<char>(tolower(c)); }
@@ -80,7 +81,37 @@ Float4 ImageTexture::evaluate(
     auto uv_offset = make_float2(
         handle.compressed_v[1], handle.compressed_v[2]);
     auto uv = it.uv() * make_float2(u_scale, v_scale) + uv_offset;
-    return pipeline.tex2d(handle->texture_id()).sample(uv);// TODO: LOD
+    auto sample_bindless = [&](Expr<uint> tex_id) noexcept {
+        // the level whose texels match the width of the ray cone footprint
+        auto texture = pipeline.tex2d(tex_id);
+        auto size = make_float2(texture.size());
+        auto footprint = it.uv_footprint() *
+                         max(abs(u_scale) * size.x, abs(v_scale) * size.y);
+        auto level = log2(max(footprint, 1.0f));
+        return texture.sample(uv, level);
+    };
+    auto virtual_textures = pipeline.virtual_textures();
+    if (virtual_textures == nullptr) { return sample_bindless(handle->texture_id()); }
+    auto id = handle->texture_id();
+    auto value = def(make_float4(0.0f));
+    $if((id & virtual_texture_flag) != 0u) {
+        value = virtual_textures->sample(id & ~virtual_texture_flag, uv);
+    }
+    $else {
+        value = sample_bindless(id);
+    };
+    return value;
+}
+
+std::filesystem::path ImageTexture::_spill_directory() noexcept {
+    std::error_code ec;
+    auto temp = std::filesystem::temp_directory_path(ec);
+    return (ec ? std::filesystem::current_path() : temp) / "luisa-render-virtual-textures";
+}
+
+bool ImageTexture::is_mipmapped() const noexcept {
+    return _sampler.filter() == TextureSampler::Filter::LINEAR_LINEAR ||
+           _sampler.filter() == TextureSampler::Filter::ANISOTROPIC;
 }
 
 TextureHandle ImageTexture::_encode(
@@ -88,17 +119,50 @@ TextureHandle ImageTexture::_encode(
     uint handle_tag) const noexcept {
 
     auto &&image = _image();
-    auto device_image = pipeline.create<Image<float>>(image.pixel_storage(), image.size());
-    auto tex_id = pipeline.register_bindless(*device_image, _sampler);
-    command_buffer << device_image->copy_from(image.pixels())
-                   << compute::commit();
+    if (_virtual) {
+        if (VirtualTextureManager::is_supported(image.pixel_storage())) {
+            if (is_mipmapped()) {
+                LUISA_WARNING_WITH_LOCATION(
+                    "Virtual textures are sampled from level 0 only.");
+            }
+            auto offset = pipeline.register_virtual_texture(image, _sampler.address());
+            if (offset >= virtual_texture_flag) [[unlikely]] {
+                LUISA_ERROR_WITH_LOCATION(
+                    "Too many virtual texture pages.");
+            }
+            return TextureHandle::encode_texture(
+                handle_tag, offset | virtual_texture_flag,
+                _encode_uv_transform());
+        }
+        LUISA_WARNING_WITH_LOCATION(
+            "Pixel storage 0x{:02x} is not supported by virtual textures. "
+            "Falling back to a resident texture{}.",
+            luisa::to_underlying(image.pixel_storage()),
+            is_mipmapped() ? " sampled from level 0 only" : "");
+    }
+    // textures sharing the host image (see ImageCache) share the upload
+    auto tex_id = pipeline.register_image_texture(image, _sampler, is_mipmapped(), [&] {
+        auto mipmaps = _mip_levels();
+        auto device_image = pipeline.create<Image<float>>(
+            image.pixel_storage(), image.size(),
+            static_cast<uint>(mipmaps.size() + 1u));
+        command_buffer << device_image->view(0u).copy_from(image.pixels());
+        for (auto i = 0u; i < mipmaps.size(); i++) {
+            command_buffer << device_image->view(i + 1u).copy_from(mipmaps[i].pixels());
+        }
+        command_buffer << compute::commit();
+        return static_cast<const Image<float> *>(device_image);
+    });
+    return TextureHandle::encode_texture(
+        handle_tag, tex_id, _encode_uv_transform());
+}
+
+float3 ImageTexture::_encode_uv_transform() const noexcept {
     auto u_scale = float_to_half(_uv_scale.x);
     auto v_scale = float_to_half(_uv_scale.y);
-    auto compressed = make_float3(
+    return make_float3(
         luisa::bit_cast<float>(v_scale | (u_scale << 16u)),
         _uv_offset);
-    return TextureHandle::encode_texture(
-        handle_tag, tex_id, compressed);
 }
 
 }// namespace luisa::render
@@ -82,6 +82,8 @@ public:
         const Pipeline &pipeline, const Interaction &it,
         const Var<TextureHandle> &handle, Expr<float> time) const noexcept = 0;
     [[nodiscard]] virtual uint channels() const noexcept { return 4u; }
+    // rough average luminance, only used for importance estimation (e.g., light power)
+    [[nodiscard]] virtual float average_luminance() const noexcept { return 1.0f; }
 };
 
 using compute::PixelStorage;
@@ -89,21 +91,41 @@ using TextureSampler = compute::Sampler;
 
 class ImageTexture : public Texture {
 
+public:
+    // marks texture ids that are offsets into the virtual texture indirection table
+    static constexpr auto virtual_texture_flag = 1u << 23u;
+
 private:
     TextureSampler _sampler;
     float2 _uv_scale;
     float2 _uv_offset;
+    bool _virtual;
+
+protected:
+    // where the pixels of virtual textures are spilled to (see LoadedImage::spill())
+    [[nodiscard]] static std::filesystem::path _spill_directory() noexcept;
+    // virtual textures are sampled from level 0 only
+    [[nodiscard]] bool _has_mip_levels() const noexcept { return is_mipmapped() && !_virtual; }
 
 private:
     [[nodiscard]] virtual const LoadedImage &_image() const noexcept = 0;
+    // levels 1 and up of the mip chain of _image(), kept alive like it for the
+    // upload; generated on load if _has_mip_levels(), see generate_mipmaps()
+    [[nodiscard]] virtual luisa::span<const LoadedImage> _mip_levels() const noexcept = 0;
+    [[nodiscard]] float3 _encode_uv_transform() const noexcept;
     [[nodiscard]] TextureHandle _encode(
         Pipeline &pipeline, CommandBuffer &command_buffer, uint handle_tag) const noexcept override;
 
 public:
     ImageTexture(Scene *scene, const SceneNodeDesc *desc) noexcept;
     [[nodiscard]] auto sampler() const noexcept { return _sampler; }
+    // trilinear and anisotropic filtering sample from a generated mip chain
+    [[nodiscard]] bool is_mipmapped() const noexcept;
+    // paged in on demand by the pipeline's VirtualTextureManager
+    [[nodiscard]] auto is_virtual() const noexcept { return _virtual; }
     [[nodiscard]] auto uv_scale() const noexcept { return _uv_scale; }
     [[nodiscard]] auto uv_offset() const noexcept { return _uv_offset; }
+    [[nodiscard]] auto &image() const noexcept { return _image(); }// host copy, in the encoded form
     [[nodiscard]] Float4 evaluate(
         const Pipeline &pipeline, const Interaction &it,
         const Var<TextureHandle> &handle, Expr<float> time) const noexcept override;
@@ -22,6 +22,13 @@ float4x4 TransformTree::Node::matrix(float time) const noexcept {
     return m;
 }
 
+bool TransformTree::Node::is_static() const noexcept {
+    for (auto node = this; node != nullptr; node = node->_parent) {
+        if (!node->_transform->is_static()) { return false; }
+    }
+    return true;
+}
+
 TransformTree::TransformTree() noexcept {
     _node_stack.emplace_back(nullptr);
     _static_stack.emplace_back(true);
@@ -58,4 +65,15 @@ std::pair<const TransformTree::Node *, bool> TransformTree::leaf(
     return std::make_pair(p_node, is_static);
 }
 
+size_t TransformTree::replace(const Transform *old_t, const Transform *new_t) noexcept {
+    auto count = static_cast<size_t>(0u);
+    for (auto &&node : _nodes) {
+        if (node->transform() == old_t) {
+            node->set_transform(new_t);
+            count++;
+        }
+    }
+    return count;
+}
+
 }// namespace luisa::render
@@ -33,6 +33,8 @@ public:
         Node(const Node *parent, const Transform *t) noexcept;
         [[nodiscard]] auto transform() const noexcept { return _transform; }
         [[nodiscard]] float4x4 matrix(float time) const noexcept;
+        [[nodiscard]] bool is_static() const noexcept;
+        void set_transform(const Transform *t) noexcept { _transform = t; }
     };
 
 private:
@@ -47,6 +49,8 @@ public:
     void push(const Transform *t) noexcept;
     void pop(const Transform *t) noexcept;
     [[nodiscard]] std::pair<const Node *, bool /* is_static */> leaf(const Transform *t) noexcept;
+    // points the nodes created for `old_t` to `new_t`; returns the number of nodes updated
+    size_t replace(const Transform *old_t, const Transform *new_t) noexcept;
 };
 
 class InstancedTransform {
@@ -58,6 +62,7 @@ private:
 public:
     InstancedTransform(const TransformTree::Node *node, size_t inst) noexcept
         : _node{node}, _instance_id{inst} {}
+    [[nodiscard]] auto node() const noexcept { return _node; }
     [[nodiscard]] auto instance_id() const noexcept { return _instance_id; }
     [[nodiscard]] auto matrix(float time) const noexcept {
         return _node == nullptr ? make_float4x4(1.0f) : _node->matrix(time);
@@ -0,0 +1,329 @@
+#include <tuple>
+#include <algorithm>
+
+#include <util/half.h>
+#include <util/parallel.h>
+#include <base/pipeline.h>
+#include <base/virtual_texture.h>
+
+namespace luisa::render {
+
+using namespace luisa::compute;
+
+namespace detail {
+
+// texels are decoded the way the device reads them, i.e. bytes are normalized
+[[nodiscard]] float4 load_virtual_texel(const LoadedImage &image, uint x, uint y) noexcept {
+    auto channels = image.channels();
+    auto index = (static_cast<size_t>(y) * image.size().x + x) * channels;
+    auto decode = [&](uint c) noexcept {
+        switch (image.pixel_storage()) {
+            case PixelStorage::BYTE1:
+            case PixelStorage::BYTE2:
+            case PixelStorage::BYTE4:
+                return static_cast<float>(static_cast<const uint8_t *>(image.pixels())[index + c]) * (1.0f / 255.0f);
+            case PixelStorage::HALF1:
+            case PixelStorage::HALF2:
+            case PixelStorage::HALF4:
+                return half_to_float(static_cast<uint>(static_cast<const uint16_t *>(image.pixels())[index + c]));
+            default: break;
+        }
+        return static_cast<const float *>(image.pixels())[index + c];
+    };
+    auto texel = make_float4(0.0f);
+    for (auto c = 0u; c < channels; c++) { texel[c] = decode(c); }
+    return texel;
+}
+
+// maps a texel coordinate outside [0, size) back into the image, or returns false for zero padding
+[[nodiscard]] bool address_virtual_texel(int &p, uint size, TextureSampler::Address address) noexcept {
+    auto n = static_cast<int>(size);
+    if (p >= 0 && p < n) { return true; }
+    switch (address) {
+        case TextureSampler::Address::REPEAT: p = (p % n + n) % n; return true;
+        case TextureSampler::Address::ZERO: return false;
+        default: p = std::clamp(p, 0, n - 1); return true;// edge texels are mirrored onto themselves
+    }
+}
+
+}// namespace detail
+
+VirtualTextureManager::VirtualTextureManager(Pipeline &pipeline) noexcept
+    : _pipeline{pipeline},
+      _feedback_event{pipeline.device().create_event()} {
+    auto &&device = pipeline.device();
+    Kernel1D clear_feedback = [](BufferUInt feedback) noexcept {
+        feedback.write(dispatch_x(), 0u);
+    };
+    // pages are staged back to back, each as slot_size rows of slot_size texels
+    Kernel2D copy_pages = [](ImageFloat atlas, BufferFloat4 staging, BufferUInt slots) noexcept {
+        auto p = dispatch_id().xy();
+        auto k = p.y / slot_size;
+        auto local = make_uint2(p.x, p.y % slot_size);
+        auto slot = slots.read(k);
+        auto origin = make_uint2(slot % atlas_slots_per_side, slot / atlas_slots_per_side) * slot_size;
+        atlas.write(origin + local, staging.read((k * slot_size + local.y) * slot_size + local.x));
+    };
+    _clear_feedback = device.compile(clear_feedback);
+    _copy_pages = device.compile(copy_pages);
+}
+
+bool VirtualTextureManager::is_supported(PixelStorage storage) noexcept {
+    switch (storage) {
+        case PixelStorage::BYTE1:
+        case PixelStorage::BYTE2:
+        case PixelStorage::BYTE4:
+        case PixelStorage::HALF1:
+        case PixelStorage::HALF2:
+        case PixelStorage::HALF4:
+        case PixelStorage::FLOAT1:
+        case PixelStorage::FLOAT2:
+        case PixelStorage::FLOAT4: return true;
+        default: break;
+    }
+    return false;
+}
+
+uint VirtualTextureManager::_atlas(PixelStorage storage) noexcept {
+    if (auto iter = std::find_if(_atlases.cbegin(), _atlases.cend(), [storage](auto &&a) noexcept {
+            return a.storage == storage;
+        });
+        iter != _atlases.cend()) {
+        return static_cast<uint>(std::distance(_atlases.cbegin(), iter));
+    }
+    auto image = _pipeline.create<Image<float>>(
+        storage, make_uint2(atlas_slots_per_side * slot_size));
+    // the borders of the slots take care of filtering and addressing
+    auto tex_id = _pipeline.register_bindless(
+        *image, TextureSampler{TextureSampler::Filter::LINEAR_POINT,
+                               TextureSampler::Address::EDGE});
+    _atlases.emplace_back(Atlas{
+        .storage = storage, .image = image, .tex_id = tex_id,
+        .slot_pages = luisa::vector<uint>(atlas_slot_count, non_resident),
+        .slot_last_use = luisa::vector<uint64_t>(atlas_slot_count, 0u)});
+    return static_cast<uint>(_atlases.size() - 1u);
+}
+
+auto VirtualTextureManager::_staging_batch(uint index) noexcept -> StagingBatch & {
+    while (_staging.size() <= index) {
+        auto &&device = _pipeline.device();
+        auto texel_count = max_uploads_per_stream * slot_size * slot_size;
+        _staging.emplace_back(StagingBatch{
+            .texels_host = luisa::vector<float4>(texel_count),
+            .slots_host = luisa::vector<uint>(max_uploads_per_stream),
+            .texels = device.create_buffer<float4>(texel_count),
+            .slots = device.create_buffer<uint>(max_uploads_per_stream)});
+    }
+    return _staging[index];
+}
+
+uint VirtualTextureManager::register_texture(const LoadedImage &image, TextureSampler::Address address) noexcept {
+    if (auto iter = std::find_if(_textures.cbegin(), _textures.cend(), [&image, address](auto &&t) noexcept {
+            return t.image == &image && t.address == address;
+        });
+        iter != _textures.cend()) {
+        return iter->offset;
+    }
+    if (!is_supported(image.pixel_storage())) [[unlikely]] {
+        LUISA_ERROR_WITH_LOCATION(
+            "Virtual textures are not supported for pixel storage 0x{:02x}.",
+            luisa::to_underlying(image.pixel_storage()));
+    }
+    auto size = image.size();
+    auto page_count = (size + page_size - 1u) / page_size;
+    // the average color stands in for non-resident pages; estimated on a
+    // strided grid so that registration does not touch every texel
+    auto stride = max((size + 255u) / 256u, make_uint2(1u));
+    auto sum = make_float4(0.0f);
+    auto n = 0u;
+    for (auto y = 0u; y < size.y; y += stride.y) {
+        for (auto x = 0u; x < size.x; x += stride.x) {
+            sum += detail::load_virtual_texel(image, x, y);
+            n++;
+        }
+    }
+    auto average = sum / static_cast<float>(std::max(n, 1u));
+    auto texture = VirtualTexture{
+        .image = &image, .address = address,
+        .atlas = _atlas(image.pixel_storage()),
+        .offset = static_cast<uint>(_indirection_host.size()),
+        .page_count = page_count};
+    _indirection_host.emplace_back(size.x);
+    _indirection_host.emplace_back(size.y);
+    _indirection_host.emplace_back(_atlases[texture.atlas].tex_id);
+    _indirection_host.emplace_back(static_cast<uint>(luisa::to_underlying(address)));
+    _indirection_host.emplace_back(float_to_half(average.x) | (float_to_half(average.y) << 16u));
+    _indirection_host.emplace_back(float_to_half(average.z) | (float_to_half(average.w) << 16u));
+    _indirection_host.resize(_indirection_host.size() + page_count.x * page_count.y, non_resident);
+    _textures.emplace_back(texture);
+    LUISA_INFO(
+        "Registered {}x{} virtual texture with {}x{} page(s).",
+        size.x, size.y, page_count.x, page_count.y);
+    return texture.offset;
+}
+
+bool VirtualTextureManager::commit(CommandBuffer &command_buffer) noexcept {
+    auto n = _indirection_host.size();
+    if (n == _committed_entry_count) { return false; }
+    auto &&device = _pipeline.device();
+    _indirection = device.create_buffer<uint>(n);
+    _feedback = device.create_buffer<uint>(n);
+    _feedback_host.resize(n);
+    _feedback_pending = false;
+    command_buffer << _indirection.copy_from(_indirection_host.data())
+                   << _clear_feedback(_feedback).dispatch(static_cast<uint>(n))
+                   << compute::commit();
+    _committed_entry_count = n;
+    return true;
+}
+
+void VirtualTextureManager::_fill_page(const VirtualTexture &texture, uint page, float4 *texels) const noexcept {
+    auto &&image = *texture.image;
+    auto origin = make_int2(make_uint2(page % texture.page_count.x, page / texture.page_count.x) * page_size) -
+                  static_cast<int>(page_border);
+    for (auto y = 0u; y < slot_size; y++) {
+        for (auto x = 0u; x < slot_size; x++) {
+            auto px = origin.x + static_cast<int>(x);
+            auto py = origin.y + static_cast<int>(y);
+            auto valid = detail::address_virtual_texel(px, image.size().x, texture.address) &
+                         detail::address_virtual_texel(py, image.size().y, texture.address);
+            texels[y * slot_size + x] = valid ?
+                                            detail::load_virtual_texel(image, px, py) :
+                                            make_float4(0.0f);
+        }
+    }
+}
+
+void VirtualTextureManager::_read_feedback(Stream &stream, CommandBuffer &command_buffer) noexcept {
+    command_buffer << _feedback.copy_to(_feedback_host.data())
+                   << _clear_feedback(_feedback).dispatch(static_cast<uint>(_committed_entry_count))
+                   << compute::commit();
+    stream << _feedback_event.signal();
+    _feedback_pending = true;
+}
+
+uint VirtualTextureManager::stream(Stream &stream, uint max_uploads, bool up_to_date) noexcept {
+    if (_committed_entry_count == 0u) { return 0u; }
+    auto command_buffer = stream.command_buffer();
+    if (up_to_date || !_feedback_pending) { _read_feedback(stream, command_buffer); }
+    // the only wait; it also guarantees that the uploads of the last call,
+    // which were queued before the event, are done with the host buffers
+    _feedback_event.synchronize();
+    _feedback_pending = false;
+    _frame++;
+
+    // touch the resident pages and collect the missing ones
+    luisa::vector<std::pair<uint /* texture */, uint /* page */>> requests;
+    for (auto t = 0u; t < _textures.size(); t++) {
+        auto &&texture = _textures[t];
+        auto &&atlas = _atlases[texture.atlas];
+        auto first_entry = texture.offset + header_size;
+        for (auto page = 0u; page < texture.page_count.x * texture.page_count.y; page++) {
+            if (_feedback_host[first_entry + page] == 0u) { continue; }
+            if (auto slot = _indirection_host[first_entry + page]; slot == non_resident) {
+                requests.emplace_back(t, page);
+            } else {
+                atlas.slot_last_use[slot] = _frame;
+            }
+        }
+    }
+
+    // replace the least recently used pages, but never those used in this frame
+    auto uploaded = 0u;
+    auto batch_count = 0u;
+    luisa::vector<std::tuple<uint /* texture */, uint /* page */, uint /* slot */>> batch;
+    auto flush = [&](const Atlas &atlas) noexcept {
+        auto &&staging = _staging_batch(batch_count++);
+        auto batch_size = static_cast<uint>(batch.size());
+        parallel_for_with_caller(batch_size, [this, &batch, &staging](size_t i) noexcept {
+            auto [t, page, slot] = batch[i];
+            _fill_page(_textures[t], page, staging.texels_host.data() + i * slot_size * slot_size);
+            staging.slots_host[i] = slot;
+        });
+        command_buffer << staging.texels.view(0u, batch_size * slot_size * slot_size).copy_from(staging.texels_host.data())
+                       << staging.slots.view(0u, batch_size).copy_from(staging.slots_host.data())
+                       << _copy_pages(*atlas.image, staging.texels, staging.slots).dispatch(slot_size, batch_size * slot_size);
+        uploaded += batch_size;
+        batch.clear();
+    };
+    for (auto a = 0u; a < _atlases.size(); a++) {
+        auto &&atlas = _atlases[a];
+        batch.clear();
+        for (auto [t, page] : requests) {
+            if (_textures[t].atlas != a) { continue; }
+            if (uploaded + batch.size() == max_uploads) { break; }
+            auto slot = static_cast<uint>(std::distance(
+                atlas.slot_last_use.cbegin(),
+                std::min_element(atlas.slot_last_use.cbegin(), atlas.slot_last_use.cend())));
+            if (atlas.slot_last_use[slot] == _frame) [[unlikely]] {
+                if (!_warned_full) {
+                    LUISA_WARNING_WITH_LOCATION(
+                        "Virtual texture atlas is too small for the pages "
+                        "used in a single frame ({} slots).",
+                        atlas_slot_count);
+                    _warned_full = true;
+                }
+                break;
+            }
+            if (auto old_entry = atlas.slot_pages[slot]; old_entry != non_resident) {
+                _indirection_host[old_entry] = non_resident;
+            } else {
+                _resident_count++;
+            }
+            auto entry = _textures[t].offset + header_size + page;
+            _indirection_host[entry] = slot;
+            atlas.slot_pages[slot] = entry;
+            atlas.slot_last_use[slot] = _frame;
+            batch.emplace_back(t, page, slot);
+            if (batch.size() == max_uploads_per_stream) { flush(atlas); }
+        }
+        if (!batch.empty()) { flush(atlas); }
+    }
+    _missing_count = requests.size() - uploaded;
+    if (uploaded != 0u) { command_buffer << _indirection.copy_from(_indirection_host.data()); }
+    // read back behind the uploads and the frames rendered so far, which the
+    // next call processes; an up-to-date call reads back its own feedback instead
+    if (up_to_date) {
+        command_buffer << compute::commit();
+    } else {
+        _read_feedback(stream, command_buffer);
+    }
+    return uploaded;
+}
+
+Float4 VirtualTextureManager::sample(Expr<uint> offset, Expr<float2> uv) const noexcept {
+    auto size = make_uint2(_indirection.read(offset), _indirection.read(offset + 1u));
+    auto tex_id = _indirection.read(offset + 2u);
+    auto address = _indirection.read(offset + 3u);
+    auto rg = _indirection.read(offset + 4u);
+    auto ba = _indirection.read(offset + 5u);
+    auto average = make_float4(
+        half_to_float(rg & 0xffffu), half_to_float(rg >> 16u),
+        half_to_float(ba & 0xffffu), half_to_float(ba >> 16u));
+    auto address_is = [&address](TextureSampler::Address a) noexcept {
+        return address == static_cast<uint>(luisa::to_underlying(a));
+    };
+    auto mirrored = 1.0f - abs(1.0f - fract(uv * 0.5f) * 2.0f);
+    auto st = ite(address_is(TextureSampler::Address::REPEAT), fract(uv),
+                  ite(address_is(TextureSampler::Address::MIRROR), mirrored,
+                      clamp(uv, 0.0f, 1.0f)));
+    auto p = st * make_float2(size);
+    auto page_count = (size + page_size - 1u) / page_size;
+    auto page = min(make_uint2(p * (1.0f / static_cast<float>(page_size))), page_count - 1u);
+    auto entry = offset + header_size + page.y * page_count.x + page.x;
+    _feedback.write(entry, 1u);
+    auto slot = _indirection.read(entry);
+    auto value = def(average);
+    $if(slot != non_resident) {
+        auto origin = make_uint2(slot % atlas_slots_per_side, slot / atlas_slots_per_side) * slot_size + page_border;
+        auto atlas_uv = (make_float2(origin) + p - make_float2(page * page_size)) *
+                        (1.0f / static_cast<float>(atlas_slots_per_side * slot_size));
+        value = _pipeline.tex2d(tex_id).sample(atlas_uv);
+    };
+    $if(address_is(TextureSampler::Address::ZERO) & any(uv < 0.0f | uv > 1.0f)) {
+        value = make_float4(0.0f);
+    };
+    return value;
+}
+
+}// namespace luisa::render
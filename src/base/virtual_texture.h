@@ -0,0 +1,118 @@
+#pragma once
+
+#include <luisa-compute.h>
+#include <util/imageio.h>
+
+namespace luisa::render {
+
+using compute::Buffer;
+using compute::CommandBuffer;
+using compute::Event;
+using compute::Expr;
+using compute::Float4;
+using compute::Image;
+using compute::PixelStorage;
+using compute::Stream;
+using TextureSampler = compute::Sampler;
+
+class Pipeline;
+
+// Out-of-core image textures. A virtual texture is split into pages of
+// page_size x page_size texels, and only the recently used pages are kept in
+// a fixed-size physical atlas on the device (one atlas per pixel storage).
+// Kernels translate texel coordinates through the indirection table and mark
+// every page they touch in the feedback buffer; stream() then uploads the
+// pages missing from the feedback read back by its previous call and evicts
+// the least recently used ones, so that it never waits for the frames just
+// submitted. Pages that are not resident yet
+// evaluate to the average color of the texture. Image textures spill the host
+// images of virtual textures to disk (see LoadedImage::spill()), so only the
+// texels read for recent uploads are kept in host memory.
+class VirtualTextureManager {
+
+public:
+    static constexpr auto page_size = 128u;
+    static constexpr auto page_border = 1u;// replicated neighbor texels for bilinear filtering
+    static constexpr auto slot_size = page_size + 2u * page_border;
+    static constexpr auto atlas_slots_per_side = 32u;
+    static constexpr auto atlas_slot_count = atlas_slots_per_side * atlas_slots_per_side;
+    static constexpr auto max_uploads_per_stream = 64u;
+    // per-texture entries preceding its page table in the indirection table:
+    // width, height, atlas bindless id, address mode, and the average color as 4 halves
+    static constexpr auto header_size = 6u;
+    static constexpr auto non_resident = ~0u;
+
+private:
+    struct VirtualTexture {
+        const LoadedImage *image;
+        TextureSampler::Address address;
+        uint atlas;
+        uint offset;// of the header in the indirection table
+        uint2 page_count;
+    };
+
+    struct Atlas {
+        PixelStorage storage;
+        const Image<float> *image;
+        uint tex_id;
+        luisa::vector<uint> slot_pages;// indirection entry of the page in each slot
+        luisa::vector<uint64_t> slot_last_use;
+    };
+
+    // up to max_uploads_per_stream pages; each batch of a stream() call has its
+    // own, so that all the uploads are submitted at once
+    struct StagingBatch {
+        luisa::vector<float4> texels_host;
+        luisa::vector<uint> slots_host;
+        Buffer<float4> texels;
+        Buffer<uint> slots;
+    };
+
+private:
+    Pipeline &_pipeline;
+    luisa::vector<VirtualTexture> _textures;
+    luisa::vector<Atlas> _atlases;
+    luisa::vector<uint> _indirection_host;
+    luisa::vector<uint> _feedback_host;
+    luisa::vector<StagingBatch> _staging;
+    Buffer<uint> _indirection;
+    Buffer<uint> _feedback;
+    Event _feedback_event;// signaled once the feedback is read back
+    compute::Shader1D<Buffer<uint>> _clear_feedback;
+    compute::Shader2D<Image<float>, Buffer<float4>, Buffer<uint>> _copy_pages;
+    uint64_t _frame{0u};
+    size_t _committed_entry_count{0u};
+    size_t _resident_count{0u};
+    size_t _missing_count{0u};
+    bool _feedback_pending{false};
+    bool _warned_full{false};
+
+private:
+    [[nodiscard]] uint _atlas(PixelStorage storage) noexcept;
+    [[nodiscard]] StagingBatch &_staging_batch(uint index) noexcept;
+    void _read_feedback(Stream &stream, CommandBuffer &command_buffer) noexcept;
+    void _fill_page(const VirtualTexture &texture, uint page, float4 *texels) const noexcept;
+
+public:
+    explicit VirtualTextureManager(Pipeline &pipeline) noexcept;
+    [[nodiscard]] static bool is_supported(PixelStorage storage) noexcept;
+    // returns the offset of the texture in the indirection table
+    [[nodiscard]] uint register_texture(const LoadedImage &image, TextureSampler::Address address) noexcept;
+    // (re-)creates the device buffers if textures were registered since the
+    // last call; returns true if kernels capturing them must be recompiled
+    [[nodiscard]] bool commit(CommandBuffer &command_buffer) noexcept;
+    // processes the feedback read back at the end of the last call, i.e. of the
+    // frames rendered before it, and uploads up to `max_uploads` of the missing
+    // pages; with `up_to_date`, or on the first call, the feedback of all the
+    // frames submitted so far is waited for instead. Returns the number of
+    // uploaded pages; waits on the device at most once
+    uint stream(Stream &stream, uint max_uploads = max_uploads_per_stream, bool up_to_date = false) noexcept;
+    [[nodiscard]] auto texture_count() const noexcept { return _textures.size(); }
+    [[nodiscard]] auto resident_page_count() const noexcept { return _resident_count; }
+    // pages requested by the frames processed in the last stream() call that
+    // are still not resident, e.g., because of the upload limit
+    [[nodiscard]] auto missing_page_count() const noexcept { return _missing_count; }
+    [[nodiscard]] Float4 sample(Expr<uint> offset, Expr<float2> uv) const noexcept;
+};
+
+}// namespace luisa::render
@@ -30,6 +30,7 @@ public:
     [[nodiscard]] Camera::Sample generate_ray(
         Sampler::Instance &sampler,
         Expr<float2> pixel, Expr<float> time) const noexcept override;
+    [[nodiscard]] float pixel_spread_angle() const noexcept override;
 };
 
 class PinholeCamera final : public Camera {
@@ -82,6 +83,11 @@ Camera::Sample PinholeCameraInstance::generate_ray(
     return Camera::Sample{make_ray(_position, direction), 1.0f};
 }
 
+float PinholeCameraInstance::pixel_spread_angle() const noexcept {
+    // pixel height on the image plane at unit distance
+    return 2.0f * std::tan(_fov * 0.5f) / static_cast<float>(node()->film()->resolution().y);
+}
+
 }// namespace luisa::render
 
 LUISA_RENDER_MAKE_SCENE_NODE_PLUGIN(luisa::render::PinholeCamera)
@@ -88,6 +88,9 @@ public:
         auto p_lens = coord_lens.x * _left + coord_lens.y * _up;
         return {.ray = make_ray(p_lens + _position, normalize(p_focal - p_lens)), .weight = 1.f};
     }
+    [[nodiscard]] float pixel_spread_angle() const noexcept override {
+        return _projected_pixel_size / _focal_plane;
+    }
 };
 
 luisa::unique_ptr<Camera::Instance> ThinlensCamera::build(
@@ -41,10 +41,18 @@ using namespace luisa::compute;
 
 class EnvironmentMappingInstance final : public Environment::Instance {
 
+public:
+    static constexpr auto max_distribution_resolution = make_uint2(2048u, 1024u);
+
 private:
     TextureHandle _texture;
+    uint2 _distribution_resolution{};// zero if sampled uniformly
+    uint _alias_table_buffer_id{};   // marginal (per row) entries, followed by the per-row conditional entries
+    uint _pdf_buffer_id{};           // normalized probability of each cell
 
 private:
+    [[nodiscard]] static float _rsp_luminance(float4 rsp_scale) noexcept;
+    void _build_distribution(Pipeline &pipeline, CommandBuffer &command_buffer, const ImageTexture *texture) noexcept;
     [[nodiscard]] auto _evaluate(Expr<float3> wi_local, const SampledWavelengths &swl, Expr<float> time) const noexcept {
         auto env = static_cast<const EnvironmentMapping *>(node());
         auto theta = acos(wi_local.y);
@@ -53,14 +61,28 @@ private:
         auto v = theta * inv_pi;
         Interaction it{-wi_local, make_float2(u, v)};
         auto L = pipeline().evaluate_illuminant_texture(_texture, it, swl, time);
-        return Light::Evaluation{.L = L * env->scale(), .pdf = uniform_sphere_pdf()};
+        auto pdf = def(uniform_sphere_pdf());
+        if (all(_distribution_resolution != 0u)) {
+            auto sin_theta = sqrt(max(1.0f - wi_local.y * wi_local.y, 0.0f));
+            auto uv = make_float2(fract(u), v);
+            auto cell = min(make_uint2(uv * make_float2(_distribution_resolution)),
+                            _distribution_resolution - 1u);
+            auto p = pipeline().buffer<float>(_pdf_buffer_id)
+                         .read(cell.y * _distribution_resolution.x + cell.x);
+            auto pdf_uv = p * static_cast<float>(_distribution_resolution.x * _distribution_resolution.y);
+            pdf = ite(sin_theta > 0.0f, pdf_uv * (0.5f * inv_pi * inv_pi) / sin_theta, 0.0f);
+        }
+        return Light::Evaluation{.L = L * env->scale(), .pdf = pdf};
     }
 
 public:
     EnvironmentMappingInstance(Pipeline &pipeline, CommandBuffer &command_buffer, const EnvironmentMapping *env) noexcept
         : Environment::Instance{pipeline, env},
-          _texture{*pipeline.encode_texture(command_buffer, env->emission())} {}
-    // TODO: importance sampling
+          _texture{*pipeline.encode_texture(command_buffer, env->emission())} {
+        if (auto image_texture = dynamic_cast<const ImageTexture *>(env->emission())) {
+            _build_distribution(pipeline, command_buffer, image_texture);
+        }
+    }
     [[nodiscard]] Light::Evaluation evaluate(
         Expr<float3> wi, Expr<float3x3> env_to_world,
         const SampledWavelengths &swl, Expr<float> time) const noexcept override {
@@ -70,12 +92,135 @@ public:
     [[nodiscard]] Light::Sample sample(
         Sampler::Instance &sampler, const Interaction &it_from, Expr<float3x3> env_to_world,
         const SampledWavelengths &swl, Expr<float> time) const noexcept override {
-        auto local_wi = sample_uniform_sphere(sampler.generate_2d());
+        auto u = sampler.generate_2d();
+        auto local_wi = def(make_float3());
+        if (all(_distribution_resolution != 0u)) {
+            struct ConditionalTable {
+                BindlessBuffer<AliasEntry> table;
+                UInt offset;
+                [[nodiscard]] auto read(Expr<uint> i) const noexcept { return table.read(offset + i); }
+            };
+            auto table = pipeline().buffer<AliasEntry>(_alias_table_buffer_id);
+            auto [row, v_remapped] = sample_alias_table(table, _distribution_resolution.y, u.y);
+            ConditionalTable conditional{table, _distribution_resolution.y + row * _distribution_resolution.x};
+            auto [column, u_remapped] = sample_alias_table(conditional, _distribution_resolution.x, u.x);
+            auto uv = (make_float2(make_uint2(column, row)) + make_float2(u_remapped, v_remapped)) /
+                      make_float2(_distribution_resolution);
+            auto theta = uv.y * pi;
+            auto phi = -2.0f * pi * uv.x;
+            auto sin_theta = sin(theta);
+            local_wi = make_float3(sin_theta * sin(phi), cos(theta), sin_theta * cos(phi));
+        } else {
+            local_wi = sample_uniform_sphere(u);
+        }
         return {.eval = _evaluate(local_wi, swl, time),
                 .shadow_ray = it_from.spawn_ray(env_to_world * local_wi)};
     }
 };
 
+float EnvironmentMappingInstance::_rsp_luminance(float4 rsp_scale) noexcept {
+    // analytic fit of the CIE Y matching function (Wyman et al. 2013)
+    constexpr auto cie_y = [](float lambda) noexcept {
+        auto g = [lambda](float mu, float s1, float s2) noexcept {
+            auto t = (lambda - mu) / (lambda < mu ? s1 : s2);
+            return std::exp(-0.5f * t * t);
+        };
+        return 0.821f * g(568.8f, 46.9f, 40.5f) + 0.286f * g(530.9f, 16.3f, 31.1f);
+    };
+    auto sum = 0.0f;
+    auto weight_sum = 0.0f;
+    for (auto lambda = visible_wavelength_min; lambda <= visible_wavelength_max; lambda += 10.0f) {
+        auto x = (rsp_scale.x * lambda + rsp_scale.y) * lambda + rsp_scale.z;
+        auto s = std::isinf(x) ? (x > 0.0f ? 1.0f : 0.0f) : 0.5f + 0.5f * x / std::sqrt(1.0f + x * x);
+        auto w = cie_y(lambda);
+        sum += s * w;
+        weight_sum += w;
+    }
+    return std::max(rsp_scale.w * sum / weight_sum, 0.0f);
+}
+
+void EnvironmentMappingInstance::_build_distribution(Pipeline &pipeline, CommandBuffer &command_buffer, const ImageTexture *texture) noexcept {
+    Clock clock;
+    auto &&image = texture->image();
+    auto size = image.size();
+    auto half = image.pixel_storage() == PixelStorage::HALF4;
+    if (!half && image.pixel_storage() != PixelStorage::FLOAT4) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Unsupported pixel storage for environment "
+            "importance sampling. Falling back to uniform sampling.");
+        return;
+    }
+    auto texel = [&](float2 uv) noexcept {
+        auto st = uv * texture->uv_scale() + texture->uv_offset();
+        st -= floor(st);
+        auto xy = min(make_uint2(st * make_float2(size)), size - 1u);
+        auto index = xy.y * size.x + xy.x;
+        if (half) {
+            auto p = static_cast<const std::array<uint16_t, 4u> *>(image.pixels())[index];
+            return make_float4(half_to_float(p[0]), half_to_float(p[1]),
+                               half_to_float(p[2]), half_to_float(p[3]));
+        }
+        return static_cast<const float4 *>(image.pixels())[index];
+    };
+    auto resolution = min(size, max_distribution_resolution);
+    auto cell_count = resolution.x * resolution.y;
+    // luminance * sin(theta), with 2x2 sub-samples per cell so
+    // that small bright features (e.g., the sun) are not missed
+    luisa::vector<float> weights(cell_count);
+    auto luminance_sum = 0.0;
+    for (auto y = 0u; y < resolution.y; y++) {
+        auto sin_theta = std::sin(pi * (static_cast<float>(y) + 0.5f) / static_cast<float>(resolution.y));
+        for (auto x = 0u; x < resolution.x; x++) {
+            auto lum = 0.0f;
+            for (auto i = 0u; i < 4u; i++) {
+                auto offset = make_float2(
+                    static_cast<float>(i & 1u) * 0.5f + 0.25f,
+                    static_cast<float>(i >> 1u) * 0.5f + 0.25f);
+                auto uv = (make_float2(make_uint2(x, y)) + offset) / make_float2(resolution);
+                lum += 0.25f * _rsp_luminance(texel(uv));
+            }
+            luminance_sum += lum;
+            weights[y * resolution.x + x] = lum * sin_theta;
+        }
+    }
+    // keep a small uniform floor so that every direction with non-zero
+    // radiance (possibly missed by the sub-samples) can still be sampled
+    auto floor_value = static_cast<float>(1e-3 * luminance_sum / cell_count);
+    if (floor_value == 0.0f) { floor_value = 1.0f; }
+    for (auto y = 0u; y < resolution.y; y++) {
+        auto sin_theta = std::sin(pi * (static_cast<float>(y) + 0.5f) / static_cast<float>(resolution.y));
+        for (auto x = 0u; x < resolution.x; x++) {
+            weights[y * resolution.x + x] += floor_value * sin_theta;
+        }
+    }
+    luisa::vector<float> row_weights(resolution.y);
+    luisa::vector<AliasEntry> alias_table(resolution.y + cell_count);
+    luisa::vector<float> pdf(cell_count);
+    for (auto y = 0u; y < resolution.y; y++) {
+        auto row = luisa::span{weights}.subspan(y * resolution.x, resolution.x);
+        row_weights[y] = std::reduce(row.begin(), row.end(), 0.0f);
+        auto [table, _] = create_alias_table(row);
+        std::copy(table.cbegin(), table.cend(), alias_table.begin() + resolution.y + y * resolution.x);
+    }
+    auto [marginal_table, _] = create_alias_table(row_weights);
+    std::copy(marginal_table.cbegin(), marginal_table.cend(), alias_table.begin());
+    auto weight_sum = std::reduce(row_weights.cbegin(), row_weights.cend(), 0.0);
+    std::transform(weights.cbegin(), weights.cend(), pdf.begin(), [weight_sum](auto w) noexcept {
+        return static_cast<float>(w / weight_sum);
+    });
+    auto [alias_buffer_view, alias_buffer_id] = pipeline.arena_buffer<AliasEntry>(alias_table.size());
+    auto [pdf_buffer_view, pdf_buffer_id] = pipeline.arena_buffer<float>(pdf.size());
+    command_buffer << alias_buffer_view.copy_from(alias_table.data())
+                   << pdf_buffer_view.copy_from(pdf.data())
+                   << compute::commit();// lifetime
+    _alias_table_buffer_id = alias_buffer_id;
+    _pdf_buffer_id = pdf_buffer_id;
+    _distribution_resolution = resolution;
+    LUISA_INFO(
+        "Built {}x{} importance map for environment in {} ms.",
+        resolution.x, resolution.y, clock.toc());
+}
+
 unique_ptr<Environment::Instance> EnvironmentMapping::build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept {
     return luisa::make_unique<EnvironmentMappingInstance>(pipeline, command_buffer, this);
 }
@@ -0,0 +1,248 @@
+#include <luisa-compute.h>
+#include <util/exr_writer.h>
+#include <base/film.h>
+#include <base/pipeline.h>
+
+namespace luisa::render {
+
+using namespace luisa::compute;
+
+class AOVFilm final : public Film {
+
+public:
+    enum struct Output : uint8_t {
+        ALBEDO,
+        NORMAL,
+        DEPTH,
+        INSTANCE
+    };
+
+private:
+    luisa::vector<Output> _outputs;
+    bool _fp16{};
+
+public:
+    AOVFilm(Scene *scene, const SceneNodeDesc *desc) noexcept
+        : Film{scene, desc},
+          _fp16{desc->property_bool_or_default("fp16", false)} {
+        auto outputs = desc->property_string_list_or_default(
+            "outputs", luisa::vector<luisa::string>{"albedo", "normal", "depth", "instance"});
+        for (auto &&name : outputs) {
+            auto output = [&] {
+                if (name == "albedo") { return Output::ALBEDO; }
+                if (name == "normal") { return Output::NORMAL; }
+                if (name == "depth") { return Output::DEPTH; }
+                if (name == "instance") { return Output::INSTANCE; }
+                LUISA_ERROR_WITH_LOCATION(
+                    "Unknown AOV output '{}'. [{}]", name,
+                    desc->source_location().string());
+            }();
+            if (std::find(_outputs.cbegin(), _outputs.cend(), output) == _outputs.cend()) {
+                _outputs.emplace_back(output);
+            }
+        }
+    }
+    [[nodiscard]] auto outputs() const noexcept { return luisa::span<const Output>{_outputs.data(), _outputs.size()}; }
+    [[nodiscard]] auto fp16() const noexcept { return _fp16; }
+    [[nodiscard]] luisa::unique_ptr<Instance> build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
+    [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+};
+
+class AOVFilmInstance final : public Film::Instance {
+
+private:
+    Image<float> _image;
+    luisa::vector<Image<float>> _outputs;// one per AOVFilm::outputs()
+    luisa::unique_ptr<TiledEXRWriter> _tile_writer;
+    Shader2D<Image<float>> _clear_image;
+
+private:
+    [[nodiscard]] auto _node() const noexcept { return static_cast<const AOVFilm *>(node()); }
+    [[nodiscard]] luisa::vector<luisa::string> _channels() const noexcept;
+    // converts `count` pixels starting at `offset` in each layer of the frame buffer into _channels()
+    void _encode_pixels(const float4 *framebuffer, size_t offset, uint count, float *pixels) const noexcept;
+
+public:
+    AOVFilmInstance(Device &device, Pipeline &pipeline, const AOVFilm *film) noexcept;
+    void accumulate(Expr<uint2> pixel, Expr<float3> rgb) const noexcept override;
+    [[nodiscard]] bool has_aovs() const noexcept override { return !_outputs.empty(); }
+    void accumulate_aovs(Expr<uint2> pixel, Expr<float3> albedo, Expr<float3> normal,
+                         Expr<float> depth, Expr<uint> instance_id) const noexcept override;
+    [[nodiscard]] uint layer_count() const noexcept override { return 1u + static_cast<uint>(_outputs.size()); }
+    void download(CommandBuffer &command_buffer, float4 *framebuffer) const noexcept override;
+    void write(const std::filesystem::path &path, const float4 *framebuffer) const noexcept override;
+    void clear(CommandBuffer &command_buffer) noexcept override;
+    void begin_tiled_output(const std::filesystem::path &path) noexcept override;
+    void write_tile(uint2 offset, uint2 extent, const float4 *framebuffer) const noexcept override;
+    void end_tiled_output() noexcept override;
+};
+
+AOVFilmInstance::AOVFilmInstance(Device &device, Pipeline &pipeline, const AOVFilm *film) noexcept
+    : Film::Instance{pipeline, film},
+      _image{device.create_image<float>(PixelStorage::FLOAT4, film->tile_size())} {
+    for (auto i = 0u; i < film->outputs().size(); i++) {
+        _outputs.emplace_back(device.create_image<float>(PixelStorage::FLOAT4, film->tile_size()));
+    }
+    Kernel2D clear_image = [](ImageFloat image) noexcept {
+        image.write(dispatch_id().xy(), make_float4(0.0f));
+    };
+    _clear_image = device.compile(clear_image);
+}
+
+void AOVFilmInstance::accumulate(Expr<uint2> pixel, Expr<float3> rgb) const noexcept {
+    $if(!any(isnan(rgb))) {
+        auto old = _image.read(pixel);
+        auto t = old.w + 1.0f;
+        _image.write(pixel, make_float4(lerp(old.xyz(), rgb, 1.0f / t), t));
+    };
+}
+
+void AOVFilmInstance::accumulate_aovs(Expr<uint2> pixel, Expr<float3> albedo, Expr<float3> normal,
+                                      Expr<float> depth, Expr<uint> instance_id) const noexcept {
+    // each layer keeps its running mean in xyz and its sample count in w
+    auto accumulate_mean = [&pixel](const Image<float> &image, Expr<float3> value) noexcept {
+        auto old = image.read(pixel);
+        auto t = old.w + 1.0f;
+        image.write(pixel, make_float4(lerp(old.xyz(), value, 1.0f / t), t));
+    };
+    auto hit = instance_id != ~0u;
+    auto outputs = _node()->outputs();
+    for (auto i = 0u; i < outputs.size(); i++) {
+        auto &&image = _outputs[i];
+        switch (outputs[i]) {
+            case AOVFilm::Output::ALBEDO:
+                $if(!any(isnan(albedo))) { accumulate_mean(image, albedo); };
+                break;
+            case AOVFilm::Output::NORMAL:
+                // background pixels keep a zero normal and depth
+                $if(hit) { accumulate_mean(image, normal); };
+                break;
+            case AOVFilm::Output::DEPTH:
+                $if(hit) { accumulate_mean(image, make_float3(depth)); };
+                break;
+            case AOVFilm::Output::INSTANCE:
+                // IDs cannot be averaged, so the first sample wins
+                $if(image.read(pixel).w == 0.0f) {
+                    auto id = ite(hit, cast<float>(instance_id), -1.0f);
+                    image.write(pixel, make_float4(make_float3(id), 1.0f));
+                };
+                break;
+        }
+    }
+}
+
+void AOVFilmInstance::download(CommandBuffer &command_buffer, float4 *framebuffer) const noexcept {
+    auto tile_size = node()->tile_size();
+    auto layer_size = tile_size.x * tile_size.y;
+    command_buffer << _image.copy_to(framebuffer);
+    for (auto i = 0u; i < _outputs.size(); i++) {
+        command_buffer << _outputs[i].copy_to(framebuffer + (i + 1u) * layer_size);
+    }
+}
+
+luisa::vector<luisa::string> AOVFilmInstance::_channels() const noexcept {
+    luisa::vector<luisa::string> channels{"R", "G", "B"};
+    for (auto output : _node()->outputs()) {
+        switch (output) {
+            case AOVFilm::Output::ALBEDO:
+                for (auto c : {"albedo.R", "albedo.G", "albedo.B"}) { channels.emplace_back(c); }
+                break;
+            case AOVFilm::Output::NORMAL:
+                for (auto c : {"normal.X", "normal.Y", "normal.Z"}) { channels.emplace_back(c); }
+                break;
+            case AOVFilm::Output::DEPTH: channels.emplace_back("depth.Z"); break;
+            case AOVFilm::Output::INSTANCE: channels.emplace_back("instance.id"); break;
+        }
+    }
+    return channels;
+}
+
+void AOVFilmInstance::_encode_pixels(const float4 *framebuffer, size_t offset,
+                                     uint count, float *pixels) const noexcept {
+    auto tile_size = node()->tile_size();
+    auto layer_size = static_cast<size_t>(tile_size.x) * tile_size.y;
+    auto outputs = _node()->outputs();
+    for (auto i = 0u; i < count; i++) {
+        auto p = framebuffer + offset + i;
+        auto beauty = p[0];
+        for (auto c = 0u; c < 3u; c++) { *pixels++ = beauty[c]; }
+        for (auto layer = 0u; layer < outputs.size(); layer++) {
+            auto value = p[(layer + 1u) * layer_size];
+            auto channel_count = outputs[layer] == AOVFilm::Output::ALBEDO ||
+                                         outputs[layer] == AOVFilm::Output::NORMAL ?
+                                     3u :
+                                     1u;
+            for (auto c = 0u; c < channel_count; c++) { *pixels++ = value[c]; }
+        }
+    }
+}
+
+void AOVFilmInstance::write(const std::filesystem::path &path, const float4 *framebuffer) const noexcept {
+    auto resolution = node()->resolution();
+    auto file_ext = path.extension().string();
+    for (auto &c : file_ext) { c = static_cast<char>(tolower(c)); }
+    if (file_ext != ".exr") [[unlikely]] {
+        LUISA_ERROR_WITH_LOCATION(
+            "Film extension '{}' is not supported.",
+            file_ext);
+    }
+    auto success = write_exr(path, resolution, _node()->fp16(), _channels(), [&](uint row, float *pixels) noexcept {
+        _encode_pixels(framebuffer, static_cast<size_t>(row) * resolution.x, resolution.x, pixels);
+    });
+    if (!success) [[unlikely]] {
+        LUISA_ERROR_WITH_LOCATION(
+            "Failure when writing image '{}'.",
+            path.string());
+    }
+}
+
+void AOVFilmInstance::clear(CommandBuffer &command_buffer) noexcept {
+    auto tile_size = node()->tile_size();
+    command_buffer << _clear_image(_image).dispatch(tile_size);
+    for (auto &&image : _outputs) {
+        command_buffer << _clear_image(image).dispatch(tile_size);
+    }
+}
+
+void AOVFilmInstance::begin_tiled_output(const std::filesystem::path &path) noexcept {
+    auto file_ext = path.extension().string();
+    for (auto &c : file_ext) { c = static_cast<char>(tolower(c)); }
+    if (file_ext != ".exr") [[unlikely]] {
+        LUISA_ERROR_WITH_LOCATION(
+            "Film extension '{}' is not supported for tiled output.",
+            file_ext);
+    }
+    _tile_writer = TiledEXRWriter::open(path, node()->resolution(), node()->tile_size(),
+                                        _node()->fp16(), _channels());
+    if (_tile_writer == nullptr) [[unlikely]] {
+        LUISA_ERROR_WITH_LOCATION(
+            "Failed to open image '{}' for tiled output.",
+            path.string());
+    }
+}
+
+void AOVFilmInstance::write_tile(uint2 offset, uint2 extent, const float4 *framebuffer) const noexcept {
+    auto tile_size = node()->tile_size();
+    auto channel_count = static_cast<uint>(_channels().size());
+    luisa::vector<float> pixels(extent.x * extent.y * channel_count);
+    for (auto y = 0u; y < extent.y; y++) {
+        _encode_pixels(framebuffer, static_cast<size_t>(y) * tile_size.x, extent.x,
+                       pixels.data() + y * extent.x * channel_count);
+    }
+    _tile_writer->write(offset / tile_size, pixels.data());
+}
+
+void AOVFilmInstance::end_tiled_output() noexcept {
+    if (_tile_writer != nullptr) {
+        _tile_writer->close();
+        _tile_writer = nullptr;
+    }
+}
+
+luisa::unique_ptr<Film::Instance> AOVFilm::build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept {
+    return luisa::make_unique<AOVFilmInstance>(pipeline.device(), pipeline, this);
+}
+
+}// namespace luisa::render
+
+LUISA_RENDER_MAKE_SCENE_NODE_PLUGIN(luisa::render::AOVFilm)
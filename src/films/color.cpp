@@ -2,9 +2,8 @@
 // Created by Mike on 2022/1/7.
 //
 
-#include <tinyexr.h>
-
 #include <luisa-compute.h>
+#include <util/exr_writer.h>
 #include <base/film.h>
 #include <base/pipeline.h>
 
@@ -17,11 +16,13 @@ class ColorFilm final : public Film {
 private:
     float3 _scale;
     bool _fp16{};
+    bool _heatmap{};
 
 public:
     ColorFilm(Scene *scene, const SceneNodeDesc *desc) noexcept
         : Film{scene, desc},
-          _fp16{desc->property_bool_or_default("fp16", false)} {
+          _fp16{desc->property_bool_or_default("fp16", false)},
+          _heatmap{desc->property_bool_or_default("heatmap", false)} {
         auto exposure = desc->property_float3_or_default(
             "exposure", lazy_construct([desc] {
                 return make_float3(desc->property_float_or_default(
@@ -33,6 +34,7 @@ public:
     }
     [[nodiscard]] auto scale() const noexcept { return _scale; }
     [[nodiscard]] auto fp16() const noexcept { return _fp16; }
+    [[nodiscard]] auto heatmap() const noexcept { return _heatmap; }
     [[nodiscard]] luisa::unique_ptr<Instance> build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
 };
@@ -41,49 +43,151 @@ class ColorFilmInstance final : public Film::Instance {
 
 private:
     Image<float> _image;
+    // only allocated and updated once adaptive sampling is enabled
+    Image<float> _moments;// running mean of luminance and its square
+    Buffer<uint> _active;
+    Buffer<uint> _active_count;
+    Image<float> _heatmap;// sums of traced rays, bounces and samples
+    luisa::unique_ptr<TiledEXRWriter> _tile_writer;
     Shader2D<Image<float>> _clear_image;
+    Shader2D<Image<float>, Buffer<uint>, uint2> _clear_moments;
+    Shader2D<Image<float>> _clear_heatmap;
+    Shader2D<Image<float>, Image<float>, Buffer<uint>, Buffer<uint>, float, float> _update_active_mask;
+    Shader1D<Buffer<uint>> _reset_active_count;
+    bool _adaptive{false};
+
+private:
+    [[nodiscard]] luisa::vector<luisa::string> _channels() const noexcept;
+    // converts `count` pixels of the beauty (and heatmap) layers into channels()
+    void _encode_pixels(const float4 *image, const float4 *heatmap, uint count, float *pixels) const noexcept;
 
 public:
     ColorFilmInstance(Device &device, Pipeline &pipeline, const ColorFilm *film) noexcept;
     void accumulate(Expr<uint2> pixel, Expr<float3> rgb) const noexcept override;
-    void save(Stream &stream, const std::filesystem::path &path) const noexcept override;
+    [[nodiscard]] bool has_heatmap() const noexcept override { return static_cast<const ColorFilm *>(node())->heatmap(); }
+    void accumulate_heatmap(Expr<uint2> pixel, Expr<uint> rays, Expr<uint> bounces) const noexcept override;
+    [[nodiscard]] uint layer_count() const noexcept override { return has_heatmap() ? 2u : 1u; }
+    void download(CommandBuffer &command_buffer, float4 *framebuffer) const noexcept override;
+    void write(const std::filesystem::path &path, const float4 *framebuffer) const noexcept override;
     void clear(CommandBuffer &command_buffer) noexcept override;
+    [[nodiscard]] bool is_adaptive() const noexcept override { return true; }
+    void enable_adaptive() noexcept override;
+    [[nodiscard]] Bool is_active(Expr<uint2> pixel) const noexcept override;
+    void update_active_mask(CommandBuffer &command_buffer, float threshold,
+                            uint min_samples, uint *active_count) noexcept override;
+    void begin_tiled_output(const std::filesystem::path &path) noexcept override;
+    void write_tile(uint2 offset, uint2 extent, const float4 *framebuffer) const noexcept override;
+    void end_tiled_output() noexcept override;
 };
 
 ColorFilmInstance::ColorFilmInstance(Device &device, Pipeline &pipeline, const ColorFilm *film) noexcept
     : Film::Instance{pipeline, film},
       _image{device.create_image<float>(
-          PixelStorage::FLOAT4, film->resolution())} {
+          PixelStorage::FLOAT4, film->tile_size())} {
     Kernel2D clear_image = [](ImageFloat image) noexcept {
         image.write(dispatch_id().xy(), make_float4(0.0f));
     };
     _clear_image = device.compile(clear_image);
+    if (film->heatmap()) {
+        _heatmap = device.create_image<float>(PixelStorage::FLOAT4, film->tile_size());
+        Kernel2D clear_heatmap = [](ImageFloat heatmap) noexcept {
+            heatmap.write(dispatch_id().xy(), make_float4(0.0f));
+        };
+        _clear_heatmap = device.compile(clear_heatmap);
+    }
+}
+
+void ColorFilmInstance::enable_adaptive() noexcept {
+    if (_adaptive) { return; }
+    _adaptive = true;
+    auto &device = pipeline().device();
+    auto tile_size = node()->tile_size();
+    _moments = device.create_image<float>(PixelStorage::FLOAT2, tile_size);
+    _active = device.create_buffer<uint>(tile_size.x * tile_size.y);
+    _active_count = device.create_buffer<uint>(1u);
+    Kernel2D clear_moments = [](ImageFloat moments, BufferUInt active, UInt2 extent) noexcept {
+        auto p = dispatch_id().xy();
+        moments.write(p, make_float4(0.0f));
+        // pixels beyond a border tile are never rendered
+        active.write(p.y * dispatch_size_x() + p.x, ite(all(p < extent), 1u, 0u));
+    };
+    Kernel2D update_active_mask = [](ImageFloat image, ImageFloat moments, BufferUInt active,
+                                     BufferUInt active_count, Float threshold, Float min_samples) noexcept {
+        auto p = dispatch_id().xy();
+        auto index = p.y * dispatch_size_x() + p.x;
+        $if(active.read(index) != 0u) {
+            auto n = image.read(p).w;
+            auto m = moments.read(p).xy();
+            // relative standard error of the mean, with a floor on the
+            // denominator so that dark pixels are not sampled forever
+            auto variance = max(m.y - m.x * m.x, 0.0f) * n / max(n - 1.0f, 1.0f);
+            auto error = sqrt(variance / max(n, 1.0f)) / max(m.x, 1e-2f);
+            $if(n >= min_samples & error <= threshold) {
+                active.write(index, 0u);
+            }
+            $else {
+                active_count.atomic(0u).fetch_add(1u);
+            };
+        };
+    };
+    Kernel1D reset_active_count = [](BufferUInt active_count) noexcept {
+        active_count.write(0u, 0u);
+    };
+    _clear_moments = device.compile(clear_moments);
+    _update_active_mask = device.compile(update_active_mask);
+    _reset_active_count = device.compile(reset_active_count);
+}
+
+void ColorFilmInstance::download(CommandBuffer &command_buffer, float4 *framebuffer) const noexcept {
+    command_buffer << _image.copy_to(framebuffer);
+    if (has_heatmap()) {
+        auto tile_size = node()->tile_size();
+        command_buffer << _heatmap.copy_to(framebuffer + tile_size.x * tile_size.y);
+    }
 }
 
-void ColorFilmInstance::save(Stream &stream, const std::filesystem::path &path) const noexcept {
+luisa::vector<luisa::string> ColorFilmInstance::_channels() const noexcept {
+    luisa::vector<luisa::string> channels{"R", "G", "B"};
+    if (has_heatmap()) {
+        channels.emplace_back("heatmap.rays");
+        channels.emplace_back("heatmap.bounces");
+    }
+    return channels;
+}
+
+void ColorFilmInstance::_encode_pixels(const float4 *image, const float4 *heatmap,
+                                       uint count, float *pixels) const noexcept {
+    auto scale = static_cast<const ColorFilm *>(node())->scale();
+    auto channel_count = has_heatmap() ? 5u : 3u;
+    for (auto i = 0u; i < count; i++) {
+        auto p = pixels + i * channel_count;
+        for (auto c = 0u; c < 3u; c++) { p[c] = scale[c] * image[i][c]; }
+        if (has_heatmap()) {
+            // total rays traced for the pixel (i.e., its cost, which depends
+            // on the number of samples taken) and mean bounces per sample
+            auto h = heatmap[i];
+            p[3] = h.x;
+            p[4] = h.y / std::max(h.z, 1.0f);
+        }
+    }
+}
+
+void ColorFilmInstance::write(const std::filesystem::path &path, const float4 *framebuffer) const noexcept {
     auto resolution = node()->resolution();
     auto file_ext = path.extension().string();
     for (auto &c : file_ext) { c = static_cast<char>(tolower(c)); }
-    std::vector<float> rgb;
-    rgb.resize(resolution.x * resolution.y * 4);
-    stream << _image.copy_to(rgb.data()) << synchronize();
     auto film = static_cast<const ColorFilm *>(node());
-    auto scale = film->scale();
-    for (auto i = 0; i < resolution.x * resolution.y; i++) {
-        for (auto c = 0; c < 3; c++) {
-            rgb[i * 3 + c] = scale[c] * rgb[i * 4 + c];
-        }
-    }
     if (file_ext == ".exr") {
-        const char *err = nullptr;
-        auto ret = SaveEXR(
-            rgb.data(), static_cast<int>(resolution.x), static_cast<int>(resolution.y),
-            3, film->fp16(), path.string().c_str(), &err);
-        if (ret != TINYEXR_SUCCESS) [[unlikely]] {
+        // scanlines are scaled and encoded by the writer in parallel
+        auto heatmap = framebuffer + resolution.x * resolution.y;
+        auto success = write_exr(path, resolution, film->fp16(), _channels(), [&](uint row, float *pixels) noexcept {
+            auto offset = static_cast<size_t>(row) * resolution.x;
+            _encode_pixels(framebuffer + offset, heatmap + offset, resolution.x, pixels);
+        });
+        if (!success) [[unlikely]] {
             LUISA_ERROR_WITH_LOCATION(
-                "Failure when writing image '{}'. "
-                "OpenEXR error: {}",
-                path.string(), err);
+                "Failure when writing image '{}'.",
+                path.string());
         }
     } else {
         LUISA_ERROR_WITH_LOCATION(
@@ -101,10 +205,83 @@ void ColorFilmInstance::accumulate(Expr<uint2> pixel, Expr<float3> rgb) const no
     auto c = rgb * (threshold / max(lum, threshold));
     auto color = ite(valid, lerp(old.xyz(), c, 1.0f / t), old.xyz());
     _image.write(pixel, make_float4(color, t));
+    if (_adaptive) {
+        $if(valid) {
+            auto y = dot(make_float3(0.212671f, 0.715160f, 0.072169f), c);
+            auto old_moments = _moments.read(pixel).xy();
+            auto moments = lerp(old_moments, make_float2(y, y * y), 1.0f / t);
+            _moments.write(pixel, make_float4(moments, 0.0f, 0.0f));
+        };
+    }
+}
+
+void ColorFilmInstance::accumulate_heatmap(Expr<uint2> pixel, Expr<uint> rays, Expr<uint> bounces) const noexcept {
+    auto old = _heatmap.read(pixel);
+    _heatmap.write(pixel, old + make_float4(cast<float>(rays), cast<float>(bounces), 1.0f, 0.0f));
 }
 
 void ColorFilmInstance::clear(CommandBuffer &command_buffer) noexcept {
-    command_buffer << _clear_image(_image).dispatch(node()->resolution());
+    command_buffer << _clear_image(_image).dispatch(node()->tile_size());
+    if (_adaptive) {
+        command_buffer << _clear_moments(_moments, _active, tile_extent())
+                              .dispatch(node()->tile_size());
+    }
+    if (has_heatmap()) {
+        command_buffer << _clear_heatmap(_heatmap).dispatch(node()->tile_size());
+    }
+}
+
+Bool ColorFilmInstance::is_active(Expr<uint2> pixel) const noexcept {
+    return _active.read(pixel.y * node()->tile_size().x + pixel.x) != 0u;
+}
+
+void ColorFilmInstance::update_active_mask(
+    CommandBuffer &command_buffer, float threshold,
+    uint min_samples, uint *active_count) noexcept {
+    command_buffer << _reset_active_count(_active_count).dispatch(1u)
+                   << _update_active_mask(_image, _moments, _active, _active_count,
+                                          threshold, static_cast<float>(min_samples))
+                          .dispatch(node()->tile_size())
+                   << _active_count.copy_to(active_count);
+}
+
+void ColorFilmInstance::begin_tiled_output(const std::filesystem::path &path) noexcept {
+    auto film = static_cast<const ColorFilm *>(node());
+    auto file_ext = path.extension().string();
+    for (auto &c : file_ext) { c = static_cast<char>(tolower(c)); }
+    if (file_ext != ".exr") [[unlikely]] {
+        LUISA_ERROR_WITH_LOCATION(
+            "Film extension '{}' is not supported for tiled output.",
+            file_ext);
+    }
+    _tile_writer = TiledEXRWriter::open(path, film->resolution(), film->tile_size(),
+                                        film->fp16(), _channels());
+    if (_tile_writer == nullptr) [[unlikely]] {
+        LUISA_ERROR_WITH_LOCATION(
+            "Failed to open image '{}' for tiled output.",
+            path.string());
+    }
+}
+
+void ColorFilmInstance::write_tile(uint2 offset, uint2 extent, const float4 *framebuffer) const noexcept {
+    auto film = static_cast<const ColorFilm *>(node());
+    auto tile_size = film->tile_size();
+    auto heatmap = framebuffer + tile_size.x * tile_size.y;
+    auto channel_count = static_cast<uint>(_channels().size());
+    luisa::vector<float> pixels(extent.x * extent.y * channel_count);
+    for (auto y = 0u; y < extent.y; y++) {
+        auto row = static_cast<size_t>(y) * tile_size.x;
+        _encode_pixels(framebuffer + row, heatmap + row, extent.x,
+                       pixels.data() + y * extent.x * channel_count);
+    }
+    _tile_writer->write(offset / tile_size, pixels.data());
+}
+
+void ColorFilmInstance::end_tiled_output() noexcept {
+    if (_tile_writer != nullptr) {
+        _tile_writer->close();
+        _tile_writer = nullptr;
+    }
 }
 
 luisa::unique_ptr<Film::Instance> ColorFilm::build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept {
@@ -2,6 +2,9 @@
 // Created by Mike Smith on 2022/1/10.
 //
 
+#include <array>
+#include <numeric>
+
 #include <luisa-compute.h>
 #include <base/pipeline.h>
 #include <base/integrator.h>
@@ -10,49 +13,223 @@ namespace luisa::render {
 
 class MegakernelPathTracing final : public Integrator {
 
+public:
+    // samples per pixel the sampler is prepared for in progressive mode without max_spp
+    static constexpr auto unlimited_progressive_spp = 1u << 16u;
+
 private:
     uint _max_depth;
     uint _rr_depth;
     float _rr_threshold;
+    float _time_budget;
+    uint _max_spp;
+    float _snapshot_interval;
+    float _adaptive_threshold;
+    uint _adaptive_min_spp;
+    uint _adaptive_interval;
+    bool _statistics;
 
 public:
     MegakernelPathTracing(Scene *scene, const SceneNodeDesc *desc) noexcept
         : Integrator{scene, desc},
           _max_depth{std::max(desc->property_uint_or_default("depth", 10u), 1u)},
           _rr_depth{std::max(desc->property_uint_or_default("rr_depth", 2u), 1u)},
-          _rr_threshold{std::max(desc->property_float_or_default("rr_threshold", 0.95f), 0.05f)} {}
+          _rr_threshold{std::max(desc->property_float_or_default("rr_threshold", 0.95f), 0.05f)},
+          _time_budget{std::max(desc->property_float_or_default("time_budget", 0.0f), 0.0f)},
+          _max_spp{desc->property_uint_or_default("max_spp", 0u)},
+          _snapshot_interval{std::max(desc->property_float_or_default("snapshot_interval", 0.0f), 0.0f)},
+          _adaptive_threshold{std::max(desc->property_float_or_default("adaptive_threshold", 0.0f), 0.0f)},
+          _adaptive_min_spp{std::max(desc->property_uint_or_default("adaptive_min_spp", 16u), 2u)},
+          _adaptive_interval{std::max(desc->property_uint_or_default("adaptive_interval", 16u), 1u)},
+          _statistics{desc->property_bool_or_default("statistics", false)} {}
     [[nodiscard]] auto max_depth() const noexcept { return _max_depth; }
     [[nodiscard]] auto rr_depth() const noexcept { return _rr_depth; }
     [[nodiscard]] auto rr_threshold() const noexcept { return _rr_threshold; }
+    [[nodiscard]] auto time_budget() const noexcept { return _time_budget; }// in seconds, zero for unlimited
+    [[nodiscard]] auto max_spp() const noexcept { return _max_spp; }        // zero for unlimited
+    [[nodiscard]] auto snapshot_interval() const noexcept { return _snapshot_interval; }// in seconds, zero to disable
+    [[nodiscard]] auto adaptive_threshold() const noexcept { return _adaptive_threshold; }// zero to disable
+    [[nodiscard]] auto adaptive_min_spp() const noexcept { return _adaptive_min_spp; }
+    [[nodiscard]] auto adaptive_interval() const noexcept { return _adaptive_interval; }
+    [[nodiscard]] auto statistics() const noexcept { return _statistics; }
+    [[nodiscard]] auto progressive() const noexcept { return _time_budget > 0.0f || _max_spp != 0u; }
     [[nodiscard]] string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+    [[nodiscard]] bool records_aovs() const noexcept override { return true; }
     [[nodiscard]] unique_ptr<Instance> build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
 };
 
+// Optional per-camera ray and path counters. The kernel tallies them in
+// registers and adds them to the device buffer once per thread, and emits
+// no instrumentation at all when statistics are disabled.
+class MegakernelPathStatistics {
+
+public:
+    enum Counter : uint {
+        PRIMARY_RAYS,
+        SECONDARY_RAYS,
+        SHADOW_RAYS,
+        OCCLUDED_SHADOW_RAYS,
+        ALPHA_PASS_THROUGHS,
+        RUSSIAN_ROULETTE_EXITS,
+        NAN_SAMPLES,
+        COUNTER_COUNT
+    };
+
+private:
+    uint _max_depth;
+    compute::Buffer<uint> _counters;
+    luisa::vector<uint> _zeros;
+    luisa::vector<uint> _host_counters;
+
+public:
+    MegakernelPathStatistics(Device &device, uint max_depth) noexcept
+        : _max_depth{max_depth},
+          // followed by the histogram of path lengths in [0, max_depth]
+          _counters{device.create_buffer<uint>(COUNTER_COUNT + max_depth + 1u)},
+          _zeros(_counters.size(), 0u), _host_counters(_counters.size(), 0u) {}
+    void clear(CommandBuffer &command_buffer) noexcept {
+        command_buffer << _counters.copy_from(_zeros.data());
+    }
+    void record(Expr<uint> path_length, Expr<uint> shadow_rays, Expr<uint> occluded_shadow_rays,
+                Expr<uint> alpha_pass_throughs, Expr<bool> russian_roulette_exit, Expr<bool> nan) const noexcept {
+        using namespace luisa::compute;
+        auto add = [this](uint counter, Expr<uint> value) noexcept {
+            $if(value != 0u) { _counters.atomic(counter).fetch_add(value); };
+        };
+        add(PRIMARY_RAYS, min(path_length, 1u));
+        add(SECONDARY_RAYS, path_length - min(path_length, 1u));
+        add(SHADOW_RAYS, shadow_rays);
+        add(OCCLUDED_SHADOW_RAYS, occluded_shadow_rays);
+        add(ALPHA_PASS_THROUGHS, alpha_pass_throughs);
+        add(RUSSIAN_ROULETTE_EXITS, ite(russian_roulette_exit, 1u, 0u));
+        add(NAN_SAMPLES, ite(nan, 1u, 0u));
+        _counters.atomic(COUNTER_COUNT + path_length).fetch_add(1u);
+    }
+    void report(Stream &stream, const std::filesystem::path &image_file, double milliseconds) noexcept {
+        stream << _counters.copy_to(_host_counters.data())
+               << compute::synchronize();
+        auto seconds = std::max(milliseconds * 1e-3, 1e-6);
+        auto rate = [seconds](uint64_t n) noexcept { return static_cast<double>(n) / seconds * 1e-6; };
+        auto c = [this](Counter counter) noexcept { return static_cast<uint64_t>(_host_counters[counter]); };
+        auto total_rays = c(PRIMARY_RAYS) + c(SECONDARY_RAYS) + c(SHADOW_RAYS);
+        auto report = luisa::format(
+            "Ray statistics for '{}' ({:.2f} ms):\n"
+            "  Primary rays:         {:>14} ({:.2f} M/s)\n"
+            "  Secondary rays:       {:>14} ({:.2f} M/s)\n"
+            "  Shadow rays:          {:>14} ({:.2f} M/s, {} occluded)\n"
+            "  Total rays:           {:>14} ({:.2f} M/s)\n"
+            "  Alpha pass-throughs:  {:>14}\n"
+            "  Russian roulette:     {:>14}\n"
+            "  NaN samples dropped:  {:>14}\n"
+            "  Path length histogram:",
+            image_file.string(), milliseconds,
+            c(PRIMARY_RAYS), rate(c(PRIMARY_RAYS)),
+            c(SECONDARY_RAYS), rate(c(SECONDARY_RAYS)),
+            c(SHADOW_RAYS), rate(c(SHADOW_RAYS)), c(OCCLUDED_SHADOW_RAYS),
+            total_rays, rate(total_rays),
+            c(ALPHA_PASS_THROUGHS), c(RUSSIAN_ROULETTE_EXITS), c(NAN_SAMPLES));
+        auto histogram = luisa::span<const uint>{_host_counters.data(), _host_counters.size()}.subspan(COUNTER_COUNT);
+        auto path_count = std::max(std::accumulate(histogram.begin(), histogram.end(), uint64_t{0u}), uint64_t{1u});
+        for (auto i = 0u; i < histogram.size(); i++) {
+            report.append(luisa::format(
+                "\n    {:>3}: {:>14} ({:.2f}%)", i, histogram[i],
+                100.0 * static_cast<double>(histogram[i]) / static_cast<double>(path_count)));
+        }
+        LUISA_INFO("{}", report);
+    }
+};
+
 class MegakernelPathTracingInstance final : public Integrator::Instance {
 
+public:
+    // Compiled kernels are kept across render() calls until an incremental
+    // pipeline update invalidates them (see Pipeline::kernel_generation()).
+    // Samplers inline spp-dependent constants and their state buffers, so
+    // a kernel is also recompiled when either of those changes.
+    struct CachedShader {
+        compute::Shader2D<uint, uint2, float4x4, float3x3, float3x3, float, float> shader;
+        uint spp;
+        uint64_t sampler_state_version;
+    };
+
 private:
     Pipeline &_pipeline;
+    luisa::vector<luisa::optional<CachedShader>> _shaders;
+    luisa::vector<luisa::unique_ptr<MegakernelPathStatistics>> _statistics;
+    uint64_t _shader_generation{};
 
 private:
+    // also enables the variance tracking of the film in adaptive mode
+    [[nodiscard]] static bool _is_adaptive(Film::Instance *film, const MegakernelPathTracing *node) noexcept;
+    // the number of samples per pixel a camera may take, for which the sampler is reset
+    [[nodiscard]] static uint _sample_count(const Camera::Instance *camera, const Film::Instance *film,
+                                            const MegakernelPathTracing *node) noexcept;
+    // clears the film, resets the sampler and returns the (possibly cached) kernel for the camera
+    [[nodiscard]] static CachedShader &_prepare_camera(
+        CommandBuffer &command_buffer, Pipeline &pipeline,
+        const Camera::Instance *camera, const Filter::Instance *filter,
+        Film::Instance *film, const MegakernelPathTracing *node,
+        luisa::optional<CachedShader> &cache, bool adaptive,
+        MegakernelPathStatistics *statistics) noexcept;
     static void _render_one_camera(
         Stream &stream, Pipeline &pipeline,
         const Camera::Instance *camera,
         const Filter::Instance *filter,
-        Film::Instance *film, uint max_depth,
-        uint rr_depth, float rr_threshold) noexcept;
+        Film::Instance *film, const MegakernelPathTracing *node,
+        luisa::optional<CachedShader> &cache,
+        MegakernelPathStatistics *statistics) noexcept;
+    [[nodiscard]] MegakernelPathStatistics *_camera_statistics(uint camera_index) noexcept;
+    void _render_cameras_interleaved(
+        Stream &stream, luisa::span<const uint> camera_indices,
+        const MegakernelPathTracing *node) noexcept;
 
 public:
     explicit MegakernelPathTracingInstance(const MegakernelPathTracing *node, Pipeline &pipeline) noexcept
         : Integrator::Instance{pipeline, node}, _pipeline{pipeline} {}
     void render(Stream &stream) noexcept override {
         auto pt = static_cast<const MegakernelPathTracing *>(node());
+        if (_shader_generation != _pipeline.kernel_generation()) {
+            _shaders.clear();
+            _shader_generation = _pipeline.kernel_generation();
+        }
+        _shaders.resize(_pipeline.camera_count());
+        // Cameras with a fixed sample budget are rendered together with their
+        // dispatches interleaved, so that small images do not leave the device
+        // idle between cameras. Progressive and tiled cameras synchronize with
+        // the host on their own schedule and are rendered one after another, as
+        // are all cameras when virtual texture pages are streamed between frames.
+        luisa::vector<uint> interleaved;
+        luisa::vector<uint> sequential;
         for (auto i = 0u; i < _pipeline.camera_count(); i++) {
             auto [camera, film, filter] = _pipeline.camera(i);
-            _render_one_camera(
-                stream, _pipeline, camera, filter, film,
-                pt->max_depth(), pt->rr_depth(), pt->rr_threshold());
-            film->save(stream, camera->node()->file());
+            if (!camera->enabled()) { continue; }
+            auto batchable = !pt->progressive() && !film->node()->is_tiled() &&
+                             _pipeline.virtual_textures() == nullptr;
+            (batchable ? interleaved : sequential).emplace_back(i);
+        }
+        if (interleaved.size() == 1u) {
+            sequential.insert(sequential.begin(), interleaved.front());
+            interleaved.clear();
+        }
+        // images are encoded while the next cameras are being rendered
+        luisa::vector<std::shared_future<void>> pending_saves;
+        if (!interleaved.empty()) {
+            _render_cameras_interleaved(stream, interleaved, pt);
+            for (auto i : interleaved) {
+                auto [camera, film, filter] = _pipeline.camera(i);
+                pending_saves.emplace_back(film->save_async(stream, camera->file()));
+            }
+        }
+        for (auto i : sequential) {
+            auto [camera, film, filter] = _pipeline.camera(i);
+            _render_one_camera(stream, _pipeline, camera, filter, film, pt,
+                               _shaders[i], _camera_statistics(i));
+            // tiled films are saved tile by tile while rendering
+            if (!film->node()->is_tiled()) {
+                pending_saves.emplace_back(film->save_async(stream, camera->file()));
+            }
         }
+        for (auto &&s : pending_saves) { s.wait(); }
     }
 };
 
@@ -60,37 +237,76 @@ unique_ptr<Integrator::Instance> MegakernelPathTracing::build(Pipeline &pipeline
     return luisa::make_unique<MegakernelPathTracingInstance>(this, pipeline);
 }
 
-void MegakernelPathTracingInstance::_render_one_camera(
-    Stream &stream, Pipeline &pipeline, const Camera::Instance *camera,
-    const Filter::Instance *filter, Film::Instance *film, uint max_depth,
-    uint rr_depth, float rr_threshold) noexcept {
+MegakernelPathStatistics *MegakernelPathTracingInstance::_camera_statistics(uint camera_index) noexcept {
+    auto pt = static_cast<const MegakernelPathTracing *>(node());
+    if (!pt->statistics()) { return nullptr; }
+    _statistics.resize(_pipeline.camera_count());
+    auto &s = _statistics[camera_index];
+    if (s == nullptr) {
+        s = luisa::make_unique<MegakernelPathStatistics>(
+            _pipeline.device(), pt->max_depth());
+    }
+    return s.get();
+}
 
-    auto spp = camera->node()->spp();
-    auto resolution = film->node()->resolution();
-    auto image_file = camera->node()->file();
-    LUISA_INFO(
-        "Rendering to '{}' of resolution {}x{} at {}spp.",
-        image_file.string(),
-        resolution.x, resolution.y, spp);
+bool MegakernelPathTracingInstance::_is_adaptive(
+    Film::Instance *film, const MegakernelPathTracing *node) noexcept {
+    if (node->adaptive_threshold() <= 0.0f) { return false; }
+    if (!film->is_adaptive()) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Film '{}' does not support adaptive sampling. "
+            "Falling back to uniform sampling.",
+            film->node()->impl_type());
+        return false;
+    }
+    film->enable_adaptive();
+    return true;
+}
 
+uint MegakernelPathTracingInstance::_sample_count(
+    const Camera::Instance *camera, const Film::Instance *film,
+    const MegakernelPathTracing *node) noexcept {
+    // tiled films fall back to the camera spp, see _render_one_camera()
+    if (!node->progressive() || film->node()->is_tiled()) { return camera->spp(); }
+    return node->max_spp() == 0u ? MegakernelPathTracing::unlimited_progressive_spp : node->max_spp();
+}
+
+auto MegakernelPathTracingInstance::_prepare_camera(
+    CommandBuffer &command_buffer, Pipeline &pipeline,
+    const Camera::Instance *camera, const Filter::Instance *filter,
+    Film::Instance *film, const MegakernelPathTracing *node,
+    luisa::optional<CachedShader> &cache, bool adaptive,
+    MegakernelPathStatistics *statistics) noexcept -> CachedShader & {
+
+    // samplers like ZSobol pack the sample index into spp-sized bit fields,
+    // so they must be prepared for every sample that may be taken
+    auto spp = _sample_count(camera, film, node);
+    auto resolution = film->node()->resolution();
+    auto max_depth = node->max_depth();
+    auto rr_depth = node->rr_depth();
+    auto rr_threshold = node->rr_threshold();
     auto light_sampler = pipeline.light_sampler();
     auto sampler = pipeline.sampler();
     auto env = pipeline.environment();
 
-    auto command_buffer = stream.command_buffer();
     film->clear(command_buffer);
     sampler->reset(command_buffer, resolution, spp);
-    command_buffer.commit();
+    if (statistics != nullptr) { statistics->clear(command_buffer); }
 
     using namespace luisa::compute;
     Callable balanced_heuristic = [](Float pdf_a, Float pdf_b) noexcept {
         return ite(pdf_a > 0.0f, pdf_a / (pdf_a + pdf_b), 0.0f);
     };
 
-    Kernel2D render_kernel = [&](UInt frame_index, Float4x4 camera_to_world, Float3x3 camera_to_world_normal, Float3x3 env_to_world, Float time, Float shutter_weight) noexcept {
+    Kernel2D render_kernel = [&](UInt frame_index, UInt2 tile_offset, Float4x4 camera_to_world, Float3x3 camera_to_world_normal, Float3x3 env_to_world, Float time, Float shutter_weight) noexcept {
         set_block_size(8u, 8u, 1u);
 
-        auto pixel_id = dispatch_id().xy();
+        // the film only holds the current tile, while the camera
+        // and the sampler work on pixels of the whole image
+        auto tile_pixel_id = dispatch_id().xy();
+        auto pixel_id = tile_offset + tile_pixel_id;
+        // converged pixels skip the path loop entirely
+        auto active = adaptive ? film->is_active(tile_pixel_id) : def(true);
         sampler->start(pixel_id, frame_index);
         auto pixel = make_float2(pixel_id) + 0.5f;
         auto beta = def(make_float4(1.f));
@@ -108,7 +324,23 @@ void MegakernelPathTracingInstance::_render_one_camera(
         auto ray = camera_ray;
         auto Li = def(make_float3(0.0f));
         auto pdf_bsdf = def(0.0f);
-        $for(depth, max_depth) {
+        // only updated when statistics or the film heatmap are enabled
+        auto counts_rays = statistics != nullptr || film->has_heatmap();
+        auto path_length = def(0u);
+        auto shadow_ray_count = def(0u);
+        auto occluded_shadow_ray_count = def(0u);
+        auto alpha_pass_through_count = def(0u);
+        auto russian_roulette_exit = def(false);
+        // first-hit AOVs, only recorded when the film requests them
+        auto aov_albedo = def(make_float3(0.0f));
+        auto aov_normal = def(make_float3(0.0f));
+        auto aov_depth = def(0.0f);
+        auto aov_instance = def(~0u);
+        auto aov_bounce = def(~0u);
+        // the spread of the camera ray cone is kept at scattering events,
+        // which errs on the side of sharper texture lookups for indirect rays
+        RayCone cone{.width = def(0.0f), .spread_angle = def(camera->pixel_spread_angle())};
+        $for(depth, ite(active, max_depth, 0u)) {
 
             auto add_light_contrib = [&](const Light::Evaluation &eval) noexcept {
                 auto mis_weight = ite(depth == 0u, 1.0f, balanced_heuristic(pdf_bsdf, eval.pdf));
@@ -118,7 +350,8 @@ void MegakernelPathTracingInstance::_render_one_camera(
             auto env_prob = env == nullptr ? 0.0f : env->selection_prob();
 
             // trace
-            auto it = pipeline.intersect(ray);
+            auto it = pipeline.intersect(ray, cone);
+            if (counts_rays) { path_length += 1u; }
 
             // miss
             $if(!it->valid()) {
@@ -129,6 +362,7 @@ void MegakernelPathTracingInstance::_render_one_camera(
                 }
                 $break;
             };
+            cone.width = it->cone_width();
 
             // hit light
             if (light_sampler != nullptr && env_prob < 1.f) {
@@ -143,11 +377,21 @@ void MegakernelPathTracingInstance::_render_one_camera(
             auto alpha = it->alpha();
             auto u_alpha = sampler->generate_1d();
             $if(u_alpha >= alpha) {
+                if (statistics != nullptr) { alpha_pass_through_count += 1u; }
                 ray = it->spawn_ray(-it->wo());
                 pdf_bsdf = 1e16f;
                 $continue;
             };
 
+            if (film->has_aovs()) {
+                $if(aov_bounce == ~0u) {
+                    aov_bounce = depth;
+                    aov_normal = it->shading().n();
+                    aov_depth = distance(camera_ray->origin(), it->p());
+                    aov_instance = it->instance_id();
+                };
+            }
+
             // sample one light
             $if(!it->shape()->has_surface()) { $break; };
             Light::Sample light_sample;
@@ -170,6 +414,8 @@ void MegakernelPathTracingInstance::_render_one_camera(
 
             // trace shadow ray
             auto occluded = pipeline.intersect_any(light_sample.shadow_ray);
+            if (counts_rays) { shadow_ray_count += 1u; }
+            if (statistics != nullptr) { occluded_shadow_ray_count += ite(occluded, 1u, 0u); }
 
             // evaluate material
             pipeline.decode_material(it->shape()->surface_tag(), *it, swl, time, [&](const Surface::Closure &material) {
@@ -188,10 +434,14 @@ void MegakernelPathTracingInstance::_render_one_camera(
                 auto [wi, eval] = material.sample(*sampler);
                 ray = it->spawn_ray(wi);
                 pdf_bsdf = eval.pdf;
-                beta *= ite(
+                auto weight = ite(
                     eval.pdf > 0.0f,
                     eval.f * abs_dot(it->shading().n(), wi) / eval.pdf,
                     make_float4(0.0f));
+                if (film->has_aovs()) {
+                    $if(depth == aov_bounce) { aov_albedo = eval.swl.srgb(weight); };
+                }
+                beta *= weight;
                 swl = eval.swl;
             });
 
@@ -199,32 +449,370 @@ void MegakernelPathTracingInstance::_render_one_camera(
             $if(all(beta <= 0.0f)) { $break; };
             $if(depth >= rr_depth - 1u) {
                 auto q = min(swl.cie_y(beta), rr_threshold);
-                $if(sampler->generate_1d() >= q) { $break; };
+                $if(sampler->generate_1d() >= q) {
+                    if (statistics != nullptr) { russian_roulette_exit = true; }
+                    $break;
+                };
                 beta *= 1.0f / q;
             };
         };
-        film->accumulate(pixel_id, Li * shutter_weight);
+        $if(active) {
+            film->accumulate(tile_pixel_id, Li * shutter_weight);
+            if (film->has_heatmap()) {
+                film->accumulate_heatmap(tile_pixel_id, path_length + shadow_ray_count, path_length);
+            }
+            if (film->has_aovs()) {
+                film->accumulate_aovs(tile_pixel_id, aov_albedo, aov_normal, aov_depth, aov_instance);
+            }
+        };
+        if (statistics != nullptr) {
+            // mirrors the check with which films drop invalid samples
+            auto nan = active & any(isnan(Li * shutter_weight));
+            statistics->record(path_length, shadow_ray_count, occluded_shadow_ray_count,
+                               alpha_pass_through_count, russian_roulette_exit, nan);
+        }
     };
-    auto render = pipeline.device().compile(render_kernel);
-    auto shutter_samples = camera->node()->shutter_samples();
+    if (cache && (cache->spp != spp || cache->sampler_state_version != sampler->state_version())) {
+        cache = luisa::nullopt;
+    }
+    if (!cache) {
+        cache.emplace(CachedShader{pipeline.device().compile(render_kernel),
+                                   spp, sampler->state_version()});
+    }
+    return *cache;
+}
+
+void MegakernelPathTracingInstance::_render_one_camera(
+    Stream &stream, Pipeline &pipeline, const Camera::Instance *camera,
+    const Filter::Instance *filter, Film::Instance *film,
+    const MegakernelPathTracing *node,
+    luisa::optional<CachedShader> &cache,
+    MegakernelPathStatistics *statistics) noexcept {
+
+    auto spp = camera->spp();
+    auto resolution = film->node()->resolution();
+    auto image_file = camera->file();
+    auto adaptive = _is_adaptive(film, node);
+    if (node->progressive()) {
+        LUISA_INFO(
+            "Rendering to '{}' of resolution {}x{} "
+            "progressively (time budget: {}s, max spp: {}).",
+            image_file.string(), resolution.x, resolution.y,
+            node->time_budget(), node->max_spp());
+    } else {
+        LUISA_INFO(
+            "Rendering to '{}' of resolution {}x{} at {}spp.",
+            image_file.string(),
+            resolution.x, resolution.y, spp);
+    }
+
+    using namespace luisa::compute;
+    auto env = pipeline.environment();
+    auto command_buffer = stream.command_buffer();
+    auto &render = _prepare_camera(
+                       command_buffer, pipeline, camera, filter,
+                       film, node, cache, adaptive, statistics)
+                       .shader;
+    command_buffer << commit();
+    auto shutter_samples = camera->shutter_samples();
     stream << synchronize();
 
-    Clock clock;
-    auto dispatch_count = 0u;
-    auto dispatches_per_commit = 8u;
-    auto sample_id = 0u;
-    for (auto s : shutter_samples) {
-        if (pipeline.update_geometry(command_buffer, s.point.time)) { dispatch_count = 0u; }
-        auto camera_to_world = camera->node()->transform()->matrix(s.point.time);
+    // Tiled films hold a single tile on the device, so the image is rendered
+    // tile by tile with the full sample budget each, and every finished tile
+    // is streamed to the output file. Without tiling, the whole image is the
+    // only tile.
+    auto tiled = film->node()->is_tiled();
+    auto tile_size = film->node()->tile_size();
+    auto tile_count = (resolution + tile_size - 1u) / tile_size;
+    auto progressive = node->progressive();
+    if (tiled) {
+        if (progressive) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Progressive rendering is not supported with tiled films. "
+                "Falling back to {} spp per tile.",
+                spp);
+            progressive = false;
+        }
+        LUISA_INFO(
+            "Rendering {}x{} tile(s) of {}x{} pixels.",
+            tile_count.x, tile_count.y, tile_size.x, tile_size.y);
+        film->begin_tiled_output(image_file);
+    }
+
+    // In progressive mode, the shutter samples are cycled through until the
+    // time budget is exhausted or max_spp samples are taken. Each commit is
+    // followed by an event, and the host waits for the event of the commit
+    // before the latest one, so the device always has work queued while the
+    // host clock tracks its progress with an overshoot of at most two commits.
+    auto time_budget = static_cast<double>(node->time_budget()) * 1e3;
+    auto max_spp = progressive ? _sample_count(camera, film, node) : spp;
+    std::array progress_events{pipeline.device().create_event(),
+                               pipeline.device().create_event()};
+    auto progress_commit_count = 0u;
+    auto snapshot_interval = static_cast<double>(node->snapshot_interval()) * 1e3;
+    auto last_snapshot_time = 0.0;
+    auto snapshot_file = image_file;
+    snapshot_file.replace_extension(luisa::format(
+        ".snapshot{}", image_file.extension().string()));
+    std::shared_future<void> pending_snapshot;
+    auto snapshot_event = pipeline.device().create_event();
+    auto snapshot = [&] {
+        // skip this one if the previous snapshot is still being encoded
+        if (pending_snapshot.valid() &&
+            pending_snapshot.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+            return false;
+        }
+        // the download is queued behind the render commands and followed by an
+        // event, which only the encoding task on the thread pool waits on
+        auto framebuffer = luisa::make_shared<luisa::vector<float4>>(film->framebuffer_size());
+        film->download(command_buffer, framebuffer->data());
+        command_buffer << commit();
+        stream << snapshot_event.signal();
+        pending_snapshot = ThreadPool::global().async([film, framebuffer, snapshot_file, image_file, &snapshot_event] {
+            snapshot_event.synchronize();
+            film->write(snapshot_file, framebuffer->data());
+            std::error_code ec;
+            std::filesystem::rename(snapshot_file, image_file, ec);
+            if (ec) [[unlikely]] {
+                LUISA_WARNING_WITH_LOCATION(
+                    "Failed to move snapshot '{}' to '{}': {}.",
+                    snapshot_file.string(), image_file.string(), ec.message());
+            }
+        });
+        return true;
+    };
+
+    // In adaptive mode, the film re-evaluates its active mask every
+    // adaptive_interval samples once adaptive_min_spp samples are taken,
+    // and rendering of a tile stops early when all its pixels have converged.
+    auto pixel_count = resolution.x * resolution.y;
+    auto active_count = 0u;
+    auto remaining_active_count = 0u;
+    auto update_active_mask = [&] {
+        film->update_active_mask(
+            command_buffer, node->adaptive_threshold(),
+            node->adaptive_min_spp(), &active_count);
+        command_buffer << commit();
+        stream << synchronize();
+        return active_count == 0u;
+    };
+
+    auto shutter_transforms = [&](float time) noexcept {
+        auto camera_to_world = camera->node()->transform()->matrix(time);
         auto camera_to_world_normal = transpose(inverse(make_float3x3(camera_to_world)));
         auto env_to_world = env == nullptr || env->node()->transform()->is_identity() ?
                                 make_float3x3(1.0f) :
                                 transpose(inverse(make_float3x3(
-                                    env->node()->transform()->matrix(s.point.time))));
-        for (auto i = 0u; i < s.spp; i++) {
-            command_buffer << render(sample_id++, camera_to_world, camera_to_world_normal,
+                                    env->node()->transform()->matrix(time))));
+        return std::make_tuple(camera_to_world, camera_to_world_normal, env_to_world);
+    };
+
+    // Pages of virtual textures are requested by the render kernel itself, so
+    // before each tile passes are rendered only for their feedback, with all
+    // the missing pages uploaded after each, until a pass finds every page it
+    // touches resident; their samples are discarded. Newly resident pages may
+    // lead paths elsewhere, hence the repeated passes. The pages requested
+    // later on are streamed in after each commit, one commit late so that the
+    // host does not wait for the samples just submitted.
+    auto streams_virtual_textures = pipeline.virtual_textures() != nullptr;
+    auto warm_up_virtual_textures = [&](uint2 tile_offset, uint2 tile_extent) noexcept {
+        auto s = shutter_samples.front();
+        auto [camera_to_world, camera_to_world_normal, env_to_world] = shutter_transforms(s.point.time);
+        auto uploaded = 0u;
+        auto passes = 0u;
+        for (;;) {
+            command_buffer << render(passes++ % max_spp, tile_offset,
+                                     camera_to_world, camera_to_world_normal,
                                      env_to_world, s.point.time, s.point.weight)
-                                  .dispatch(resolution);
+                                  .dispatch(tile_extent)
+                           << commit();
+            auto n = pipeline.stream_virtual_textures(stream, ~0u, true);
+            auto missing = pipeline.virtual_textures()->missing_page_count();
+            uploaded += n;
+            if (n == 0u && missing == 0u) { break; }
+            // pages left out (the atlas is full) or more pages streamed than the atlas
+            // holds, i.e. the working set of the tile does not fit in the atlas
+            if (missing != 0u || uploaded > VirtualTextureManager::atlas_slot_count) [[unlikely]] {
+                LUISA_WARNING_WITH_LOCATION(
+                    "Virtual texture warm-up stopped with {} page(s) still "
+                    "missing after {} pass(es); they will be streamed in "
+                    "while rendering.",
+                    missing, passes);
+                break;
+            }
+        }
+        film->clear(command_buffer);
+        if (statistics != nullptr) { statistics->clear(command_buffer); }
+        LUISA_INFO("Warmed up virtual textures with {} page(s) in {} pass(es).", uploaded, passes);
+    };
+
+    Clock clock;
+    auto dispatches_per_commit = 8u;
+    auto max_sample_count = 0u;
+    for (auto tile_y = 0u; tile_y < tile_count.y; tile_y++) {
+        for (auto tile_x = 0u; tile_x < tile_count.x; tile_x++) {
+            auto tile_offset = make_uint2(tile_x, tile_y) * tile_size;
+            auto tile_extent = min(tile_size, resolution - tile_offset);
+            if (tiled) { film->begin_tile(command_buffer, tile_offset, tile_extent); }
+            if (streams_virtual_textures) { warm_up_virtual_textures(tile_offset, tile_extent); }
+            active_count = tile_extent.x * tile_extent.y;
+            auto dispatch_count = 0u;
+            auto sample_id = 0u;
+            auto finished = false;
+            while (!finished) {
+                for (auto s : shutter_samples) {
+                    if (pipeline.update_geometry(command_buffer, s.point.time)) { dispatch_count = 0u; }
+                    auto [camera_to_world, camera_to_world_normal, env_to_world] = shutter_transforms(s.point.time);
+                    for (auto i = 0u; i < s.spp && !finished; i++) {
+                        command_buffer << render(sample_id++, tile_offset,
+                                                 camera_to_world, camera_to_world_normal,
+                                                 env_to_world, s.point.time, s.point.weight)
+                                              .dispatch(tile_extent);
+                        finished = sample_id >= max_spp;
+                        if (adaptive && !finished && sample_id >= node->adaptive_min_spp() &&
+                            sample_id % node->adaptive_interval() == 0u) {
+                            finished = update_active_mask();
+                            dispatch_count = 0u;
+                        }
+                        if (++dispatch_count % dispatches_per_commit == 0u) [[unlikely]] {
+                            command_buffer << commit();
+                            dispatch_count = 0u;
+                            if (streams_virtual_textures) { pipeline.stream_virtual_textures(stream); }
+                            if (progressive) {
+                                stream << progress_events[progress_commit_count % 2u].signal();
+                                if (progress_commit_count++ != 0u) {
+                                    progress_events[progress_commit_count % 2u].synchronize();
+                                }
+                                auto elapsed = clock.toc();
+                                if (time_budget > 0.0 && elapsed >= time_budget) { finished = true; }
+                                if (!finished && snapshot_interval > 0.0 &&
+                                    elapsed - last_snapshot_time >= snapshot_interval &&
+                                    snapshot()) {
+                                    last_snapshot_time = elapsed;
+                                }
+                            }
+                        }
+                    }
+                    if (finished) { break; }
+                }
+                finished |= !progressive;
+            }
+            command_buffer << commit();
+            if (tiled) { film->save_tile(stream); }
+            max_sample_count = std::max(max_sample_count, sample_id);
+            if (progressive && node->max_spp() == 0u && sample_id >= max_spp) [[unlikely]] {
+                LUISA_WARNING_WITH_LOCATION(
+                    "Progressive rendering stopped at the limit of {} spp "
+                    "before the time budget was exhausted.",
+                    max_spp);
+            }
+            remaining_active_count += active_count;
+        }
+    }
+    stream << synchronize();
+    // make sure no pending snapshot overwrites the final image
+    if (pending_snapshot.valid()) { pending_snapshot.wait(); }
+    if (tiled) { film->end_tiled_output(); }
+    auto render_time = clock.toc();
+    LUISA_INFO("Rendering finished in {} ms ({} spp).", render_time, max_sample_count);
+    if (statistics != nullptr) { statistics->report(stream, image_file, render_time); }
+    if (adaptive) {
+        LUISA_INFO(
+            "Adaptive sampling: {}/{} pixel(s) ({:.2f}%) still active at the end.",
+            remaining_active_count, pixel_count, 100.0 * remaining_active_count / pixel_count);
+    }
+}
+
+void MegakernelPathTracingInstance::_render_cameras_interleaved(
+    Stream &stream, luisa::span<const uint> camera_indices,
+    const MegakernelPathTracing *node) noexcept {
+
+    // Every camera keeps its own film and kernel; the sampler constants that
+    // depend on the resolution and spp are baked into each kernel, so the
+    // shared sampler instance only has to be reset before each compilation.
+    struct Job {
+        const Camera::Instance *camera;
+        Film::Instance *film;
+        const CachedShader *shader;
+        uint2 resolution;
+        bool adaptive;
+        luisa::vector<Camera::ShutterSample> shutter_samples;
+        size_t shutter_index;
+        uint shutter_sample_index;
+        uint sample_id;
+        uint active_count;
+    };
+
+    using namespace luisa::compute;
+    auto command_buffer = stream.command_buffer();
+    luisa::vector<Job> jobs;
+    jobs.reserve(camera_indices.size());
+    for (auto i : camera_indices) {
+        auto [camera, film, filter] = _pipeline.camera(i);
+        auto resolution = film->node()->resolution();
+        auto adaptive = _is_adaptive(film, node);
+        LUISA_INFO(
+            "Rendering to '{}' of resolution {}x{} at {}spp.",
+            camera->file().string(), resolution.x, resolution.y, camera->spp());
+        auto &shader = _prepare_camera(
+            command_buffer, _pipeline, camera, filter,
+            film, node, _shaders[i], adaptive, _camera_statistics(i));
+        jobs.emplace_back(Job{camera, film, &shader, resolution, adaptive,
+                              camera->shutter_samples(), 0u, 0u, 0u,
+                              resolution.x * resolution.y});
+    }
+    command_buffer << commit();
+    stream << synchronize();
+
+    // one sample of every unfinished camera per round
+    Clock clock;
+    auto env = _pipeline.environment();
+    auto dispatch_count = 0u;
+    auto dispatches_per_commit = 16u;
+    auto unfinished = jobs.size();
+    auto finished = [](const Job &job) noexcept {
+        return job.shutter_index == job.shutter_samples.size();
+    };
+    auto skip_empty_shutter_samples = [](Job &job) noexcept {
+        while (job.shutter_index < job.shutter_samples.size() &&
+               job.shutter_sample_index == job.shutter_samples[job.shutter_index].spp) {
+            job.shutter_index++;
+            job.shutter_sample_index = 0u;
+        }
+    };
+    for (auto &job : jobs) {
+        skip_empty_shutter_samples(job);
+        if (finished(job)) { unfinished--; }
+    }
+    while (unfinished != 0u) {
+        for (auto &job : jobs) {
+            if (finished(job)) { continue; }
+            auto s = job.shutter_samples[job.shutter_index];
+            if (_pipeline.update_geometry(command_buffer, s.point.time)) { dispatch_count = 0u; }
+            auto camera_to_world = job.camera->node()->transform()->matrix(s.point.time);
+            auto camera_to_world_normal = transpose(inverse(make_float3x3(camera_to_world)));
+            auto env_to_world = env == nullptr || env->node()->transform()->is_identity() ?
+                                    make_float3x3(1.0f) :
+                                    transpose(inverse(make_float3x3(
+                                        env->node()->transform()->matrix(s.point.time))));
+            command_buffer << job.shader->shader(job.sample_id++, make_uint2(0u),
+                                                 camera_to_world, camera_to_world_normal,
+                                                 env_to_world, s.point.time, s.point.weight)
+                                  .dispatch(job.resolution);
+            job.shutter_sample_index++;
+            skip_empty_shutter_samples(job);
+            if (job.adaptive && !finished(job) &&
+                job.sample_id >= node->adaptive_min_spp() &&
+                job.sample_id % node->adaptive_interval() == 0u) {
+                job.film->update_active_mask(
+                    command_buffer, node->adaptive_threshold(),
+                    node->adaptive_min_spp(), &job.active_count);
+                command_buffer << commit();
+                stream << synchronize();
+                dispatch_count = 0u;
+                if (job.active_count == 0u) { job.shutter_index = job.shutter_samples.size(); }
+            }
+            if (finished(job)) { unfinished--; }
             if (++dispatch_count % dispatches_per_commit == 0u) [[unlikely]] {
                 command_buffer << commit();
                 dispatch_count = 0u;
@@ -233,7 +821,14 @@ void MegakernelPathTracingInstance::_render_one_camera(
     }
     command_buffer << commit();
     stream << synchronize();
-    LUISA_INFO("Rendering finished in {} ms.", clock.toc());
+    auto render_time = clock.toc();
+    LUISA_INFO("Rendering {} camera(s) finished in {} ms.", jobs.size(), render_time);
+    // interleaved cameras share the device, so rates are over the whole batch
+    for (auto i : camera_indices) {
+        if (auto statistics = _camera_statistics(i)) {
+            statistics->report(stream, std::get<0>(_pipeline.camera(i))->file(), render_time);
+        }
+    }
 }
 
 }// namespace luisa::render
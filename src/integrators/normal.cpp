@@ -40,11 +40,17 @@ NormalVisualizerInstance::NormalVisualizerInstance(
     : Integrator::Instance{pipeline, integrator}, _pipeline{pipeline} {}
 
 void NormalVisualizerInstance::render(Stream &stream) noexcept {
+    luisa::vector<std::shared_future<void>> pending_saves;
     for (auto i = 0u; i < _pipeline.camera_count(); i++) {
         auto [camera, film, filter] = _pipeline.camera(i);
+        if (!camera->enabled()) { continue; }
         _render_one_camera(stream, _pipeline, camera, filter, film);
-        film->save(stream, camera->node()->file());
+        // tiled films are saved tile by tile while rendering
+        if (!film->node()->is_tiled()) {
+            pending_saves.emplace_back(film->save_async(stream, camera->file()));
+        }
     }
+    for (auto &&s : pending_saves) { s.wait(); }
 }
 
 void NormalVisualizerInstance::_render_one_camera(
@@ -53,9 +59,9 @@ void NormalVisualizerInstance::_render_one_camera(
     const Filter::Instance *filter,
     Film::Instance *film) noexcept {
 
-    auto spp = camera->node()->spp();
+    auto spp = camera->spp();
     auto resolution = film->node()->resolution();
-    auto image_file = camera->node()->file();
+    auto image_file = camera->file();
     LUISA_INFO(
         "Rendering to '{}' of resolution {}x{} at {}spp.",
         image_file.string(),
@@ -68,8 +74,9 @@ void NormalVisualizerInstance::_render_one_camera(
     command_buffer.commit();
 
     using namespace luisa::compute;
-    Kernel2D render_kernel = [&](UInt frame_index, Float4x4 camera_to_world, Float3x3 camera_to_world_normal, Float time, Float shutter_weight) noexcept {
-        auto pixel_id = dispatch_id().xy();
+    Kernel2D render_kernel = [&](UInt frame_index, UInt2 tile_offset, Float4x4 camera_to_world, Float3x3 camera_to_world_normal, Float time, Float shutter_weight) noexcept {
+        auto tile_pixel_id = dispatch_id().xy();
+        auto pixel_id = tile_offset + tile_pixel_id;
         sampler->start(pixel_id, frame_index);
         auto pixel = make_float2(pixel_id) + 0.5f;
         auto path_weight = def(1.f);
@@ -85,30 +92,45 @@ void NormalVisualizerInstance::_render_one_camera(
             interaction->valid(),
             interaction->shading().n() * 0.5f + 0.5f,
             make_float3());
-        film->accumulate(pixel_id, shutter_weight * path_weight * color);
+        film->accumulate(tile_pixel_id, shutter_weight * path_weight * color);
     };
     auto render = pipeline.device().compile(render_kernel);
-    auto shutter_samples = camera->node()->shutter_samples();
+    auto shutter_samples = camera->shutter_samples();
     stream << synchronize();
+    // without tiling, the whole image is the only tile
+    auto tiled = film->node()->is_tiled();
+    auto tile_size = film->node()->tile_size();
+    auto tile_count = (resolution + tile_size - 1u) / tile_size;
+    if (tiled) { film->begin_tiled_output(image_file); }
     Clock clock;
-    auto sample_id = 0u;
-    auto dispatch_count = 0u;
     auto dispatches_per_commit = 64u;
-    for (auto s : shutter_samples) {
-        if (pipeline.update_geometry(command_buffer, s.point.time)) { dispatch_count = 0u; }
-        auto camera_to_world = camera->node()->transform()->matrix(s.point.time);
-        auto camera_to_world_normal = transpose(inverse(make_float3x3(camera_to_world)));
-        for (auto i = 0u; i < s.spp; i++) {
-            command_buffer << render(sample_id++, camera_to_world, camera_to_world_normal,
-                                     s.point.time, s.point.weight).dispatch(resolution);
-            if (++dispatch_count % dispatches_per_commit == 0u) [[unlikely]] {
-                command_buffer << commit();
-                dispatch_count = 0u;
+    for (auto tile_y = 0u; tile_y < tile_count.y; tile_y++) {
+        for (auto tile_x = 0u; tile_x < tile_count.x; tile_x++) {
+            auto tile_offset = make_uint2(tile_x, tile_y) * tile_size;
+            auto tile_extent = min(tile_size, resolution - tile_offset);
+            if (tiled) { film->begin_tile(command_buffer, tile_offset, tile_extent); }
+            auto sample_id = 0u;
+            auto dispatch_count = 0u;
+            for (auto s : shutter_samples) {
+                if (pipeline.update_geometry(command_buffer, s.point.time)) { dispatch_count = 0u; }
+                auto camera_to_world = camera->node()->transform()->matrix(s.point.time);
+                auto camera_to_world_normal = transpose(inverse(make_float3x3(camera_to_world)));
+                for (auto i = 0u; i < s.spp; i++) {
+                    command_buffer << render(sample_id++, tile_offset, camera_to_world, camera_to_world_normal,
+                                             s.point.time, s.point.weight)
+                                          .dispatch(tile_extent);
+                    if (++dispatch_count % dispatches_per_commit == 0u) [[unlikely]] {
+                        command_buffer << commit();
+                        dispatch_count = 0u;
+                    }
+                }
             }
+            command_buffer << commit();
+            if (tiled) { film->save_tile(stream); }
         }
     }
-    command_buffer << commit();
     stream << synchronize();
+    if (tiled) { film->end_tiled_output(); }
     LUISA_INFO("Rendering finished in {} ms.", clock.toc());
 }
 
@@ -0,0 +1,577 @@
+#include <luisa-compute.h>
+#include <base/pipeline.h>
+#include <base/integrator.h>
+
+namespace luisa::render {
+
+using namespace luisa::compute;
+
+class WavefrontPathTracing final : public Integrator {
+
+private:
+    uint _max_depth;
+    uint _rr_depth;
+    float _rr_threshold;
+
+public:
+    WavefrontPathTracing(Scene *scene, const SceneNodeDesc *desc) noexcept
+        : Integrator{scene, desc},
+          _max_depth{std::max(desc->property_uint_or_default("depth", 10u), 1u)},
+          _rr_depth{std::max(desc->property_uint_or_default("rr_depth", 2u), 1u)},
+          _rr_threshold{std::max(desc->property_float_or_default("rr_threshold", 0.95f), 0.05f)} {}
+    [[nodiscard]] auto max_depth() const noexcept { return _max_depth; }
+    [[nodiscard]] auto rr_depth() const noexcept { return _rr_depth; }
+    [[nodiscard]] auto rr_threshold() const noexcept { return _rr_threshold; }
+    [[nodiscard]] string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+    [[nodiscard]] unique_ptr<Instance> build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
+};
+
+// Per-path states stored as structure-of-arrays, indexed by the path (pixel) id.
+class PathStateSOA {
+
+private:
+    Buffer<float4> _lambda;
+    Buffer<float4> _swl_pdf;
+    Buffer<float4> _beta;
+    Buffer<float3> _radiance;
+    Buffer<float> _pdf_bsdf;
+
+public:
+    PathStateSOA(Device &device, size_t size) noexcept
+        : _lambda{device.create_buffer<float4>(size)},
+          _swl_pdf{device.create_buffer<float4>(size)},
+          _beta{device.create_buffer<float4>(size)},
+          _radiance{device.create_buffer<float3>(size)},
+          _pdf_bsdf{device.create_buffer<float>(size)} {}
+    [[nodiscard]] auto read_swl(Expr<uint> index) const noexcept {
+        return SampledWavelengths{_lambda.read(index), _swl_pdf.read(index)};
+    }
+    void write_swl(Expr<uint> index, const SampledWavelengths &swl) const noexcept {
+        _lambda.write(index, swl.lambda());
+        _swl_pdf.write(index, swl.pdf());
+    }
+    [[nodiscard]] auto read_beta(Expr<uint> index) const noexcept { return _beta.read(index); }
+    void write_beta(Expr<uint> index, Expr<float4> beta) const noexcept { _beta.write(index, beta); }
+    [[nodiscard]] auto read_radiance(Expr<uint> index) const noexcept { return _radiance.read(index); }
+    void write_radiance(Expr<uint> index, Expr<float3> Li) const noexcept { _radiance.write(index, Li); }
+    [[nodiscard]] auto read_pdf_bsdf(Expr<uint> index) const noexcept { return _pdf_bsdf.read(index); }
+    void write_pdf_bsdf(Expr<uint> index, Expr<float> pdf) const noexcept { _pdf_bsdf.write(index, pdf); }
+};
+
+// Index queues of active paths, all sharing a single counter buffer. Layout of the counters:
+//   [0, 1]: ping-pong ray queues for the current and the next bounce;
+//   [2]: shadow ray queue;
+//   [3]: unsorted shading queue, filled in the order of intersection;
+//   [4, 4 + T): number of queued paths per surface tag (T = #surface tags);
+//   [4 + T, 4 + 2T): begin of each surface tag in the sorted shading queue;
+//   [4 + 2T, 4 + 3T): scatter cursors of each surface tag.
+class PathQueues {
+
+public:
+    static constexpr auto shadow_queue_counter = 2u;
+    static constexpr auto shading_queue_counter = 3u;
+    static constexpr auto surface_tag_counter_offset = 4u;
+
+private:
+    uint _capacity;
+    uint _surface_tag_count;
+    Buffer<uint> _counters;
+    Buffer<uint> _ray_queue;
+    Buffer<uint> _shadow_queue;
+    Buffer<uint> _shading_queue;
+    Buffer<uint> _sorted_shading_queue;
+    Buffer<uint> _path_tags;
+
+private:
+    [[nodiscard]] auto _tag_count_counter(Expr<uint> tag) const noexcept { return surface_tag_counter_offset + tag; }
+    [[nodiscard]] auto _tag_begin_counter(Expr<uint> tag) const noexcept { return surface_tag_counter_offset + _surface_tag_count + tag; }
+    [[nodiscard]] auto _tag_cursor_counter(Expr<uint> tag) const noexcept { return surface_tag_counter_offset + _surface_tag_count * 2u + tag; }
+
+public:
+    PathQueues(Device &device, uint capacity, uint surface_tag_count) noexcept
+        : _capacity{capacity}, _surface_tag_count{surface_tag_count},
+          _counters{device.create_buffer<uint>(surface_tag_counter_offset + surface_tag_count * 3u)},
+          _ray_queue{device.create_buffer<uint>(capacity * 2u)},
+          _shadow_queue{device.create_buffer<uint>(capacity)},
+          _shading_queue{device.create_buffer<uint>(capacity)},
+          _sorted_shading_queue{device.create_buffer<uint>(capacity)},
+          _path_tags{device.create_buffer<uint>(capacity)} {}
+    [[nodiscard]] auto capacity() const noexcept { return _capacity; }
+    [[nodiscard]] auto counter_count() const noexcept { return static_cast<uint>(_counters.size()); }
+    [[nodiscard]] auto &counters() const noexcept { return _counters; }
+    [[nodiscard]] auto ray_queue_size(Expr<uint> queue) const noexcept { return _counters.read(queue); }
+    [[nodiscard]] auto read_ray(Expr<uint> queue, Expr<uint> index) const noexcept {
+        return _ray_queue.read(queue * _capacity + index);
+    }
+    void push_ray(Expr<uint> queue, Expr<uint> path_id) const noexcept {
+        auto slot = _counters.atomic(queue).fetch_add(1u);
+        _ray_queue.write(queue * _capacity + slot, path_id);
+    }
+    void write_ray(Expr<uint> queue, Expr<uint> index, Expr<uint> path_id) const noexcept {
+        _ray_queue.write(queue * _capacity + index, path_id);
+    }
+    [[nodiscard]] auto shadow_queue_size() const noexcept { return _counters.read(shadow_queue_counter); }
+    [[nodiscard]] auto read_shadow(Expr<uint> index) const noexcept { return _shadow_queue.read(index); }
+    void push_shadow(Expr<uint> path_id) const noexcept {
+        auto slot = _counters.atomic(shadow_queue_counter).fetch_add(1u);
+        _shadow_queue.write(slot, path_id);
+    }
+    // surface tag of the path in the current bounce, ~0u if the path is not to be shaded
+    [[nodiscard]] auto path_tag(Expr<uint> path_id) const noexcept { return _path_tags.read(path_id); }
+    void clear_path_tag(Expr<uint> path_id) const noexcept { _path_tags.write(path_id, ~0u); }
+    [[nodiscard]] auto shading_queue_size() const noexcept { return _counters.read(shading_queue_counter); }
+    void push_shading(Expr<uint> tag, Expr<uint> path_id) const noexcept {
+        auto slot = _counters.atomic(shading_queue_counter).fetch_add(1u);
+        _shading_queue.write(slot, path_id);
+        _path_tags.write(path_id, tag);
+        _counters.atomic(_tag_count_counter(tag)).fetch_add(1u);
+    }
+    // exclusive prefix sum over the per-tag counts, should be run by a single thread
+    void compute_tag_offsets() const noexcept {
+        auto offset = def(0u);
+        for (auto tag = 0u; tag < _surface_tag_count; tag++) {
+            _counters.write(_tag_begin_counter(tag), offset);
+            _counters.write(_tag_cursor_counter(tag), offset);
+            offset += _counters.read(_tag_count_counter(tag));
+        }
+    }
+    // counting-sort the shading queue so that paths with the same surface tag are contiguous
+    void scatter_shading(Expr<uint> index) const noexcept {
+        auto path_id = _shading_queue.read(index);
+        auto tag = _path_tags.read(path_id);
+        auto slot = _counters.atomic(_tag_cursor_counter(tag)).fetch_add(1u);
+        _sorted_shading_queue.write(slot, path_id);
+    }
+    [[nodiscard]] auto read_sorted_shading(Expr<uint> index) const noexcept { return _sorted_shading_queue.read(index); }
+    [[nodiscard]] auto surface_queue_size(uint tag) const noexcept { return _counters.read(_tag_count_counter(tag)); }
+    [[nodiscard]] auto read_surface(uint tag, Expr<uint> index) const noexcept {
+        return _sorted_shading_queue.read(_counters.read(_tag_begin_counter(tag)) + index);
+    }
+    // the per-tag counts, read back to size the dispatch of each shading kernel
+    [[nodiscard]] auto tag_counts() const noexcept {
+        return _counters.view(surface_tag_counter_offset, _surface_tag_count);
+    }
+};
+
+class WavefrontPathTracingInstance final : public Integrator::Instance {
+
+private:
+    Pipeline &_pipeline;
+
+private:
+    static void _render_one_camera(
+        Stream &stream, Pipeline &pipeline,
+        const Camera::Instance *camera,
+        const Filter::Instance *filter,
+        Film::Instance *film, uint max_depth,
+        uint rr_depth, float rr_threshold) noexcept;
+
+public:
+    explicit WavefrontPathTracingInstance(const WavefrontPathTracing *node, Pipeline &pipeline) noexcept
+        : Integrator::Instance{pipeline, node}, _pipeline{pipeline} {}
+    void render(Stream &stream) noexcept override {
+        auto pt = static_cast<const WavefrontPathTracing *>(node());
+        luisa::vector<std::shared_future<void>> pending_saves;
+        for (auto i = 0u; i < _pipeline.camera_count(); i++) {
+            auto [camera, film, filter] = _pipeline.camera(i);
+            if (!camera->enabled()) { continue; }
+            _render_one_camera(
+                stream, _pipeline, camera, filter, film,
+                pt->max_depth(), pt->rr_depth(), pt->rr_threshold());
+            pending_saves.emplace_back(film->save_async(stream, camera->file()));
+        }
+        for (auto &&s : pending_saves) { s.wait(); }
+    }
+};
+
+unique_ptr<Integrator::Instance> WavefrontPathTracing::build(Pipeline &pipeline, CommandBuffer &) const noexcept {
+    return luisa::make_unique<WavefrontPathTracingInstance>(this, pipeline);
+}
+
+void WavefrontPathTracingInstance::_render_one_camera(
+    Stream &stream, Pipeline &pipeline, const Camera::Instance *camera,
+    const Filter::Instance *filter, Film::Instance *film, uint max_depth,
+    uint rr_depth, float rr_threshold) noexcept {
+
+    auto spp = camera->spp();
+    auto resolution = film->node()->resolution();
+    auto image_file = camera->file();
+    // path states are kept for every pixel of the image
+    if (film->node()->is_tiled()) [[unlikely]] {
+        LUISA_ERROR_WITH_LOCATION(
+            "Tiled films are not supported by the "
+            "wavefront path tracer. Please use the "
+            "megakernel path tracer instead.");
+    }
+    LUISA_INFO(
+        "Rendering to '{}' of resolution {}x{} at {}spp.",
+        image_file.string(),
+        resolution.x, resolution.y, spp);
+
+    auto light_sampler = pipeline.light_sampler();
+    auto sampler = pipeline.sampler();
+    auto env = pipeline.environment();
+    auto &device = pipeline.device();
+
+    auto command_buffer = stream.command_buffer();
+    film->clear(command_buffer);
+    sampler->reset(command_buffer, resolution, spp);
+    command_buffer.commit();
+
+    // one path per pixel, so the path id is also the sampler state index
+    auto path_count = resolution.x * resolution.y;
+    auto surface_tag_count = static_cast<uint>(pipeline.surface_interfaces().size());
+    PathStateSOA path_states{device, path_count};
+    PathQueues queues{device, path_count, surface_tag_count};
+    auto rays = device.create_buffer<Ray>(path_count);
+    auto hits = device.create_buffer<Hit>(path_count);
+    auto shadow_rays = device.create_buffer<Ray>(path_count);
+    auto shadow_radiance = device.create_buffer<float3>(path_count);
+
+    auto env_prob = env == nullptr ? 0.0f : env->selection_prob();
+    auto pixel_of = [w = resolution.x](Expr<uint> path_id) noexcept {
+        return make_uint2(path_id % w, path_id / w);
+    };
+
+    Callable balanced_heuristic = [](Float pdf_a, Float pdf_b) noexcept {
+        return ite(pdf_a > 0.0f, pdf_a / (pdf_a + pdf_b), 0.0f);
+    };
+
+    Kernel1D clear_counters_kernel = [&](UInt keep) noexcept {
+        auto index = dispatch_x();
+        $if(index != keep) { queues.counters().write(index, 0u); };
+    };
+
+    Kernel2D generate_rays_kernel = [&](UInt frame_index, Float4x4 camera_to_world, Float3x3 camera_to_world_normal, Float time) noexcept {
+        set_block_size(8u, 8u, 1u);
+        auto pixel_id = dispatch_id().xy();
+        auto path_id = pixel_id.y * resolution.x + pixel_id.x;
+        sampler->start(pixel_id, frame_index);
+        auto pixel = make_float2(pixel_id) + 0.5f;
+        auto beta = def(make_float4(1.f));
+        auto [filter_offset, filter_weight] = filter->sample(*sampler);
+        pixel += filter_offset;
+        beta *= filter_weight;
+        auto swl = SampledWavelengths::sample_visible(sampler->generate_1d());
+        auto [camera_ray, camera_weight] = camera->generate_ray(*sampler, pixel, time);
+        if (!camera->node()->transform()->is_identity()) {
+            camera_ray->set_origin(make_float3(camera_to_world * make_float4(camera_ray->origin(), 1.0f)));
+            camera_ray->set_direction(normalize(camera_to_world_normal * camera_ray->direction()));
+        }
+        beta *= camera_weight;
+        sampler->save_state();
+        rays.write(path_id, camera_ray);
+        path_states.write_swl(path_id, swl);
+        path_states.write_beta(path_id, beta);
+        path_states.write_radiance(path_id, make_float3(0.0f));
+        path_states.write_pdf_bsdf(path_id, 0.0f);
+        queues.write_ray(0u, path_id, path_id);
+        $if(path_id == 0u) { queues.counters().write(0u, path_count); };
+    };
+
+    Kernel1D intersect_kernel = [&](UInt depth, UInt queue, Float3x3 env_to_world, Float time) noexcept {
+        auto queue_index = dispatch_x();
+        $if(queue_index < queues.ray_queue_size(queue)) {
+            auto path_id = queues.read_ray(queue, queue_index);
+            queues.clear_path_tag(path_id);
+            sampler->load_state(pixel_of(path_id));
+            auto ray = rays.read(path_id);
+            auto swl = path_states.read_swl(path_id);
+            auto beta = path_states.read_beta(path_id);
+            auto pdf_bsdf = path_states.read_pdf_bsdf(path_id);
+            auto Li = path_states.read_radiance(path_id);
+            auto add_light_contrib = [&](const Light::Evaluation &eval) noexcept {
+                auto mis_weight = ite(depth == 0u, 1.0f, balanced_heuristic(pdf_bsdf, eval.pdf));
+                Li += swl.srgb(ite(eval.pdf > 0.0f, beta * eval.L * mis_weight, make_float4(0.0f)));
+            };
+
+            // trace
+            auto hit = pipeline.trace_closest(ray);
+            auto it = pipeline.interaction(ray, hit);
+            $if(!it->valid()) {
+                // miss
+                if (env_prob > 0.0f) {
+                    auto eval = env->evaluate(ray->direction(), env_to_world, swl, time);
+                    eval.L /= env_prob;
+                    add_light_contrib(eval);
+                }
+            }
+            $else {
+                // hit light
+                if (light_sampler != nullptr && env_prob < 1.f) {
+                    $if(it->shape()->has_light()) {
+                        auto eval = light_sampler->evaluate(*it, ray->origin(), swl, time);
+                        eval.L /= 1.0f - env_prob;
+                        add_light_contrib(eval);
+                    };
+                }
+                // alpha
+                auto alpha = it->alpha();
+                auto u_alpha = sampler->generate_1d();
+                $if(u_alpha >= alpha) {
+                    $if(depth + 1u < max_depth) {
+                        rays.write(path_id, it->spawn_ray(-it->wo()));
+                        path_states.write_pdf_bsdf(path_id, 1e16f);
+                        queues.push_ray(1u - queue, path_id);
+                    };
+                }
+                $elif(it->shape()->has_surface()) {
+                    // defer shading to the sort stage
+                    hits.write(path_id, hit);
+                    queues.push_shading(it->shape()->surface_tag(), path_id);
+                };
+            };
+            path_states.write_radiance(path_id, Li);
+            sampler->save_state();
+        };
+    };
+
+    // one kernel per surface tag, specialized for its material and dispatched
+    // over only the paths of the tag in the sorted shading queue
+    auto shade_kernel = [&](uint tag) noexcept {
+        return [&, tag](UInt depth, UInt queue, Float3x3 env_to_world, Float time) noexcept {
+            auto queue_index = dispatch_x();
+            $if(queue_index < queues.surface_queue_size(tag)) {
+                auto path_id = queues.read_surface(tag, queue_index);
+                sampler->load_state(pixel_of(path_id));
+                auto ray = rays.read(path_id);
+                auto it = pipeline.interaction(ray, hits.read(path_id));
+                auto swl = path_states.read_swl(path_id);
+                auto beta = path_states.read_beta(path_id);
+
+                // sample one light
+                Light::Sample light_sample;
+                if (env_prob > 0.0f) {
+                    auto u = sampler->generate_1d();
+                    $if(u < env_prob) {
+                        light_sample = env->sample(*sampler, *it, env_to_world, swl, time);
+                        light_sample.eval.pdf *= env_prob;
+                    }
+                    $else {
+                        if (light_sampler != nullptr) {
+                            light_sample = light_sampler->sample(*sampler, *it, swl, time);
+                            light_sample.eval.pdf *= 1.0f - env_prob;
+                        }
+                    };
+                } else if (light_sampler != nullptr) {
+                    light_sample = light_sampler->sample(*sampler, *it, swl, time);
+                    light_sample.eval.pdf *= 1.0f - env_prob;
+                }
+
+                // evaluate material, specialized for this surface tag
+                auto material = pipeline.decode_material(tag, *it, swl, time);
+                $if(light_sample.eval.pdf > 0.0f) {
+                    // direct lighting, the shadow ray is traced later in its own kernel
+                    auto wi = light_sample.shadow_ray->direction();
+                    auto [new_swl, f, pdf] = material->evaluate(wi);
+                    auto mis_weight = balanced_heuristic(light_sample.eval.pdf, pdf);
+                    auto Ld = new_swl.srgb(
+                        beta * mis_weight * ite(pdf > 0.0f, f, 0.0f) *
+                        abs_dot(it->shading().n(), wi) *
+                        light_sample.eval.L / light_sample.eval.pdf);
+                    shadow_rays.write(path_id, light_sample.shadow_ray);
+                    shadow_radiance.write(path_id, Ld);
+                    queues.push_shadow(path_id);
+                };
+
+                // sample material
+                auto [wi, eval] = material->sample(*sampler);
+                beta *= ite(
+                    eval.pdf > 0.0f,
+                    eval.f * abs_dot(it->shading().n(), wi) / eval.pdf,
+                    make_float4(0.0f));
+                swl = eval.swl;
+
+                // rr
+                auto terminated = def(false);
+                $if(all(beta <= 0.0f)) {
+                    terminated = true;
+                }
+                $elif(depth >= rr_depth - 1u) {
+                    auto q = min(swl.cie_y(beta), rr_threshold);
+                    terminated = sampler->generate_1d() >= q;
+                    beta *= 1.0f / q;
+                };
+                $if(!terminated & depth + 1u < max_depth) {
+                    rays.write(path_id, it->spawn_ray(wi));
+                    path_states.write_swl(path_id, swl);
+                    path_states.write_beta(path_id, beta);
+                    path_states.write_pdf_bsdf(path_id, eval.pdf);
+                    queues.push_ray(1u - queue, path_id);
+                };
+                sampler->save_state();
+            };
+        };
+    };
+
+    Kernel1D trace_shadow_kernel = [&]() noexcept {
+        auto queue_index = dispatch_x();
+        $if(queue_index < queues.shadow_queue_size()) {
+            auto path_id = queues.read_shadow(queue_index);
+            auto occluded = pipeline.intersect_any(shadow_rays.read(path_id));
+            $if(!occluded) {
+                path_states.write_radiance(
+                    path_id,
+                    path_states.read_radiance(path_id) +
+                        shadow_radiance.read(path_id));
+            };
+        };
+    };
+
+    Kernel1D compute_tag_offsets_kernel = [&]() noexcept {
+        queues.compute_tag_offsets();
+    };
+
+    Kernel1D sort_shading_queue_kernel = [&]() noexcept {
+        auto queue_index = dispatch_x();
+        $if(queue_index < queues.shading_queue_size()) {
+            queues.scatter_shading(queue_index);
+        };
+    };
+
+    // Measures material coherence as the number of distinct surface tags each
+    // SIMD group of `coherence_group_size` lanes would have to execute, both in
+    // the order of intersection (i.e., what a megakernel would see) and after
+    // sorting. Statistics: [#groups unsorted, #tags unsorted, #groups sorted, #tags sorted].
+    constexpr auto coherence_group_size = 32u;
+    auto coherence_stats = device.create_buffer<uint>(4u);
+    auto count_distinct_tags = [&](Expr<uint> queue, Expr<uint> begin, Expr<uint> end, bool sorted) noexcept {
+        auto tag_at = [&](Expr<uint> index) noexcept {
+            return queues.path_tag(
+                sorted ? queues.read_sorted_shading(index) :
+                         queues.read_ray(queue, index));
+        };
+        auto count = def(0u);
+        $for(i, begin, end) {
+            auto tag = tag_at(i);
+            $if(tag != ~0u) {
+                auto seen = def(false);
+                $for(j, begin, i) {
+                    $if(tag_at(j) == tag) {
+                        seen = true;
+                        $break;
+                    };
+                };
+                $if(!seen) { count += 1u; };
+            };
+        };
+        return count;
+    };
+    Kernel1D measure_coherence_kernel = [&](UInt queue) noexcept {
+        auto begin = dispatch_x() * coherence_group_size;
+        auto ray_count = queues.ray_queue_size(queue);
+        $if(begin < ray_count) {
+            auto end = min(begin + coherence_group_size, ray_count);
+            auto n = count_distinct_tags(queue, begin, end, false);
+            $if(n != 0u) {
+                coherence_stats.atomic(0u).fetch_add(1u);
+                coherence_stats.atomic(1u).fetch_add(n);
+            };
+        };
+        auto shading_count = queues.shading_queue_size();
+        $if(begin < shading_count) {
+            auto end = min(begin + coherence_group_size, shading_count);
+            auto n = count_distinct_tags(queue, begin, end, true);
+            coherence_stats.atomic(2u).fetch_add(1u);
+            coherence_stats.atomic(3u).fetch_add(n);
+        };
+    };
+
+    Kernel2D accumulate_kernel = [&](Float shutter_weight) noexcept {
+        auto pixel_id = dispatch_id().xy();
+        auto path_id = pixel_id.y * resolution.x + pixel_id.x;
+        film->accumulate(pixel_id, path_states.read_radiance(path_id) * shutter_weight);
+    };
+
+    Clock compile_clock;
+    auto kernel_count = 0u;
+    auto compile = [&](const auto &kernel) noexcept {
+        kernel_count++;
+        return device.compile(kernel);
+    };
+    auto clear_counters = compile(clear_counters_kernel);
+    auto generate_rays = compile(generate_rays_kernel);
+    auto intersect = compile(intersect_kernel);
+    luisa::vector<Shader1D<uint, uint, float3x3, float>> shade_shaders;
+    shade_shaders.reserve(surface_tag_count);
+    for (auto tag = 0u; tag < surface_tag_count; tag++) {
+        Kernel1D kernel = shade_kernel(tag);
+        shade_shaders.emplace_back(compile(kernel));
+    }
+    auto trace_shadow = compile(trace_shadow_kernel);
+    auto compute_tag_offsets = compile(compute_tag_offsets_kernel);
+    auto sort_shading_queue = compile(sort_shading_queue_kernel);
+    auto measure_coherence = compile(measure_coherence_kernel);
+    auto accumulate = compile(accumulate_kernel);
+    LUISA_INFO(
+        "Compiled {} wavefront kernels "
+        "({} surface tag(s)) in {} ms.",
+        kernel_count, surface_tag_count,
+        compile_clock.toc());
+    std::array<uint, 4u> coherence{};
+    luisa::vector<uint> tag_counts(surface_tag_count);
+    command_buffer << coherence_stats.copy_from(coherence.data());
+    auto shutter_samples = camera->shutter_samples();
+    stream << synchronize();
+
+    Clock clock;
+    auto sample_id = 0u;
+    for (auto s : shutter_samples) {
+        pipeline.update_geometry(command_buffer, s.point.time);
+        auto camera_to_world = camera->node()->transform()->matrix(s.point.time);
+        auto camera_to_world_normal = transpose(inverse(make_float3x3(camera_to_world)));
+        auto env_to_world = env == nullptr || env->node()->transform()->is_identity() ?
+                                make_float3x3(1.0f) :
+                                transpose(inverse(make_float3x3(
+                                    env->node()->transform()->matrix(s.point.time))));
+        for (auto i = 0u; i < s.spp; i++) {
+            // only the first sample is profiled for coherence
+            auto profile_coherence = sample_id == 0u;
+            command_buffer << generate_rays(sample_id++, camera_to_world, camera_to_world_normal, s.point.time)
+                                  .dispatch(resolution);
+            for (auto depth = 0u; depth < max_depth; depth++) {
+                auto queue = depth & 1u;
+                command_buffer << clear_counters(queue).dispatch(queues.counter_count())
+                               << intersect(depth, queue, env_to_world, s.point.time).dispatch(path_count)
+                               << compute_tag_offsets().dispatch(1u)
+                               << sort_shading_queue().dispatch(path_count);
+                if (profile_coherence) {
+                    command_buffer << measure_coherence(queue).dispatch(
+                        (path_count + coherence_group_size - 1u) / coherence_group_size);
+                }
+                // the sorted ranges are read back, so that each shading kernel
+                // is only launched over the paths of its own surface tag
+                command_buffer << queues.tag_counts().copy_to(tag_counts.data())
+                               << commit();
+                stream << synchronize();
+                for (auto tag = 0u; tag < surface_tag_count; tag++) {
+                    if (auto n = tag_counts[tag]; n != 0u) {
+                        command_buffer << shade_shaders[tag](depth, queue, env_to_world, s.point.time).dispatch(n);
+                    }
+                }
+                command_buffer << trace_shadow().dispatch(path_count);
+            }
+            command_buffer << accumulate(s.point.weight).dispatch(resolution);
+            if (profile_coherence) { command_buffer << coherence_stats.copy_to(coherence.data()); }
+            command_buffer << commit();
+            // pages requested by this sample are read back here and resident
+            // from the sample after the next one on
+            pipeline.stream_virtual_textures(stream);
+        }
+    }
+    stream << synchronize();
+    LUISA_INFO("Rendering finished in {} ms.", clock.toc());
+    if (coherence[0] != 0u && coherence[2] != 0u) {
+        auto unsorted = static_cast<double>(coherence[1]) / static_cast<double>(coherence[0]);
+        auto sorted = static_cast<double>(coherence[3]) / static_cast<double>(coherence[2]);
+        LUISA_INFO(
+            "Shading coherence: {:.2f} surface tag(s) per "
+            "{}-wide group before sorting, {:.2f} after "
+            "sorting ({:.2f}x fewer divergent branches).",
+            unsorted, coherence_group_size, sorted, unsorted / sorted);
+    }
+}
+
+}// namespace luisa::render
+
+LUISA_RENDER_MAKE_SCENE_NODE_PLUGIN(luisa::render::WavefrontPathTracing)
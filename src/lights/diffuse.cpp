@@ -46,6 +46,17 @@ public:
     [[nodiscard]] bool is_null() const noexcept override { return _scale == 0.0f || _emission->is_black(); }
     [[nodiscard]] bool is_virtual() const noexcept override { return false; }
     [[nodiscard]] string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+    [[nodiscard]] float power(const Shape *shape, float4x4 shape_to_world) const noexcept override {
+        auto positions = shape->positions();
+        auto area = 0.0;
+        for (auto t : shape->triangles()) {
+            auto p0 = make_float3(shape_to_world * make_float4(positions[t.i0], 1.0f));
+            auto p1 = make_float3(shape_to_world * make_float4(positions[t.i1], 1.0f));
+            auto p2 = make_float3(shape_to_world * make_float4(positions[t.i2], 1.0f));
+            area += 0.5 * length(cross(p1 - p0, p2 - p0));
+        }
+        return pi * _scale * _emission->average_luminance() * static_cast<float>(area);
+    }
     [[nodiscard]] uint encode(Pipeline &pipeline, CommandBuffer &command_buffer, uint instance_id, const Shape *shape) const noexcept override {
         auto texture = pipeline.encode_texture(command_buffer, _emission);
         DiffuseLightParams params{
@@ -27,6 +27,7 @@ class PointLight final : public Light {
 
 private:
     PointLightParams _params{};
+    float _power{};
 
 public:
     PointLight(Scene *scene, const SceneNodeDesc *desc) noexcept : Light{scene, desc} {
@@ -37,11 +38,13 @@ public:
         auto scale = desc->property_float_or_default("scale", 1.0f);
         std::tie(_params.rsp, _params.scale) = RGB2SpectrumTable::srgb().decode_unbound(
             max(emission * scale, 0.0f));
+        _power = 4.0f * pi * dot(make_float3(0.212671f, 0.715160f, 0.072169f), max(emission * scale, 0.0f));
         _params.radius = desc->property_float_or_default("radius", 0.0f);
     }
     [[nodiscard]] bool is_null() const noexcept override { return _params.scale == 0.0f; }
     [[nodiscard]] bool is_virtual() const noexcept override { return true; }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+    [[nodiscard]] float power(const Shape *, float4x4) const noexcept override { return _power; }
     [[nodiscard]] uint encode(Pipeline &pipeline, CommandBuffer &command_buffer, uint, const Shape *shape) const noexcept override {
         if (!shape->is_virtual()) [[unlikely]] {
             LUISA_ERROR_WITH_LOCATION(
@@ -0,0 +1,442 @@
+#include <luisa-compute.h>
+#include <base/light_sampler.h>
+#include <base/interaction.h>
+#include <base/pipeline.h>
+
+namespace luisa::render {
+
+// Light BVH node. Interior nodes keep their first child right after
+// themselves (depth-first order) and the index of the second child in
+// `light_or_child`; leaves keep the index of their light instead.
+struct LightTreeNode {
+    float lower[3];
+    float phi;
+    float upper[3];
+    uint light_or_child;
+    float axis[3];
+    float cos_theta_o;
+    float cos_theta_e;
+    uint is_leaf;
+};
+
+}// namespace luisa::render
+
+// clang-format off
+LUISA_STRUCT(
+    luisa::render::LightTreeNode,
+    lower, phi, upper, light_or_child, axis, cos_theta_o, cos_theta_e, is_leaf) {
+    [[nodiscard]] auto p_min() const noexcept { return luisa::compute::make_float3(lower[0], lower[1], lower[2]); }
+    [[nodiscard]] auto p_max() const noexcept { return luisa::compute::make_float3(upper[0], upper[1], upper[2]); }
+    [[nodiscard]] auto w() const noexcept { return luisa::compute::make_float3(axis[0], axis[1], axis[2]); }
+};
+// clang-format on
+
+namespace luisa::render {
+
+using namespace luisa::compute;
+
+class LightBVHSampler final : public LightSampler {
+
+public:
+    luisa::unique_ptr<Instance> build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
+    LightBVHSampler(Scene *scene, const SceneNodeDesc *desc) noexcept : LightSampler{scene, desc} {}
+    [[nodiscard]] string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+};
+
+// spatial bounds, orientation cone (pbrt-v4 style) and power of a set of lights
+struct LightBounds {
+
+    float3 p_min{make_float3(std::numeric_limits<float>::max())};
+    float3 p_max{make_float3(-std::numeric_limits<float>::max())};
+    float3 w{make_float3(0.0f, 0.0f, 1.0f)};
+    float cos_theta_o{std::numeric_limits<float>::infinity()};// empty cone
+    float cos_theta_e{1.0f};
+    float phi{0.0f};
+
+    [[nodiscard]] auto centroid() const noexcept { return 0.5f * (p_min + p_max); }
+    [[nodiscard]] auto empty_cone() const noexcept { return std::isinf(cos_theta_o); }
+
+    [[nodiscard]] static auto cone_union(float3 wa, float cos_a, float3 wb, float cos_b) noexcept {
+        auto entire = std::make_pair(make_float3(0.0f, 0.0f, 1.0f), -1.0f);
+        if (std::isinf(cos_a)) { return std::make_pair(wb, cos_b); }
+        if (std::isinf(cos_b)) { return std::make_pair(wa, cos_a); }
+        auto theta_a = std::acos(std::clamp(cos_a, -1.0f, 1.0f));
+        auto theta_b = std::acos(std::clamp(cos_b, -1.0f, 1.0f));
+        auto theta_d = std::acos(std::clamp(dot(wa, wb), -1.0f, 1.0f));
+        if (std::min(theta_d + theta_b, pi) <= theta_a) { return std::make_pair(wa, cos_a); }
+        if (std::min(theta_d + theta_a, pi) <= theta_b) { return std::make_pair(wb, cos_b); }
+        auto theta_o = 0.5f * (theta_a + theta_d + theta_b);
+        if (theta_o >= pi) { return entire; }
+        auto wr = cross(wa, wb);
+        if (length(wr) < 1e-6f) { return entire; }
+        // rotate wa towards wb by (theta_o - theta_a), Rodrigues' formula
+        auto k = normalize(wr);
+        auto theta_r = theta_o - theta_a;
+        auto w = wa * std::cos(theta_r) + cross(k, wa) * std::sin(theta_r) +
+                 k * dot(k, wa) * (1.0f - std::cos(theta_r));
+        return std::make_pair(normalize(w), std::cos(theta_o));
+    }
+
+    [[nodiscard]] static auto merge(const LightBounds &a, const LightBounds &b) noexcept {
+        if (a.phi == 0.0f) { return b; }
+        if (b.phi == 0.0f) { return a; }
+        LightBounds bounds;
+        bounds.p_min = min(a.p_min, b.p_min);
+        bounds.p_max = max(a.p_max, b.p_max);
+        std::tie(bounds.w, bounds.cos_theta_o) = cone_union(a.w, a.cos_theta_o, b.w, b.cos_theta_o);
+        bounds.cos_theta_e = std::min(a.cos_theta_e, b.cos_theta_e);
+        bounds.phi = a.phi + b.phi;
+        return bounds;
+    }
+
+    // conservatively transforms object-space bounds to world space
+    [[nodiscard]] auto transform(float4x4 m) const noexcept {
+        auto bounds = *this;
+        bounds.p_min = make_float3(std::numeric_limits<float>::max());
+        bounds.p_max = make_float3(-std::numeric_limits<float>::max());
+        for (auto i = 0u; i < 8u; i++) {
+            auto corner = make_float3(
+                (i & 1u) ? p_max.x : p_min.x,
+                (i & 2u) ? p_max.y : p_min.y,
+                (i & 4u) ? p_max.z : p_min.z);
+            auto p = make_float3(m * make_float4(corner, 1.0f));
+            bounds.p_min = min(bounds.p_min, p);
+            bounds.p_max = max(bounds.p_max, p);
+        }
+        if (!empty_cone() && cos_theta_o > -1.0f) {
+            // cone angles are only preserved under similarity transforms
+            auto m3 = make_float3x3(m);
+            auto s0 = dot(m3[0], m3[0]);
+            auto s1 = dot(m3[1], m3[1]);
+            auto s2 = dot(m3[2], m3[2]);
+            auto eps = 1e-4f * std::max({s0, s1, s2});
+            auto is_similarity = std::abs(s0 - s1) <= eps && std::abs(s0 - s2) <= eps &&
+                                 std::abs(dot(m3[0], m3[1])) <= eps &&
+                                 std::abs(dot(m3[0], m3[2])) <= eps &&
+                                 std::abs(dot(m3[1], m3[2])) <= eps;
+            if (is_similarity) {
+                bounds.w = normalize(transpose(inverse(m3)) * w);
+            } else {
+                bounds.w = make_float3(0.0f, 0.0f, 1.0f);
+                bounds.cos_theta_o = -1.0f;
+            }
+        }
+        return bounds;
+    }
+};
+
+class LightBVHSamplerInstance final : public LightSampler::Instance {
+
+private:
+    luisa::vector<uint> _light_to_instance_id;
+    luisa::vector<LightBounds> _object_bounds;// per light, in object space
+    luisa::vector<InstancedTransform> _transforms;
+    luisa::vector<LightBounds> _node_bounds;
+    luisa::vector<LightTreeNode> _nodes;
+    luisa::vector<uint> _light_to_node;
+    luisa::optional<BufferView<LightTreeNode>> _node_buffer;
+    luisa::optional<BufferView<uint>> _light_buffer;
+    luisa::optional<BufferView<uint2>> _trail_buffer;
+    uint _node_buffer_id{};
+    uint _light_buffer_id{};
+    uint _trail_buffer_id{};
+    uint _max_depth{};
+
+private:
+    [[nodiscard]] static LightBounds _light_object_bounds(const Light *light, const Shape *shape, float phi) noexcept;
+    uint _build(luisa::span<uint> lights, luisa::span<const LightBounds> bounds,
+                uint depth, uint trail, luisa::vector<uint2> &trails) noexcept;
+    void _refit(float time) noexcept;
+    [[nodiscard]] static Float _importance(const Var<LightTreeNode> &node, Expr<float3> p) noexcept;
+    [[nodiscard]] Float _probability_first_child(Expr<uint> index, Expr<float3> p) const noexcept;
+
+public:
+    LightBVHSamplerInstance(const LightSampler *sampler, Pipeline &pipeline, CommandBuffer &command_buffer) noexcept;
+    void update(CommandBuffer &command_buffer, float time) noexcept override;
+    void update_lights(CommandBuffer &command_buffer) noexcept override;
+    [[nodiscard]] Float pmf(const Interaction &it, Expr<float3> p_from, const SampledWavelengths &) const noexcept override;
+    [[nodiscard]] LightSampler::Selection select(Sampler::Instance &sampler, const Interaction &it, const SampledWavelengths &) const noexcept override;
+};
+
+LightBounds LightBVHSamplerInstance::_light_object_bounds(const Light *light, const Shape *shape, float phi) noexcept {
+    LightBounds bounds;
+    bounds.phi = phi;
+    auto positions = shape->positions();
+    if (light->is_virtual() || positions.empty()) {
+        // omnidirectional emitter located at the origin of its frame
+        bounds.p_min = make_float3(0.0f);
+        bounds.p_max = make_float3(0.0f);
+        bounds.cos_theta_o = -1.0f;
+        bounds.cos_theta_e = 0.0f;
+        return bounds;
+    }
+    for (auto p : positions) {
+        bounds.p_min = min(bounds.p_min, p);
+        bounds.p_max = max(bounds.p_max, p);
+    }
+    // one-sided area emitter; the cone bounds both the geometric
+    // and the shading normals so that no emission is missed
+    bounds.cos_theta_e = 0.0f;
+    auto triangles = shape->triangles();
+    auto attributes = shape->attributes();
+    auto decode_normal = [](uint c) noexcept {
+        auto u = make_float2(static_cast<float>(c & 0xffffu), static_cast<float>(c >> 16u)) * (2.0f / 65535.0f) - 1.0f;
+        auto n = make_float3(u, 1.0f - std::abs(u.x) - std::abs(u.y));
+        if (n.z < 0.0f) {
+            n.x = (1.0f - std::abs(u.y)) * (u.x >= 0.0f ? 1.0f : -1.0f);
+            n.y = (1.0f - std::abs(u.x)) * (u.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        return normalize(n);
+    };
+    auto sum = make_float3(0.0f);
+    for (auto t : triangles) {
+        sum += cross(positions[t.i1] - positions[t.i0], positions[t.i2] - positions[t.i0]);
+    }
+    if (shape->two_sided().value_or(false) || length(sum) < 1e-6f) {
+        bounds.cos_theta_o = -1.0f;
+        return bounds;
+    }
+    bounds.w = normalize(sum);
+    bounds.cos_theta_o = 1.0f;
+    for (auto t : triangles) {
+        auto ng = cross(positions[t.i1] - positions[t.i0], positions[t.i2] - positions[t.i0]);
+        if (auto l = length(ng); l > 0.0f) {
+            bounds.cos_theta_o = std::min(bounds.cos_theta_o, dot(bounds.w, ng / l));
+        }
+    }
+    for (auto a : attributes) {
+        bounds.cos_theta_o = std::min(bounds.cos_theta_o, dot(bounds.w, decode_normal(a.compressed_normal)));
+    }
+    if (bounds.cos_theta_o < -0.99f) { bounds.cos_theta_o = -1.0f; }
+    return bounds;
+}
+
+LightBVHSamplerInstance::LightBVHSamplerInstance(
+    const LightSampler *sampler, Pipeline &pipeline, CommandBuffer &command_buffer) noexcept
+    : LightSampler::Instance{pipeline, sampler} {
+    auto n = pipeline.lights().size();
+    auto [node_buffer, node_buffer_id] = pipeline.arena_buffer<LightTreeNode>(2u * n - 1u);
+    auto [light_buffer, light_buffer_id] = pipeline.arena_buffer<uint>(n);
+    auto [trail_buffer, trail_buffer_id] = pipeline.arena_buffer<uint2>(pipeline.instance_buffer().size());
+    _node_buffer = node_buffer;
+    _light_buffer = light_buffer;
+    _trail_buffer = trail_buffer;
+    _node_buffer_id = node_buffer_id;
+    _light_buffer_id = light_buffer_id;
+    _trail_buffer_id = trail_buffer_id;
+    update_lights(command_buffer);
+}
+
+void LightBVHSamplerInstance::update_lights(CommandBuffer &command_buffer) noexcept {
+    Clock clock;
+    auto &&pipeline = this->pipeline();
+    auto n = pipeline.lights().size();
+    _light_to_instance_id.clear();
+    _object_bounds.clear();
+    _transforms.clear();
+    _light_to_instance_id.reserve(n);
+    _object_bounds.reserve(n);
+    _transforms.reserve(n);
+    for (auto &&[light, data] : pipeline.lights()) {
+        _light_to_instance_id.emplace_back(
+            Shape::Handle::encode_light_buffer_id_and_tag(
+                data.instance_id, data.tag));
+        auto phi = light->power(data.shape, data.transform.matrix(pipeline.mean_time()));
+        phi = std::isfinite(phi) ? std::max(phi, 0.0f) : 0.0f;
+        _object_bounds.emplace_back(_light_object_bounds(light, data.shape, phi));
+        _transforms.emplace_back(data.transform);
+    }
+
+    // build the topology once with the bounds at the mean shutter time;
+    // later updates only refit the nodes (see update()). The median split
+    // makes the shape of the tree, and hence the node count and the maximum
+    // depth captured by kernels, depend on the number of lights only.
+    luisa::vector<LightBounds> world_bounds(n);
+    for (auto i = 0u; i < n; i++) {
+        world_bounds[i] = _object_bounds[i].transform(
+            _transforms[i].matrix(pipeline.mean_time()));
+    }
+    luisa::vector<uint> lights(n);
+    std::iota(lights.begin(), lights.end(), 0u);
+    _nodes.clear();
+    _node_bounds.clear();
+    _light_to_node.resize(n);
+    _nodes.reserve(2u * n - 1u);
+    _node_bounds.reserve(2u * n - 1u);
+    _max_depth = 0u;
+    // per instance: branch trail from the root and leaf depth (~0u if not a light)
+    luisa::vector<uint2> trails(pipeline.instance_buffer().size(), make_uint2(0u, ~0u));
+    static_cast<void>(_build(lights, world_bounds, 0u, 0u, trails));
+    _refit(pipeline.mean_time());
+    command_buffer << _node_buffer->copy_from(_nodes.data())
+                   << _light_buffer->copy_from(_light_to_instance_id.data())
+                   << _trail_buffer->copy_from(trails.data())
+                   << compute::commit();// lifetime
+    LUISA_INFO(
+        "Built light BVH with {} node(s) over {} light(s) "
+        "(max depth = {}) in {} ms.",
+        _nodes.size(), n, _max_depth, clock.toc());
+}
+
+uint LightBVHSamplerInstance::_build(
+    luisa::span<uint> lights, luisa::span<const LightBounds> bounds,
+    uint depth, uint trail, luisa::vector<uint2> &trails) noexcept {
+    if (depth >= 32u) [[unlikely]] {
+        LUISA_ERROR_WITH_LOCATION(
+            "Light BVH is too deep (depth = {}).", depth);
+    }
+    auto index = static_cast<uint>(_nodes.size());
+    _nodes.emplace_back();
+    _node_bounds.emplace_back();
+    if (lights.size() == 1u) {
+        auto light = lights.front();
+        _nodes[index].light_or_child = light;
+        _nodes[index].is_leaf = 1u;
+        _light_to_node[light] = index;
+        auto instance_id = _light_to_instance_id[light] >> Shape::Handle::light_buffer_id_shift;
+        trails[instance_id] = make_uint2(trail, depth);
+        _max_depth = std::max(_max_depth, depth);
+        return index;
+    }
+    // median split along the largest extent of the centroids, which keeps
+    // the tree balanced so that the trail always fits in 32 bits
+    auto c_min = make_float3(std::numeric_limits<float>::max());
+    auto c_max = make_float3(-std::numeric_limits<float>::max());
+    for (auto l : lights) {
+        auto c = bounds[l].centroid();
+        c_min = min(c_min, c);
+        c_max = max(c_max, c);
+    }
+    auto extent = c_max - c_min;
+    auto axis = extent.x > extent.y && extent.x > extent.z ? 0u : (extent.y > extent.z ? 1u : 2u);
+    auto mid = lights.size() / 2u;
+    std::nth_element(
+        lights.begin(), lights.begin() + mid, lights.end(),
+        [&bounds, axis](auto lhs, auto rhs) noexcept {
+            return bounds[lhs].centroid()[axis] < bounds[rhs].centroid()[axis];
+        });
+    static_cast<void>(_build(lights.subspan(0u, mid), bounds, depth + 1u, trail, trails));
+    auto second = _build(lights.subspan(mid), bounds, depth + 1u, trail | (1u << depth), trails);
+    _nodes[index].light_or_child = second;
+    _nodes[index].is_leaf = 0u;
+    return index;
+}
+
+void LightBVHSamplerInstance::_refit(float time) noexcept {
+    for (auto i = 0u; i < _object_bounds.size(); i++) {
+        _node_bounds[_light_to_node[i]] = _object_bounds[i].transform(_transforms[i].matrix(time));
+    }
+    // children always follow their parents in depth-first order
+    for (auto i = static_cast<uint>(_nodes.size()); i != 0u; i--) {
+        auto index = i - 1u;
+        auto &node = _nodes[index];
+        if (!node.is_leaf) {
+            _node_bounds[index] = LightBounds::merge(
+                _node_bounds[index + 1u],
+                _node_bounds[node.light_or_child]);
+        }
+        auto b = _node_bounds[index];
+        node.lower[0] = b.p_min.x, node.lower[1] = b.p_min.y, node.lower[2] = b.p_min.z;
+        node.upper[0] = b.p_max.x, node.upper[1] = b.p_max.y, node.upper[2] = b.p_max.z;
+        node.axis[0] = b.w.x, node.axis[1] = b.w.y, node.axis[2] = b.w.z;
+        node.cos_theta_o = b.empty_cone() ? 1.0f : b.cos_theta_o;
+        node.cos_theta_e = b.cos_theta_e;
+        node.phi = b.phi;
+    }
+}
+
+void LightBVHSamplerInstance::update(CommandBuffer &command_buffer, float time) noexcept {
+    _refit(time);
+    command_buffer << _node_buffer->copy_from(_nodes.data())
+                   << compute::commit();// lifetime
+}
+
+Float LightBVHSamplerInstance::_importance(const Var<LightTreeNode> &node, Expr<float3> p) noexcept {
+    auto p_min = node->p_min();
+    auto p_max = node->p_max();
+    auto pc = 0.5f * (p_min + p_max);
+    auto dist2 = distance_squared(p, pc);
+    auto r2 = 0.25f * distance_squared(p_min, p_max);
+    auto d2 = max(dist2, 0.5f * distance(p_min, p_max));
+    auto wi = ite(dist2 > 0.0f, normalize(p - pc), node->w());
+    // angle between the cone axis and the direction towards p
+    auto cos_theta_w = dot(node->w(), wi);
+    auto sin_theta_w = sqrt(max(1.0f - cos_theta_w * cos_theta_w, 0.0f));
+    // angle subtended by the bounding sphere as seen from p
+    auto cos_theta_b = ite(dist2 < r2, -1.0f, sqrt(max(1.0f - r2 / dist2, 0.0f)));
+    auto sin_theta_b = sqrt(max(1.0f - cos_theta_b * cos_theta_b, 0.0f));
+    // theta' = max(theta_w - theta_o - theta_b, 0)
+    auto cos_theta_o = node.cos_theta_o;
+    auto sin_theta_o = sqrt(max(1.0f - cos_theta_o * cos_theta_o, 0.0f));
+    auto cos_theta_x = ite(cos_theta_w > cos_theta_o, 1.0f, cos_theta_w * cos_theta_o + sin_theta_w * sin_theta_o);
+    auto sin_theta_x = ite(cos_theta_w > cos_theta_o, 0.0f, sin_theta_w * cos_theta_o - cos_theta_w * sin_theta_o);
+    auto cos_theta_p = ite(cos_theta_x > cos_theta_b, 1.0f, cos_theta_x * cos_theta_b + sin_theta_x * sin_theta_b);
+    return ite(cos_theta_p <= node.cos_theta_e, 0.0f, node.phi * cos_theta_p / d2);
+}
+
+Float LightBVHSamplerInstance::_probability_first_child(Expr<uint> index, Expr<float3> p) const noexcept {
+    auto nodes = pipeline().buffer<LightTreeNode>(_node_buffer_id);
+    auto first = _importance(nodes.read(index + 1u), p);
+    auto second = _importance(nodes.read(nodes.read(index).light_or_child), p);
+    auto sum = first + second;
+    // fall back to an even split when neither child can illuminate p
+    return ite(sum > 0.0f, first / sum, 0.5f);
+}
+
+Float LightBVHSamplerInstance::pmf(const Interaction &it, Expr<float3> p_from, const SampledWavelengths &) const noexcept {
+    auto nodes = pipeline().buffer<LightTreeNode>(_node_buffer_id);
+    auto trail_and_depth = pipeline().buffer<uint2>(_trail_buffer_id).read(it.instance_id());
+    auto trail = def(trail_and_depth.x);
+    auto leaf_depth = trail_and_depth.y;
+    auto pmf = def(1.0f);
+    auto index = def(0u);
+    $for(depth, _max_depth) {
+        $if(depth >= leaf_depth) { $break; };
+        auto p_first = _probability_first_child(index, p_from);
+        $if((trail & 1u) == 0u) {
+            pmf *= p_first;
+            index += 1u;
+        }
+        $else {
+            pmf *= 1.0f - p_first;
+            index = nodes.read(index).light_or_child;
+        };
+        trail >>= 1u;
+    };
+    return ite(leaf_depth == ~0u, 0.0f, pmf);
+}
+
+LightSampler::Selection LightBVHSamplerInstance::select(
+    Sampler::Instance &sampler, const Interaction &it, const SampledWavelengths &) const noexcept {
+    auto nodes = pipeline().buffer<LightTreeNode>(_node_buffer_id);
+    auto u = sampler.generate_1d();
+    auto pmf = def(1.0f);
+    auto index = def(0u);
+    $for(depth, _max_depth) {
+        $if(nodes.read(index).is_leaf != 0u) { $break; };
+        auto p_first = _probability_first_child(index, it.p());
+        $if(u < p_first) {
+            pmf *= p_first;
+            u = u / p_first;
+            index += 1u;
+        }
+        $else {
+            pmf *= 1.0f - p_first;
+            u = (u - p_first) / (1.0f - p_first);
+            index = nodes.read(index).light_or_child;
+        };
+    };
+    auto light = nodes.read(index).light_or_child;
+    auto instance_id_and_light_tag = pipeline().buffer<uint>(_light_buffer_id).read(light);
+    auto instance_id = instance_id_and_light_tag >> Shape::Handle::light_buffer_id_shift;
+    auto light_tag = instance_id_and_light_tag & Shape::Handle::light_tag_mask;
+    return {instance_id, light_tag, pmf};
+}
+
+unique_ptr<LightSampler::Instance> LightBVHSampler::build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept {
+    return luisa::make_unique<LightBVHSamplerInstance>(this, pipeline, command_buffer);
+}
+
+}// namespace luisa::render
+
+LUISA_RENDER_MAKE_SCENE_NODE_PLUGIN(luisa::render::LightBVHSampler)
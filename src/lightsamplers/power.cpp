@@ -0,0 +1,95 @@
+#include <luisa-compute.h>
+#include <util/sampling.h>
+#include <base/light_sampler.h>
+#include <base/interaction.h>
+#include <base/pipeline.h>
+
+namespace luisa::render {
+
+class PowerLightSampler final : public LightSampler {
+
+public:
+    luisa::unique_ptr<Instance> build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept override;
+    PowerLightSampler(Scene *scene, const SceneNodeDesc *desc) noexcept : LightSampler{scene, desc} {}
+    [[nodiscard]] string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
+};
+
+class PowerLightSamplerInstance final : public LightSampler::Instance {
+
+private:
+    luisa::optional<BufferView<uint>> _light_buffer;
+    luisa::optional<BufferView<AliasEntry>> _alias_table_buffer;
+    luisa::optional<BufferView<float>> _pmf_buffer;
+    uint _light_buffer_id{};
+    uint _alias_table_buffer_id{};
+    uint _pmf_buffer_id{};// indexed by instance id, zero for non-light instances
+
+public:
+    PowerLightSamplerInstance(const LightSampler *sampler, Pipeline &pipeline, CommandBuffer &command_buffer) noexcept
+        : LightSampler::Instance{pipeline, sampler} {
+        auto n = pipeline.lights().size();
+        auto [light_buffer_view, light_buffer_id] = pipeline.arena_buffer<uint>(n);
+        auto [alias_buffer_view, alias_buffer_id] = pipeline.arena_buffer<AliasEntry>(n);
+        auto [pmf_buffer_view, pmf_buffer_id] = pipeline.arena_buffer<float>(pipeline.instance_buffer().size());
+        _light_buffer = light_buffer_view;
+        _alias_table_buffer = alias_buffer_view;
+        _pmf_buffer = pmf_buffer_view;
+        _light_buffer_id = light_buffer_id;
+        _alias_table_buffer_id = alias_buffer_id;
+        _pmf_buffer_id = pmf_buffer_id;
+        update_lights(command_buffer);
+    }
+    void update(CommandBuffer &, float) noexcept override {}
+    void update_lights(CommandBuffer &command_buffer) noexcept override {
+        auto n = pipeline().lights().size();
+        luisa::vector<uint> light_to_instance_id;
+        luisa::vector<float> power;
+        light_to_instance_id.reserve(n);
+        power.reserve(n);
+        for (auto &&[light, data] : pipeline().lights()) {
+            light_to_instance_id.emplace_back(
+                Shape::Handle::encode_light_buffer_id_and_tag(
+                    data.instance_id, data.tag));
+            auto p = light->power(data.shape, data.transform.matrix(pipeline().mean_time()));
+            power.emplace_back(std::isfinite(p) ? std::max(p, 0.0f) : 0.0f);
+        }
+        if (std::all_of(power.cbegin(), power.cend(), [](auto p) noexcept { return p == 0.0f; })) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "All lights have zero estimated power. "
+                "Falling back to uniform light selection.");
+            std::fill(power.begin(), power.end(), 1.0f);
+        }
+        auto [alias_table, pdf] = create_alias_table(power);
+        luisa::vector<float> instance_pmf(pipeline().instance_buffer().size(), 0.0f);
+        for (auto i = 0u; i < n; i++) {
+            auto instance_id = light_to_instance_id[i] >> Shape::Handle::light_buffer_id_shift;
+            instance_pmf[instance_id] = pdf[i];
+        }
+        command_buffer << _light_buffer->copy_from(light_to_instance_id.data())
+                       << _alias_table_buffer->copy_from(alias_table.data())
+                       << _pmf_buffer->copy_from(instance_pmf.data())
+                       << compute::commit();// lifetime
+    }
+    [[nodiscard]] Float pmf(const Interaction &it, Expr<float3>, const SampledWavelengths &) const noexcept override {
+        return pipeline().buffer<float>(_pmf_buffer_id).read(it.instance_id());
+    }
+    [[nodiscard]] LightSampler::Selection select(Sampler::Instance &sampler, const Interaction &it, const SampledWavelengths &) const noexcept override {
+        auto n = static_cast<uint>(pipeline().lights().size());
+        auto [i, _] = sample_alias_table(
+            pipeline().buffer<AliasEntry>(_alias_table_buffer_id),
+            n, sampler.generate_1d());
+        auto instance_id_and_light_tag = pipeline().buffer<uint>(_light_buffer_id).read(i);
+        auto instance_id = instance_id_and_light_tag >> Shape::Handle::light_buffer_id_shift;
+        auto light_tag = instance_id_and_light_tag & Shape::Handle::light_tag_mask;
+        auto pmf = pipeline().buffer<float>(_pmf_buffer_id).read(instance_id);
+        return {instance_id, light_tag, pmf};
+    }
+};
+
+unique_ptr<LightSampler::Instance> PowerLightSampler::build(Pipeline &pipeline, CommandBuffer &command_buffer) const noexcept {
+    return luisa::make_unique<PowerLightSamplerInstance>(this, pipeline, command_buffer);
+}
+
+}// namespace luisa::render
+
+LUISA_RENDER_MAKE_SCENE_NODE_PLUGIN(luisa::render::PowerLightSampler)
@@ -19,29 +19,34 @@ public:
 class UniformLightSamplerInstance final : public LightSampler::Instance {
 
 private:
+    luisa::optional<BufferView<uint>> _light_buffer;
     uint _light_buffer_id{};
 
 public:
     UniformLightSamplerInstance(const LightSampler *sampler, Pipeline &pipeline, CommandBuffer &command_buffer) noexcept
         : LightSampler::Instance{pipeline, sampler} {
         auto [view, buffer_id] = pipeline.arena_buffer<uint>(pipeline.lights().size());
+        _light_buffer = view;
         _light_buffer_id = buffer_id;
-        luisa::vector<uint> light_to_instance_id(pipeline.lights().size());
+        update_lights(command_buffer);
+    }
+    void update(CommandBuffer &, float) noexcept override {}
+    void update_lights(CommandBuffer &command_buffer) noexcept override {
+        luisa::vector<uint> light_to_instance_id(pipeline().lights().size());
         std::transform(
-            pipeline.lights().cbegin(), pipeline.lights().cend(),
+            pipeline().lights().cbegin(), pipeline().lights().cend(),
             light_to_instance_id.begin(),
             [](auto light) noexcept {
                 return Shape::Handle::encode_light_buffer_id_and_tag(
                     light.second.instance_id, light.second.tag);
             });
-        command_buffer << view.copy_from(light_to_instance_id.data())
+        command_buffer << _light_buffer->copy_from(light_to_instance_id.data())
                        << compute::commit();// lifetime
     }
-    void update(CommandBuffer &, float) noexcept override {}
     [[nodiscard]] Float pmf(const Interaction &it) const noexcept {
         return static_cast<float>(1.0 / static_cast<double>(pipeline().lights().size()));
     }
-    [[nodiscard]] Float pmf(const Interaction &it, const SampledWavelengths &) const noexcept override { return pmf(it); }
+    [[nodiscard]] Float pmf(const Interaction &it, Expr<float3>, const SampledWavelengths &) const noexcept override { return pmf(it); }
     [[nodiscard]] LightSampler::Selection select(Sampler::Instance &sampler, const Interaction &it, const SampledWavelengths &) const noexcept override {
         using namespace luisa::compute;
         auto u = sampler.generate_1d();
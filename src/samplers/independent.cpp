@@ -22,6 +22,16 @@ private:
     luisa::optional<Var<uint>> _state;
     luisa::optional<Var<uint>> _pixel_id;
 
+private:
+    // lazily allocated, see Sampler::Instance::save_state()
+    [[nodiscard]] auto &_allocated_states() noexcept {
+        if (!_states) {
+            _states = pipeline().device().create_buffer<uint>(
+                next_pow2(_resolution.x * _resolution.y));
+        }
+        return _states;
+    }
+
 public:
     IndependentSamplerInstance(const Pipeline &pipeline, const IndependentSampler *sampler) noexcept;
     void reset(CommandBuffer &command_buffer, uint2 resolution, uint spp) noexcept override;
@@ -54,8 +64,9 @@ IndependentSamplerInstance::IndependentSamplerInstance(
 void IndependentSamplerInstance::reset(CommandBuffer &command_buffer, uint2 resolution, uint /* spp */) noexcept {
     _resolution = resolution;
     auto pixel_count = _resolution.x * _resolution.y;
-    if (!_states || pixel_count > _states.size()) {
+    if (_states && pixel_count > _states.size()) {
         _states = pipeline().device().create_buffer<uint>(next_pow2(pixel_count));
+        _invalidate_state();
     }
 }
 
@@ -68,14 +79,14 @@ void IndependentSamplerInstance::start(Expr<uint2> pixel, Expr<uint> index) noex
 }
 
 void IndependentSamplerInstance::save_state() noexcept {
-    _states.write(*_pixel_id, *_state);
+    _allocated_states().write(*_pixel_id, *_state);
 }
 
 void IndependentSamplerInstance::load_state(Expr<uint2> pixel) noexcept {
     _pixel_id = luisa::nullopt;
     _pixel_id = pixel.y * _resolution.x + pixel.x;
     _state = luisa::nullopt;
-    _state = _states.read(pixel.y * _resolution.x + pixel.x);
+    _state = _allocated_states().read(pixel.y * _resolution.x + pixel.x);
 }
 
 Float IndependentSamplerInstance::generate_1d() noexcept {
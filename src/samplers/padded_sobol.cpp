@@ -30,6 +30,7 @@ class PaddedSobolSamplerInstance final : public Sampler::Instance {
 
 private:
     uint _width{};
+    uint _pixel_count{};
     luisa::optional<UInt> _seed;
     luisa::optional<UInt> _dimension;
     luisa::optional<UInt> _pixel_index;
@@ -60,6 +61,15 @@ private:
         return min(v * 0x1p-32f, one_minus_epsilon);
     }
 
+    // lazily allocated, see Sampler::Instance::save_state()
+    [[nodiscard]] auto &_allocated_states() noexcept {
+        if (!_state_buffer) {
+            _state_buffer = pipeline().device().create_buffer<uint2>(
+                next_pow2(_pixel_count));
+        }
+        return _state_buffer;
+    }
+
 public:
     explicit PaddedSobolSamplerInstance(
         const Pipeline &pipeline, CommandBuffer &command_buffer,
@@ -75,10 +85,11 @@ public:
                 "Non power-of-two samples per pixel "
                 "is not optimal for Sobol' sampler.");
         }
-        auto pixel_count = resolution.x * resolution.y;
-        if (_state_buffer.size() < pixel_count) {
+        _pixel_count = resolution.x * resolution.y;
+        if (_state_buffer && _state_buffer.size() < _pixel_count) {
             _state_buffer = pipeline().device().create_buffer<uint2>(
-                next_pow2(pixel_count));
+                next_pow2(_pixel_count));
+            _invalidate_state();
         }
         _width = resolution.x;
     }
@@ -91,11 +102,11 @@ public:
     }
     void save_state() noexcept override {
         auto state = make_uint2(*_sample_index, *_dimension);
-        _state_buffer.write(*_pixel_index, state);
+        _allocated_states().write(*_pixel_index, state);
     }
     void load_state(Expr<uint2> pixel) noexcept override {
         _pixel_index.emplace(pixel.y * _width + pixel.x);
-        auto state = _state_buffer.read(*_pixel_index);
+        auto state = _allocated_states().read(*_pixel_index);
         _sample_index.emplace(state.x);
         _dimension.emplace(state.y);
         auto seed = static_cast<const PaddedSobolSampler *>(node())->seed();
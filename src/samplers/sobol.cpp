@@ -35,6 +35,7 @@ public:
 private:
     uint _scale{};
     uint _width{};
+    uint _pixel_count{};
     luisa::optional<UInt2> _pixel;
     luisa::optional<UInt> _pixel_index;
     luisa::optional<UInt> _seed;
@@ -105,6 +106,15 @@ private:
         return n;
     };
 
+    // lazily allocated, see Sampler::Instance::save_state()
+    [[nodiscard]] auto &_allocated_states() noexcept {
+        if (!_state_buffer) {
+            _state_buffer = pipeline().device().create_buffer<uint4>(
+                next_pow2(_pixel_count));
+        }
+        return _state_buffer;
+    }
+
 public:
     explicit SobolSamplerInstance(
         const Pipeline &pipeline, CommandBuffer &command_buffer,
@@ -121,10 +131,11 @@ public:
                 "Non power-of-two samples per pixel "
                 "is not optimal for Sobol' sampler.");
         }
-        auto pixel_count = resolution.x * resolution.y;
-        if (_state_buffer.size() < pixel_count) {
+        _pixel_count = resolution.x * resolution.y;
+        if (_state_buffer && _state_buffer.size() < _pixel_count) {
             _state_buffer = pipeline().device().create_buffer<uint4>(
-                next_pow2(pixel_count));
+                next_pow2(_pixel_count));
+            _invalidate_state();
         }
         _width = resolution.x;
         _scale = next_pow2(std::max(resolution.x, resolution.y));
@@ -149,12 +160,12 @@ public:
     }
     void save_state() noexcept override {
         auto state = make_uint4(_sobol_index->bits(), *_dimension, *_seed);
-        _state_buffer.write(_pixel->y * _width + _pixel->x, state);
+        _allocated_states().write(_pixel->y * _width + _pixel->x, state);
     }
     void load_state(Expr<uint2> pixel) noexcept override {
         _pixel.emplace(pixel);
         _pixel_index.emplace(pixel.y * _width + pixel.x);
-        auto state = _state_buffer.read(*_pixel_index);
+        auto state = _allocated_states().read(*_pixel_index);
         _sobol_index.emplace(state.xy());
         _dimension.emplace(state.z);
         _seed.emplace(state.w);
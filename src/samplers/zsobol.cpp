@@ -35,6 +35,7 @@ private:
     uint _log2_spp{};
     uint _num_base4_digits{};
     uint _width{};
+    uint _pixel_count{};
     luisa::optional<UInt> _pixel_index{};
     luisa::optional<UInt> _dimension{};
     luisa::optional<U64> _morton_index{};
@@ -94,6 +95,15 @@ private:
         return min(v * 0x1p-32f, one_minus_epsilon);
     }
 
+    // lazily allocated, see Sampler::Instance::save_state()
+    [[nodiscard]] auto &_allocated_states() noexcept {
+        if (!_state_buffer) {
+            _state_buffer = pipeline().device().create_buffer<uint3>(
+                next_pow2(_pixel_count));
+        }
+        return _state_buffer;
+    }
+
 public:
     explicit ZSobolSamplerInstance(const Pipeline &pipeline, const ZSobolSampler *s) noexcept
         : Sampler::Instance{pipeline, s} {
@@ -133,10 +143,11 @@ public:
         auto res = next_pow2(std::max(resolution.x, resolution.y));
         auto log4_spp = (_log2_spp + 1u) / 2u;
         _num_base4_digits = log2_uint(res) + log4_spp;
-        auto pixel_count = resolution.x * resolution.y;
-        if (_state_buffer.size() < pixel_count) {
+        _pixel_count = resolution.x * resolution.y;
+        if (_state_buffer && _state_buffer.size() < _pixel_count) {
             _state_buffer = pipeline().device().create_buffer<uint3>(
-                next_pow2(pixel_count));
+                next_pow2(_pixel_count));
+            _invalidate_state();
         }
         _width = resolution.x;
     }
@@ -162,14 +173,14 @@ public:
     }
     void save_state() noexcept override {
         auto state = make_uint3(_morton_index->bits(), *_dimension);
-        _state_buffer.write(*_pixel_index, state);
+        _allocated_states().write(*_pixel_index, state);
     }
     void load_state(Expr<uint2> pixel) noexcept override {
         _dimension = luisa::nullopt;
         _pixel_index = luisa::nullopt;
         _morton_index = luisa::nullopt;
         _pixel_index = pixel.y * _width + pixel.x;
-        auto state = _state_buffer.read(*_pixel_index);
+        auto state = _allocated_states().read(*_pixel_index);
         _morton_index = U64{state.xy()};
         _dimension = state.z;
     }
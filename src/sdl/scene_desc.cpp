@@ -72,6 +72,36 @@ SceneNodeDesc *SceneDesc::define(
     return node;
 }
 
+SceneNodeDesc *SceneDesc::redefine(
+    std::string_view identifier, SceneNodeTag tag, std::string_view impl_type,
+    SceneNodeDesc::SourceLocation location, const SceneNodeDesc *base) noexcept {
+    std::scoped_lock lock{_mutex};
+    if (auto iter = _global_nodes.find_as(identifier, NodeHash{}, NodeEqual{});
+        iter != _global_nodes.cend() && (*iter)->is_defined()) {
+        auto node = iter->get();
+        if (node->tag() != tag) [[unlikely]] {
+            LUISA_ERROR(
+                "Cannot redefine node '{}' ({}::{}) "
+                "with a different tag {}. [{}]",
+                node->identifier(),
+                scene_node_tag_description(node->tag()),
+                node->impl_type(),
+                scene_node_tag_description(tag),
+                location.string());
+        }
+        if (base == node) [[unlikely]] {
+            LUISA_ERROR(
+                "Node '{}' cannot be redefined "
+                "based on itself. [{}]",
+                node->identifier(), location.string());
+        }
+        node->undefine();
+        node->define(tag, impl_type, location, base);
+        return node;
+    }
+    return define(identifier, tag, impl_type, location, base);
+}
+
 SceneNodeDesc *SceneDesc::define_root(SceneNodeDesc::SourceLocation location) noexcept {
     std::scoped_lock lock{_mutex};
     if (_root.is_defined()) [[unlikely]] {
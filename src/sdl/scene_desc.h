@@ -48,6 +48,11 @@ public:
     [[nodiscard]] SceneNodeDesc *define(
         std::string_view identifier, SceneNodeTag tag, std::string_view impl_type,
         SceneNodeDesc::SourceLocation location = {}, const SceneNodeDesc *base = nullptr) noexcept;
+    // like define(), but replaces the content of an already defined node
+    // of the same tag, so that existing references observe the new definition
+    [[nodiscard]] SceneNodeDesc *redefine(
+        std::string_view identifier, SceneNodeTag tag, std::string_view impl_type,
+        SceneNodeDesc::SourceLocation location = {}, const SceneNodeDesc *base = nullptr) noexcept;
     [[nodiscard]] SceneNodeDesc *define_root(SceneNodeDesc::SourceLocation location = {}) noexcept;
     const std::filesystem::path *register_path(std::filesystem::path path) noexcept;
 };
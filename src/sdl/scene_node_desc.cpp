@@ -28,6 +28,29 @@ void SceneNodeDesc::define(SceneNodeTag tag, luisa::string_view t, SceneNodeDesc
     }
 }
 
+void SceneNodeDesc::undefine() noexcept {
+    _impl_type.clear();
+    _base = nullptr;
+    _properties.clear();
+}
+
+void SceneNodeDesc::collect_references(luisa::unordered_set<luisa::string, Hash64> &identifiers) const noexcept {
+    auto visit = [&identifiers](const SceneNodeDesc *node) noexcept {
+        if (node == nullptr) { return; }
+        if (node->is_internal()) {
+            node->collect_references(identifiers);
+        } else {
+            identifiers.emplace(node->identifier());
+        }
+    };
+    visit(_base);
+    for (auto &&[_, values] : _properties) {
+        if (auto nodes = luisa::get_if<node_list>(&values)) {
+            for (auto n : *nodes) { visit(n); }
+        }
+    }
+}
+
 SceneNodeDesc *SceneNodeDesc::define_internal(
     luisa::string_view impl_type, SourceLocation location, const SceneNodeDesc *base) noexcept {
     auto unique_node = luisa::make_unique<SceneNodeDesc>(
@@ -164,6 +164,12 @@ public:
     [[nodiscard]] auto impl_type() const noexcept { return luisa::string_view{_impl_type}; }
     [[nodiscard]] auto source_location() const noexcept { return _location; }
     void define(SceneNodeTag tag, luisa::string_view t, SourceLocation l, const SceneNodeDesc *base = nullptr) noexcept;
+    // drops the properties so that the node can be defined again by an
+    // update; internal nodes are kept alive as they may still be referenced
+    void undefine() noexcept;
+    // identifiers of the global nodes referenced by this node, directly or
+    // through its internal nodes and base nodes
+    void collect_references(luisa::unordered_set<luisa::string, Hash64> &identifiers) const noexcept;
     [[nodiscard]] auto &properties() const noexcept { return _properties; }
     [[nodiscard]] bool has_property(luisa::string_view prop) const noexcept;
     void add_property(luisa::string_view name, value_list values) noexcept;
@@ -4,22 +4,26 @@
 
 #include <fstream>
 #include <streambuf>
+#include <stdexcept>
 #include <fast_float/fast_float.h>
 
 #include <core/logging.h>
 #include <core/thread_pool.h>
+#include <sdl/scene_desc.h>
 #include <sdl/scene_parser.h>
 
 namespace luisa::render {
 
-inline SceneParser::SceneParser(SceneDesc &desc, const std::filesystem::path &path) noexcept
+inline SceneParser::SceneParser(SceneDesc &desc, const std::filesystem::path &path)
     : _desc{desc},
       _location{desc.register_path(std::filesystem::canonical(path))},
       _cursor{0u} {}
 
 template<typename... Args>
-inline void SceneParser::_report_error(std::string_view format, Args &&...args) const noexcept {
-    LUISA_ERROR("{} [{}]", fmt::format(format, std::forward<Args>(args)...), _location.string());
+inline void SceneParser::_report_error(std::string_view format, Args &&...args) const {
+    auto message = fmt::format("{} [{}]", fmt::format(format, std::forward<Args>(args)...), _location.string());
+    if (_recoverable) { throw std::runtime_error{message}; }
+    LUISA_ERROR("{}", message);
 }
 
 template<typename... Args>
@@ -27,7 +31,7 @@ inline void SceneParser::_report_warning(std::string_view format, Args &&...args
     LUISA_WARNING("{} [{}]", fmt::format(format, std::forward<Args>(args)...), _location.string());
 }
 
-inline void SceneParser::_parse_file() noexcept {
+inline void SceneParser::_parse_file() {
     std::ifstream file{*_location.file()};
     _source = {
         std::istreambuf_iterator<char>{file},
@@ -37,7 +41,7 @@ inline void SceneParser::_parse_file() noexcept {
     _source.shrink_to_fit();
 }
 
-inline void SceneParser::_parse_source() noexcept {
+inline void SceneParser::_parse_source() {
     _skip_blanks();
     while (!_eof()) {
         auto loc = _location;
@@ -45,11 +49,21 @@ inline void SceneParser::_parse_source() noexcept {
             _skip_blanks();
             std::filesystem::path path{_read_string()};
             if (!path.is_absolute()) { path = _location.file()->parent_path() / path; }
-            ThreadPool::global().async(
-                [path = std::move(path), &desc = _desc] {
-                    SceneParser{desc, path}._parse_file();
-                });
+            if (_updated_nodes != nullptr) {// updates are applied in order
+                SceneParser parser{_desc, path};
+                parser._updated_nodes = _updated_nodes;
+                parser._recoverable = _recoverable;
+                parser._parse_file();
+            } else {
+                ThreadPool::global().async(
+                    [path = std::move(path), &desc = _desc] {
+                        SceneParser{desc, path}._parse_file();
+                    });
+            }
         } else if (token == SceneDesc::root_node_identifier) {// root node
+            if (_updated_nodes != nullptr) [[unlikely]] {
+                _report_error("The root node cannot be updated.");
+            }
             _parse_root_node(loc);
         } else [[likely]] {// scene node
             _parse_global_node(loc, token);
@@ -58,7 +72,7 @@ inline void SceneParser::_parse_source() noexcept {
     }
 }
 
-inline void SceneParser::_match(char c) noexcept {
+inline void SceneParser::_match(char c) {
     if (auto got = _get(); got != c) [[unlikely]] {
         _report_error(
             "Invalid character '{}' "
@@ -67,9 +81,9 @@ inline void SceneParser::_match(char c) noexcept {
     }
 }
 
-void SceneParser::_skip() noexcept { static_cast<void>(_get()); }
+void SceneParser::_skip() { static_cast<void>(_get()); }
 
-inline char SceneParser::_peek() noexcept {
+inline char SceneParser::_peek() {
     if (_eof()) [[unlikely]] { _report_error("Premature EOF."); }
     auto c = _source[_cursor];
     if (c == '\r') {
@@ -79,7 +93,7 @@ inline char SceneParser::_peek() noexcept {
     return c;
 }
 
-inline char SceneParser::_get() noexcept {
+inline char SceneParser::_get() {
     if (_eof()) [[unlikely]] { _report_error("Premature EOF."); }
     auto c = _source[_cursor++];
     if (c == '\r') {
@@ -101,7 +115,7 @@ inline bool SceneParser::_eof() const noexcept {
     return _cursor >= _source.size();
 }
 
-inline std::string_view SceneParser::_read_identifier() noexcept {
+inline std::string_view SceneParser::_read_identifier() {
     auto offset = _cursor;
     if (auto c = _get(); c != '$' && !isalpha(c)) [[unlikely]] {
         _report_error("Invalid character '{}' in identifier.", c);
@@ -114,7 +128,7 @@ inline std::string_view SceneParser::_read_identifier() noexcept {
         .substr(offset, _cursor - offset);
 }
 
-inline double SceneParser::_read_number() noexcept {
+inline double SceneParser::_read_number() {
     if (_peek() == '+') [[unlikely]] { _skip(); }
     // TODO: allow white spaces between +/- and the numbers?
     auto s = std::string_view{_source}.substr(_cursor);
@@ -130,7 +144,7 @@ inline double SceneParser::_read_number() noexcept {
     return value;
 }
 
-inline bool SceneParser::_read_bool() noexcept {
+inline bool SceneParser::_read_bool() {
     using namespace std::string_view_literals;
     if (_peek() == 't') {
         for (auto x : "true"sv) { _match(x); }
@@ -140,7 +154,7 @@ inline bool SceneParser::_read_bool() noexcept {
     return false;
 }
 
-inline luisa::string SceneParser::_read_string() noexcept {
+inline luisa::string SceneParser::_read_string() {
     auto quote = _get();
     if (quote != '"' && quote != '\'') [[unlikely]] {
         _report_error("Expected string but got {}.", quote);
@@ -173,7 +187,7 @@ inline luisa::string SceneParser::_read_string() noexcept {
     return s;
 }
 
-inline void SceneParser::_skip_blanks() noexcept {
+inline void SceneParser::_skip_blanks() {
     while (!_eof()) {
         if (auto c = _peek(); isblank(c) || c == '\n') {// blank
             _skip();
@@ -187,11 +201,11 @@ inline void SceneParser::_skip_blanks() noexcept {
     }
 }
 
-inline void SceneParser::_parse_root_node(SceneNodeDesc::SourceLocation l) noexcept {
+inline void SceneParser::_parse_root_node(SceneNodeDesc::SourceLocation l) {
     _parse_node_body(_desc.define_root(l));
 }
 
-inline void SceneParser::_parse_global_node(SceneNodeDesc::SourceLocation l, std::string_view tag_desc) noexcept {
+inline void SceneParser::_parse_global_node(SceneNodeDesc::SourceLocation l, std::string_view tag_desc) {
     using namespace std::string_view_literals;
     static constexpr auto desc_to_tag_count = 23u;
     static const luisa::fixed_map<std::string_view, SceneNodeTag, desc_to_tag_count> desc_to_tag{
@@ -238,15 +252,34 @@ inline void SceneParser::_parse_global_node(SceneNodeDesc::SourceLocation l, std
         if (_peek() == '(') { base = _parse_base_node(); }
         _skip_blanks();
     }
-    _parse_node_body(_desc.define(name, tag, impl_type, l, base));
+    if (_updated_nodes == nullptr) {
+        _parse_node_body(_desc.define(name, tag, impl_type, l, base));
+    } else {
+        // checked here instead of by the description so that check_update() can recover
+        if (name == SceneDesc::root_node_identifier || tag == SceneNodeTag::DECLARATION) [[unlikely]] {
+            _report_error("Node '{}' cannot be defined as a global node.", name);
+        }
+        if (base != nullptr && base->identifier() == name) [[unlikely]] {
+            _report_error("Node '{}' cannot be redefined based on itself.", name);
+        }
+        auto node = _desc.redefine(name, tag, impl_type, l, base);
+        _parse_node_body(node);
+        _updated_nodes->emplace_back(node);
+    }
 }
 
-void SceneParser::_parse_node_body(SceneNodeDesc *node) noexcept {
+void SceneParser::_parse_node_body(SceneNodeDesc *node) {
     _skip_blanks();
     _match('{');
     _skip_blanks();
     while (_peek() != '}') {
         auto prop = _read_identifier();
+        if (node->has_property(prop)) [[unlikely]] {
+            _report_error(
+                "Redefinition of property '{}' in "
+                "scene description node '{}'.",
+                prop, node->identifier());
+        }
         _skip_blanks();
         if (auto c = _peek(); c == ':') {// inline node
             _skip();
@@ -266,10 +299,10 @@ void SceneParser::_parse_node_body(SceneNodeDesc *node) noexcept {
     _match('}');
 }
 
-inline SceneNodeDesc::value_list SceneParser::_parse_value_list(SceneNodeDesc *node) noexcept {
+inline SceneNodeDesc::value_list SceneParser::_parse_value_list(SceneNodeDesc *node) {
     _match('{');
     _skip_blanks();
-    auto value_list = [node, this]() noexcept -> SceneNodeDesc::value_list {
+    auto value_list = [node, this]() -> SceneNodeDesc::value_list {
         auto c = _peek();
         if (c == '}') [[unlikely]] { _report_error("Empty value list."); }
         if (c == '@' || isupper(c)) { return _parse_node_list_values(node); }
@@ -282,7 +315,7 @@ inline SceneNodeDesc::value_list SceneParser::_parse_value_list(SceneNodeDesc *n
     return value_list;
 }
 
-inline SceneNodeDesc::number_list SceneParser::_parse_number_list_values() noexcept {
+inline SceneNodeDesc::number_list SceneParser::_parse_number_list_values() {
     SceneNodeDesc::number_list list;
     list.emplace_back(_read_number());
     _skip_blanks();
@@ -295,7 +328,7 @@ inline SceneNodeDesc::number_list SceneParser::_parse_number_list_values() noexc
     return list;
 }
 
-inline SceneNodeDesc::bool_list SceneParser::_parse_bool_list_values() noexcept {
+inline SceneNodeDesc::bool_list SceneParser::_parse_bool_list_values() {
     SceneNodeDesc::bool_list list;
     list.emplace_back(_read_bool());
     _skip_blanks();
@@ -308,13 +341,13 @@ inline SceneNodeDesc::bool_list SceneParser::_parse_bool_list_values() noexcept
     return list;
 }
 
-inline SceneNodeDesc::node_list SceneParser::_parse_node_list_values(SceneNodeDesc *node) noexcept {
+inline SceneNodeDesc::node_list SceneParser::_parse_node_list_values(SceneNodeDesc *node) {
 
-    auto parse_ref_or_def = [node, this]() noexcept -> const auto * {
+    auto parse_ref_or_def = [node, this]() -> const auto * {
         if (_peek() == '@') {// reference
             _skip();
             _skip_blanks();
-            return _desc.reference(_read_identifier());
+            return _reference(_read_identifier());
         }
         // inline definition
         auto loc = _location;
@@ -338,7 +371,7 @@ inline SceneNodeDesc::node_list SceneParser::_parse_node_list_values(SceneNodeDe
     return list;
 }
 
-inline SceneNodeDesc::string_list SceneParser::_parse_string_list_values() noexcept {
+inline SceneNodeDesc::string_list SceneParser::_parse_string_list_values() {
     SceneNodeDesc::string_list list;
     list.emplace_back(_read_string());
     _skip_blanks();
@@ -358,15 +391,68 @@ luisa::unique_ptr<SceneDesc> SceneParser::parse(const std::filesystem::path &ent
     return desc;
 }
 
-const SceneNodeDesc *SceneParser::_parse_base_node() noexcept {
+luisa::vector<const SceneNodeDesc *> SceneParser::parse_update(
+    SceneDesc &desc, const std::filesystem::path &update_file) noexcept {
+    luisa::vector<const SceneNodeDesc *> updated_nodes;
+    SceneParser parser{desc, update_file};
+    parser._updated_nodes = &updated_nodes;
+    parser._parse_file();
+    return updated_nodes;
+}
+
+luisa::optional<luisa::string> SceneParser::check_update(
+    const SceneDesc &desc, const std::filesystem::path &update_file) noexcept {
+    SceneDesc scratch;
+    luisa::vector<const SceneNodeDesc *> updated_nodes;
+    try {
+        SceneParser parser{scratch, update_file};
+        parser._updated_nodes = &updated_nodes;
+        parser._recoverable = true;
+        parser._parse_file();
+    } catch (const std::exception &e) {
+        return luisa::string{e.what()};
+    }
+    // the nodes of the update either redefine nodes of the same tag
+    // or are new, and every node they reference has to be defined
+    for (auto &&node : scratch.nodes()) {
+        auto iter = desc.nodes().find_as(node->identifier(), SceneDesc::NodeHash{}, SceneDesc::NodeEqual{});
+        auto existing = iter != desc.nodes().cend() && (*iter)->is_defined() ? iter->get() : nullptr;
+        if (!node->is_defined()) {
+            if (existing == nullptr) [[unlikely]] {
+                return luisa::format(
+                    "Reference to undefined node '{}'.",
+                    node->identifier());
+            }
+        } else if (existing != nullptr && existing->tag() != node->tag()) [[unlikely]] {
+            return luisa::format(
+                "Cannot redefine node '{}' ({}::{}) "
+                "with a different tag {}. [{}]",
+                node->identifier(),
+                scene_node_tag_description(existing->tag()),
+                existing->impl_type(),
+                scene_node_tag_description(node->tag()),
+                node->source_location().string());
+        }
+    }
+    return luisa::nullopt;
+}
+
+const SceneNodeDesc *SceneParser::_parse_base_node() {
     _match('(');
     _skip_blanks();
     _match('@');
     _skip_blanks();
-    auto base = _desc.reference(_read_identifier());
+    auto base = _reference(_read_identifier());
     _skip_blanks();
     _match(')');
     return base;
 }
 
+const SceneNodeDesc *SceneParser::_reference(std::string_view identifier) {
+    if (identifier == SceneDesc::root_node_identifier) [[unlikely]] {
+        _report_error("Invalid reference to root node.");
+    }
+    return _desc.reference(identifier);
+}
+
 }// namespace luisa::render
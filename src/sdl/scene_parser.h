@@ -18,40 +18,43 @@ class SceneParser {
 
 private:
     SceneDesc &_desc;
+    luisa::vector<const SceneNodeDesc *> *_updated_nodes{nullptr};// non-null when parsing an update
+    bool _recoverable{false};// errors are thrown as std::runtime_error instead of aborting
     SceneNodeDesc::SourceLocation _location;
     luisa::string _source;
     size_t _cursor;
 
 private:
     template<typename... Args>
-    [[noreturn]] void _report_error(std::string_view format, Args &&...args) const noexcept;
+    [[noreturn]] void _report_error(std::string_view format, Args &&...args) const;
     template<typename... Args>
     void _report_warning(std::string_view format, Args &&...args) const noexcept;
 
 private:
-    void _match(char c) noexcept;
-    void _skip() noexcept;
-    void _skip_blanks() noexcept;
-    [[nodiscard]] char _peek() noexcept;
-    [[nodiscard]] char _get() noexcept;
+    void _match(char c);
+    void _skip();
+    void _skip_blanks();
+    [[nodiscard]] char _peek();
+    [[nodiscard]] char _get();
     [[nodiscard]] bool _eof() const noexcept;
-    [[nodiscard]] std::string_view _read_identifier() noexcept;
-    [[nodiscard]] double _read_number() noexcept;
-    [[nodiscard]] bool _read_bool() noexcept;
-    [[nodiscard]] luisa::string _read_string() noexcept;
-    void _parse_file() noexcept;
-    void _parse_source() noexcept;
-    void _parse_root_node(SceneNodeDesc::SourceLocation l) noexcept;
-    void _parse_global_node(SceneNodeDesc::SourceLocation l, std::string_view tag_desc) noexcept;
-    void _parse_node_body(SceneNodeDesc *node) noexcept;
-    [[nodiscard]] SceneNodeDesc::value_list _parse_value_list(SceneNodeDesc *node) noexcept;
-    [[nodiscard]] SceneNodeDesc::number_list _parse_number_list_values() noexcept;
-    [[nodiscard]] SceneNodeDesc::bool_list _parse_bool_list_values() noexcept;
-    [[nodiscard]] SceneNodeDesc::node_list _parse_node_list_values(SceneNodeDesc *node) noexcept;
-    [[nodiscard]] SceneNodeDesc::string_list _parse_string_list_values() noexcept;
-    [[nodiscard]] const SceneNodeDesc *_parse_base_node() noexcept;
+    [[nodiscard]] std::string_view _read_identifier();
+    [[nodiscard]] double _read_number();
+    [[nodiscard]] bool _read_bool();
+    [[nodiscard]] luisa::string _read_string();
+    void _parse_file();
+    void _parse_source();
+    void _parse_root_node(SceneNodeDesc::SourceLocation l);
+    void _parse_global_node(SceneNodeDesc::SourceLocation l, std::string_view tag_desc);
+    void _parse_node_body(SceneNodeDesc *node);
+    [[nodiscard]] SceneNodeDesc::value_list _parse_value_list(SceneNodeDesc *node);
+    [[nodiscard]] SceneNodeDesc::number_list _parse_number_list_values();
+    [[nodiscard]] SceneNodeDesc::bool_list _parse_bool_list_values();
+    [[nodiscard]] SceneNodeDesc::node_list _parse_node_list_values(SceneNodeDesc *node);
+    [[nodiscard]] SceneNodeDesc::string_list _parse_string_list_values();
+    [[nodiscard]] const SceneNodeDesc *_parse_base_node();
+    [[nodiscard]] const SceneNodeDesc *_reference(std::string_view identifier);
 
-    SceneParser(SceneDesc &desc, const std::filesystem::path &path) noexcept;
+    SceneParser(SceneDesc &desc, const std::filesystem::path &path);
 
 public:
     SceneParser(SceneParser &&) noexcept = default;
@@ -59,6 +62,16 @@ public:
     SceneParser &operator=(SceneParser &&) noexcept = delete;
     SceneParser &operator=(const SceneParser &) noexcept = delete;
     [[nodiscard]] static luisa::unique_ptr<SceneDesc> parse(const std::filesystem::path &entry_file) noexcept;
+    // parses a scene description file into an existing description, where global nodes
+    // that are already defined get redefined in place; returns the (re)defined nodes
+    [[nodiscard]] static luisa::vector<const SceneNodeDesc *> parse_update(
+        SceneDesc &desc, const std::filesystem::path &update_file) noexcept;
+    // dry-runs parse_update() on a scratch description, without touching `desc`;
+    // returns the syntax, reference or tag error the update would be rejected with,
+    // or nullopt otherwise. Plugins and property values are not resolved here, so
+    // an update that passes may still abort when the scene creates its nodes
+    [[nodiscard]] static luisa::optional<luisa::string> check_update(
+        const SceneDesc &desc, const std::filesystem::path &update_file) noexcept;
 };
 
 }// namespace luisa::render
@@ -7,30 +7,174 @@
 #include <assimp/scene.h>
 #include <assimp/mesh.h>
 
+#include <array>
+#include <atomic>
+#include <limits>
+#include <cstring>
+#include <random>
+#include <fstream>
+
 #include <core/thread_pool.h>
+#include <util/mapped_file.h>
+#include <util/parallel.h>
 #include <base/shape.h>
 
 namespace luisa::render {
 
+// Binary cache of the processed mesh, stored next to the source file, so
+// that repeated loads of the same asset skip Assimp import and attribute
+// encoding entirely. The cache is invalidated when the size or modification
+// time of the source changes, or when the format version is bumped (which
+// must be done whenever the import flags or the vertex encoding change).
+struct MeshCacheHeader {
+    static constexpr std::array<char, 8u> expected_magic{'L', 'R', 'M', 'E', 'S', 'H', '\0', '\0'};
+    static constexpr auto current_version = 2u;
+    std::array<char, 8u> magic;
+    uint32_t version;
+    uint32_t has_uv;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t vertex_count;
+    uint64_t triangle_count;
+    [[nodiscard]] auto payload_size() const noexcept {
+        return vertex_count * (sizeof(float3) + sizeof(Shape::VertexAttribute)) +
+               triangle_count * sizeof(Triangle);
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<MeshCacheHeader>);
+// keeps the mapped payload arrays properly aligned
+static_assert(sizeof(MeshCacheHeader) % alignof(float3) == 0u);
+static_assert(sizeof(float3) % alignof(Shape::VertexAttribute) == 0u);
+static_assert(sizeof(Shape::VertexAttribute) % alignof(Triangle) == 0u);
+
 class MeshLoader {
 
 private:
     luisa::vector<float3> _positions;
     luisa::vector<Shape::VertexAttribute> _attributes;
     luisa::vector<Triangle> _triangles;
+    // when loaded from the cache, the data lives in the mapped file instead
+    luisa::shared_ptr<MappedFile> _mapped;
+    size_t _mapped_vertex_count{};
+    size_t _mapped_triangle_count{};
     bool _has_uv{};
 
+private:
+    [[nodiscard]] static auto _cache_header(const std::filesystem::path &path) noexcept {
+        std::error_code ec;
+        MeshCacheHeader header{};
+        header.magic = MeshCacheHeader::expected_magic;
+        header.version = MeshCacheHeader::current_version;
+        header.source_size = std::filesystem::file_size(path, ec);
+        if (ec) { return luisa::optional<MeshCacheHeader>{}; }
+        header.source_mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+        if (ec) { return luisa::optional<MeshCacheHeader>{}; }
+        return luisa::optional<MeshCacheHeader>{header};
+    }
+
+    // maps the cache file instead of reading it, so the returned loader
+    // hands out spans that point straight into the (lazily paged) file
+    [[nodiscard]] static auto _load_cache(const std::filesystem::path &cache_path,
+                                          const MeshCacheHeader &expected) noexcept {
+        luisa::optional<MeshLoader> loader;
+        std::error_code ec;
+        if (!std::filesystem::exists(cache_path, ec)) { return loader; }
+        auto file = MappedFile::open(cache_path);
+        if (file == nullptr || file->size() < sizeof(MeshCacheHeader)) { return loader; }
+        MeshCacheHeader header{};
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (header.magic != expected.magic ||
+            header.version != expected.version ||
+            header.source_size != expected.source_size ||
+            header.source_mtime != expected.source_mtime) { return loader; }
+        if (file->size() != sizeof(header) + header.payload_size()) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Ignoring truncated mesh cache '{}'.",
+                cache_path.string());
+            return loader;
+        }
+        MeshLoader m;
+        m._has_uv = header.has_uv != 0u;
+        m._mapped_vertex_count = header.vertex_count;
+        m._mapped_triangle_count = header.triangle_count;
+        m._mapped = luisa::shared_ptr<MappedFile>{std::move(file)};
+        loader.emplace(std::move(m));
+        return loader;
+    }
+
+    [[nodiscard]] bool _save_cache(const std::filesystem::path &cache_path, MeshCacheHeader header) const noexcept {
+        header.has_uv = _has_uv ? 1u : 0u;
+        header.vertex_count = _positions.size();
+        header.triangle_count = _triangles.size();
+        // write to a temporary file and rename it over the cache, so that
+        // concurrent or interrupted writers never leave a corrupted entry
+        std::random_device random;
+        auto temp_path = cache_path;
+        temp_path += luisa::format(".{:08x}{:08x}.tmp", random(), random());
+        {
+            std::ofstream file{temp_path, std::ios::binary | std::ios::trunc};
+            if (!file.write(reinterpret_cast<const char *>(&header), sizeof(header)) ||
+                !file.write(reinterpret_cast<const char *>(_positions.data()), _positions.size_bytes()) ||
+                !file.write(reinterpret_cast<const char *>(_attributes.data()), _attributes.size_bytes()) ||
+                !file.write(reinterpret_cast<const char *>(_triangles.data()), _triangles.size_bytes())) [[unlikely]] {
+                LUISA_WARNING_WITH_LOCATION(
+                    "Failed to write mesh cache '{}'.",
+                    cache_path.string());
+                file.close();
+                std::error_code ec;
+                std::filesystem::remove(temp_path, ec);
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp_path, cache_path, ec);
+        if (ec) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Failed to write mesh cache '{}': {}.",
+                cache_path.string(), ec.message());
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+        return true;
+    }
+
 public:
-    [[nodiscard]] auto positions() const noexcept { return luisa::span{_positions}; }
-    [[nodiscard]] auto attributes() const noexcept { return luisa::span{_attributes}; }
-    [[nodiscard]] auto triangles() const noexcept { return luisa::span{_triangles}; }
+    [[nodiscard]] luisa::span<const float3> positions() const noexcept {
+        if (_mapped == nullptr) { return _positions; }
+        return _mapped->view<float3>(sizeof(MeshCacheHeader), _mapped_vertex_count);
+    }
+    [[nodiscard]] luisa::span<const Shape::VertexAttribute> attributes() const noexcept {
+        if (_mapped == nullptr) { return _attributes; }
+        return _mapped->view<Shape::VertexAttribute>(
+            sizeof(MeshCacheHeader) + _mapped_vertex_count * sizeof(float3),
+            _mapped_vertex_count);
+    }
+    [[nodiscard]] luisa::span<const Triangle> triangles() const noexcept {
+        if (_mapped == nullptr) { return _triangles; }
+        return _mapped->view<Triangle>(
+            sizeof(MeshCacheHeader) +
+                _mapped_vertex_count * (sizeof(float3) + sizeof(Shape::VertexAttribute)),
+            _mapped_triangle_count);
+    }
     [[nodiscard]] auto has_uv() const noexcept { return _has_uv; }
 
-    [[nodiscard]] static auto load(std::filesystem::path path) noexcept {
+    [[nodiscard]] static auto load(std::filesystem::path path, bool use_cache) noexcept {
 
-        return ThreadPool::global().async([path = std::move(path)] {
+        return ThreadPool::global().async([path = std::move(path), use_cache] {
             Clock clock;
             auto path_string = path.string();
+            auto cache_path = path;
+            cache_path += ".lrmesh";
+            auto cache_header = use_cache ? _cache_header(path) : luisa::nullopt;
+            if (cache_header) {
+                if (auto cached = _load_cache(cache_path, *cache_header)) {
+                    LUISA_INFO(
+                        "Loaded triangle mesh '{}' from cache in {} ms.",
+                        path_string, clock.toc());
+                    return std::move(*cached);
+                }
+            }
             Assimp::Importer importer;
             importer.SetPropertyInteger(
                 AI_CONFIG_PP_RVC_FLAGS,
@@ -43,85 +187,135 @@ public:
                 aiPrimitiveType_LINE | aiPrimitiveType_POINT);
             importer.SetPropertyBool(
                 AI_CONFIG_PP_FD_CHECKAREA, false);
+            // note: sub-meshes are merged below in parallel, so Assimp
+            // is not asked to merge them (i.e., no OptimizeMeshes/Graph)
             auto model = importer.ReadFile(
                 path_string.c_str(),
                 aiProcess_Triangulate | aiProcess_JoinIdenticalVertices |
                     aiProcess_RemoveComponent | aiProcess_ImproveCacheLocality |
-                    aiProcess_OptimizeMeshes | aiProcess_OptimizeGraph |
                     aiProcess_GenNormals | aiProcess_GenUVCoords |
                     aiProcess_CalcTangentSpace | aiProcess_FixInfacingNormals |
                     aiProcess_PreTransformVertices | aiProcess_RemoveRedundantMaterials |
                     aiProcess_FindInvalidData | aiProcess_TransformUVCoords |
                     aiProcess_SortByPType | aiProcess_FindDegenerates);
             if (model == nullptr || (model->mFlags & AI_SCENE_FLAGS_INCOMPLETE) ||
-                model->mRootNode == nullptr || model->mRootNode->mNumMeshes == 0) [[unlikely]] {
+                model->mRootNode == nullptr || model->mNumMeshes == 0) [[unlikely]] {
                 LUISA_ERROR_WITH_LOCATION(
                     "Failed to load mesh '{}': {}.",
                     path_string, importer.GetErrorString());
             }
-            auto mesh = model->mMeshes[0];
-            if (auto uv_count = std::count_if(
-                    std::cbegin(mesh->mTextureCoords),
-                    std::cend(mesh->mTextureCoords),
-                    [](auto p) noexcept { return p != nullptr; });
-                uv_count > 1) [[unlikely]] {
-                LUISA_WARNING_WITH_LOCATION(
-                    "More than one set of texture coordinates "
-                    "found in mesh '{}'. Only the first set "
-                    "will be considered.",
-                    path_string);
-            }
-            if (mesh->mTextureCoords[0] == nullptr ||
-                mesh->mNumUVComponents[0] != 2) [[unlikely]] {
-                LUISA_WARNING_WITH_LOCATION(
-                    "Invalid texture coordinates in mesh '{}': "
-                    "address = {}, components = {}.",
-                    path_string,
-                    fmt::ptr(mesh->mTextureCoords[0]),
-                    mesh->mNumUVComponents[0]);
+            auto import_time = clock.toc();
+            // lay out all sub-meshes back to back in the merged mesh
+            luisa::span<aiMesh *const> meshes{model->mMeshes, model->mNumMeshes};
+            luisa::vector<uint> vertex_offsets(meshes.size() + 1u, 0u);
+            luisa::vector<size_t> triangle_offsets(meshes.size() + 1u, 0u);
+            auto has_uv = true;
+            for (auto m = 0u; m < meshes.size(); m++) {
+                auto mesh = meshes[m];
+                if (auto uv_count = std::count_if(
+                        std::cbegin(mesh->mTextureCoords),
+                        std::cend(mesh->mTextureCoords),
+                        [](auto p) noexcept { return p != nullptr; });
+                    uv_count > 1) [[unlikely]] {
+                    LUISA_WARNING_WITH_LOCATION(
+                        "More than one set of texture coordinates "
+                        "found in sub-mesh #{} of '{}'. Only the "
+                        "first set will be considered.",
+                        m, path_string);
+                }
+                if (mesh->mTextureCoords[0] == nullptr ||
+                    mesh->mNumUVComponents[0] != 2) [[unlikely]] {
+                    LUISA_WARNING_WITH_LOCATION(
+                        "Invalid texture coordinates in sub-mesh #{} of '{}': "
+                        "address = {}, components = {}.",
+                        m, path_string,
+                        fmt::ptr(mesh->mTextureCoords[0]),
+                        mesh->mNumUVComponents[0]);
+                }
+                has_uv = has_uv && mesh->mTextureCoords[0] != nullptr;
+                if (static_cast<uint64_t>(vertex_offsets[m]) + mesh->mNumVertices >
+                    std::numeric_limits<uint>::max()) [[unlikely]] {
+                    LUISA_ERROR_WITH_LOCATION(
+                        "Too many vertices in mesh '{}'.",
+                        path_string);
+                }
+                vertex_offsets[m + 1u] = vertex_offsets[m] + mesh->mNumVertices;
+                triangle_offsets[m + 1u] = triangle_offsets[m] + mesh->mNumFaces;
             }
             MeshLoader loader;
-            auto vertex_count = mesh->mNumVertices;
-            auto ai_positions = mesh->mVertices;
-            auto ai_normals = mesh->mNormals;
-            auto ai_tex_coords = mesh->mTextureCoords[0];
-            auto ai_tangents = mesh->mTangents;
-            loader._positions.resize(vertex_count);
-            loader._attributes.resize(vertex_count);
-            auto compute_tangent = [ai_tangents](auto i, float3 n) noexcept {
-                if (ai_tangents == nullptr) {
-                    auto b = abs(n.x) > abs(n.z) ?
-                                 make_float3(-n.y, n.x, 0.0f) :
-                                 make_float3(0.0f, -n.z, n.y);
-                    return normalize(cross(b, make_float3(n.x, n.y, n.z)));
-                }
-                return make_float3(ai_tangents[i].x, ai_tangents[i].y, ai_tangents[i].z);
-            };
-            loader._has_uv = ai_tex_coords != nullptr;
-            auto compute_uv = [ai_tex_coords](auto i) noexcept {
-                if (ai_tex_coords == nullptr) { return make_float2(); }
-                return make_float2(ai_tex_coords[i].x, ai_tex_coords[i].y);
+            loader._has_uv = has_uv;
+            loader._positions.resize(vertex_offsets.back());
+            loader._attributes.resize(vertex_offsets.back());
+            loader._triangles.resize(triangle_offsets.back());
+            // split the conversion into chunks that never straddle sub-meshes
+            struct Chunk {
+                uint mesh;
+                uint begin;
+                uint end;
+                bool is_vertex_chunk;
             };
-            for (auto i = 0; i < vertex_count; i++) {
-                auto n = make_float3(ai_normals[i].x, ai_normals[i].y, ai_normals[i].z);
-                auto t = compute_tangent(i, n);
-                auto uv = compute_uv(i);
-                loader._attributes[i] = Shape::VertexAttribute::encode(n, t, uv);
-                loader._positions[i] = make_float3(ai_positions[i].x, ai_positions[i].y, ai_positions[i].z);
+            static constexpr auto chunk_size = 64u * 1024u;
+            luisa::vector<Chunk> chunks;
+            for (auto m = 0u; m < meshes.size(); m++) {
+                for (auto i = 0u; i < meshes[m]->mNumVertices; i += chunk_size) {
+                    chunks.emplace_back(Chunk{m, i, std::min(i + chunk_size, meshes[m]->mNumVertices), true});
+                }
+                for (auto i = 0u; i < meshes[m]->mNumFaces; i += chunk_size) {
+                    chunks.emplace_back(Chunk{m, i, std::min(i + chunk_size, meshes[m]->mNumFaces), false});
+                }
             }
-            auto triangle_count = mesh->mNumFaces;
-            auto ai_triangles = mesh->mFaces;
-            loader._triangles.resize(triangle_count);
-            std::transform(
-                ai_triangles, ai_triangles + triangle_count,
-                loader._triangles.begin(),
-                [](const aiFace &face) noexcept {
-                    auto t = face.mIndices;
-                    return Triangle{t[0], t[1], t[2]};
-                });
+            parallel_for_with_caller(chunks.size(), [&](size_t chunk_index) noexcept {
+                auto chunk = chunks[chunk_index];
+                auto mesh = meshes[chunk.mesh];
+                auto vertex_offset = vertex_offsets[chunk.mesh];
+                if (!chunk.is_vertex_chunk) {
+                    auto triangle_offset = triangle_offsets[chunk.mesh];
+                    for (auto i = chunk.begin; i < chunk.end; i++) {
+                        auto t = mesh->mFaces[i].mIndices;
+                        loader._triangles[triangle_offset + i] = Triangle{
+                            t[0] + vertex_offset, t[1] + vertex_offset, t[2] + vertex_offset};
+                    }
+                    return;
+                }
+                auto ai_positions = mesh->mVertices;
+                auto ai_normals = mesh->mNormals;
+                auto ai_tex_coords = mesh->mTextureCoords[0];
+                auto ai_tangents = mesh->mTangents;
+                auto compute_tangent = [ai_tangents](auto i, float3 n) noexcept {
+                    if (ai_tangents == nullptr) {
+                        auto b = abs(n.x) > abs(n.z) ?
+                                     make_float3(-n.y, n.x, 0.0f) :
+                                     make_float3(0.0f, -n.z, n.y);
+                        return normalize(cross(b, make_float3(n.x, n.y, n.z)));
+                    }
+                    return make_float3(ai_tangents[i].x, ai_tangents[i].y, ai_tangents[i].z);
+                };
+                auto compute_uv = [ai_tex_coords](auto i) noexcept {
+                    if (ai_tex_coords == nullptr) { return make_float2(); }
+                    return make_float2(ai_tex_coords[i].x, ai_tex_coords[i].y);
+                };
+                for (auto i = chunk.begin; i < chunk.end; i++) {
+                    auto n = make_float3(ai_normals[i].x, ai_normals[i].y, ai_normals[i].z);
+                    auto t = compute_tangent(i, n);
+                    auto uv = compute_uv(i);
+                    loader._attributes[vertex_offset + i] = Shape::VertexAttribute::encode(n, t, uv);
+                    loader._positions[vertex_offset + i] = make_float3(ai_positions[i].x, ai_positions[i].y, ai_positions[i].z);
+                }
+            });
             LUISA_INFO(
-                "Loaded triangle mesh '{}' in {} ms.",
-                path_string, clock.toc());
+                "Loaded triangle mesh '{}' with {} sub-mesh(es), "
+                "{} vertices and {} triangles in {} ms "
+                "(import: {} ms, convert: {} ms).",
+                path_string, meshes.size(), loader._positions.size(),
+                loader._triangles.size(), clock.toc(),
+                import_time, clock.toc() - import_time);
+            // switch to the mapped cache once written so that the host copy
+            // is file-backed and can be paged out after the upload
+            if (cache_header && loader._save_cache(cache_path, *cache_header)) {
+                if (auto cached = _load_cache(cache_path, *cache_header)) {
+                    return std::move(*cached);
+                }
+            }
             return loader;
         });
     }
@@ -137,7 +331,8 @@ private:
 
 public:
     Mesh(Scene *scene, const SceneNodeDesc *desc) noexcept
-        : Shape{scene, desc}, _loader{MeshLoader::load(desc->property_path("file"))} {
+        : Shape{scene, desc}, _loader{MeshLoader::load(desc->property_path("file"),
+                                 desc->property_bool_or_default("cache", true))} {
         if (auto p = desc->property_path_or_default("alpha"); !p.empty()) {
             _alpha_image = ThreadPool::global().async([p = std::move(p)] {
                 return LoadedImage::load(p, LoadedImage::storage_type::BYTE1);
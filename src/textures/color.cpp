@@ -5,7 +5,9 @@
 #include <core/clock.h>
 #include <core/thread_pool.h>
 #include <util/imageio.h>
-#include <util/half.h>
+#include <util/image_cache.h>
+#include <util/mipmap.h>
+#include <util/texel_conversion.h>
 #include <base/texture.h>
 #include <base/pipeline.h>
 
@@ -17,10 +19,17 @@ class ColorTexture final : public ImageTexture {
 
 private:
     std::shared_future<LoadedImage> _img;
+    std::shared_future<MipmappedImage> _mipmapped_img;// instead of _img if _has_mip_levels()
     bool _is_black{};
 
 private:
-    [[nodiscard]] const LoadedImage &_image() const noexcept override { return _img.get(); }
+    [[nodiscard]] const LoadedImage &_image() const noexcept override {
+        return _mipmapped_img.valid() ? _mipmapped_img.get().image : _img.get();
+    }
+    [[nodiscard]] luisa::span<const LoadedImage> _mip_levels() const noexcept override {
+        if (!_mipmapped_img.valid()) { return {}; }
+        return _mipmapped_img.get().levels;
+    }
 
 public:
     ColorTexture(Scene *scene, const SceneNodeDesc *desc) noexcept
@@ -51,56 +60,72 @@ public:
             }));
         tint = max(tint, 0.0f);
         _is_black = all(tint == 0.0f);
-        _img = ThreadPool::global().async([path = std::move(path), half = !fp32, encoding = std::move(encoding),
-                                           gamma, tint, sloc = desc->source_location()] {
+        auto parameters = luisa::format(
+            "color:{}:{}:{},{},{}:{},{},{}", fp32 ? "fp32" : "fp16", encoding,
+            gamma.x, gamma.y, gamma.z, tint.x, tint.y, tint.z);
+        // converted texels are cached on disk, except for mip chains; rsp-encoded files are
+        // used as-is, and virtual textures are read back from their spilled pixels instead
+        auto persistent = encoding != "rsp" && !is_virtual() && !_has_mip_levels();
+        if (is_virtual()) { parameters.append(":virtual"); }
+        auto loader = [path, half = !fp32, encoding = std::move(encoding), gamma, tint,
+                       spill = is_virtual(), mipmapped = _has_mip_levels(), sloc = desc->source_location()] {
             auto image = LoadedImage::load(path, half ? PixelStorage::HALF4 : PixelStorage::FLOAT4);
-            if (encoding == "rsp") { return image; }
-            auto process = [&]() -> luisa::function<float3(float3)> {
-                auto rgb2spec = [tint](auto p) noexcept {
-                    auto rsp = RGB2SpectrumTable::srgb().decode_albedo(p * tint);
-                    return make_float3(rsp.x, rsp.y, rsp.z);
-                };
-                if (encoding == "linear") { return rgb2spec; }
-                if (encoding == "srgb") {
-                    return [rgb2spec](auto p) noexcept {
-                        auto s2l = [](auto x) noexcept {
-                            return x <= 0.04045f ?
-                                       x * (1.0f / 12.92f) :
-                                       std::pow((x + 0.055f) * (1.0f / 1.055f), 2.4f);
-                        };
-                        return rgb2spec(make_float3(s2l(p.x), s2l(p.y), s2l(p.z)));
-                    };
-                }
-                if (encoding == "gamma") {
-                    return [rgb2spec, g = gamma](auto p) noexcept {
-                        return rgb2spec(make_float3(
-                            pow(p.x, g.x), pow(p.y, g.y), pow(p.z, g.z)));
-                    };
+            luisa::vector<LoadedImage> levels;
+            if (encoding == "rsp") {
+                // already converted, so the levels can only be filtered as they are
+                if (mipmapped) { levels = generate_mipmaps(image); }
+                if (spill) { image = LoadedImage::spill(std::move(image), _spill_directory()); }
+                return MipmappedImage{std::move(image), std::move(levels)};
+            }
+            Clock clock;
+            auto rgb2spec = RGB2SpectrumTable::srgb();
+            auto to_rsp = [&rgb2spec](float3 linear, float alpha, size_t) noexcept {
+                return make_float4(rgb2spec.decode_albedo(linear), alpha);
+            };
+            auto convert = [&](const auto &decode) noexcept {
+                if (!mipmapped) {
+                    convert_texels(image, decode, [&to_rsp, tint](float3 linear, float alpha, size_t chunk) noexcept {
+                        return to_rsp(linear * tint, alpha, chunk);
+                    });
+                    return;
                 }
+                // spectrum coefficients do not average linearly, so the
+                // mip chain is filtered in linear RGB before the conversion
+                convert_texels(image, decode, [tint](float3 linear, float alpha, size_t) noexcept {
+                    return make_float4(linear * tint, alpha);
+                });
+                levels = generate_mipmaps(image);
+                convert_texels(image, LinearTexelDecoder{}, to_rsp);
+                for (auto &&level : levels) { convert_texels(level, LinearTexelDecoder{}, to_rsp); }
+            };
+            if (encoding == "linear") {
+                convert(LinearTexelDecoder{});
+            } else if (encoding == "srgb") {
+                convert(SRGBTexelDecoder{});
+            } else if (encoding == "gamma") {
+                convert(GammaTexelDecoder{gamma});
+            } else [[unlikely]] {
                 LUISA_ERROR(
                     "Unknown color texture encoding '{}'. [{}]",
                     encoding, sloc.string());
-            }();
-            if (half) {
-                auto pixels = reinterpret_cast<std::array<uint16_t, 4u> *>(image.pixels());
-                for (auto i = 0u; i < image.size().x * image.size().y; i++) {
-                    auto [x, y, z, _] = pixels[i];
-                    auto f = make_float3(half_to_float(x), half_to_float(y), half_to_float(z));
-                    auto rsp = process(f);
-                    pixels[i][0] = float_to_half(rsp.x);
-                    pixels[i][1] = float_to_half(rsp.y);
-                    pixels[i][2] = float_to_half(rsp.z);
-                }
-            } else {
-                auto pixels = reinterpret_cast<float4 *>(image.pixels());
-                for (auto i = 0u; i < image.size().x * image.size().y; i++) {
-                    auto p = pixels[i];
-                    auto rsp = process(p.xyz());
-                    pixels[i] = make_float4(rsp, p.w);
-                }
             }
-            return image;
-        });
+            LUISA_INFO(
+                "Converted {}x{} color texture '{}' with {} mip level(s) "
+                "to spectrum coefficients in {} ms.",
+                image.size().x, image.size().y, path.string(),
+                levels.size() + 1u, clock.toc());
+            if (spill) { image = LoadedImage::spill(std::move(image), _spill_directory()); }
+            return MipmappedImage{std::move(image), std::move(levels)};
+        };
+        if (_has_mip_levels()) {
+            parameters.append(":mipmapped");
+            _mipmapped_img = ImageCache::load<MipmappedImage>(path, parameters, std::move(loader));
+        } else {
+            auto load_image = [loader = std::move(loader)] { return loader().image; };
+            _img = persistent ?
+                       ImageCache::load_persistent(path, parameters, std::move(load_image)) :
+                       ImageCache::load<LoadedImage>(path, parameters, std::move(load_image));
+        }
     }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] Category category() const noexcept override { return Category::COLOR; }
@@ -11,6 +11,7 @@ class ConstantIlluminant final : public Texture {
 
 private:
     float4 _rsp_scale;
+    float _average_luminance;
 
 private:
     [[nodiscard]] TextureHandle _encode(Pipeline &pipeline, CommandBuffer &command_buffer, uint handle_tag) const noexcept override {
@@ -33,6 +34,9 @@ public:
         auto rsp_scale = RGB2SpectrumTable::srgb().decode_unbound(
             max(color, 0.0f) * max(scale, 0.0f));
         _rsp_scale = make_float4(rsp_scale.first, rsp_scale.second);
+        _average_luminance = dot(
+            make_float3(0.212671f, 0.715160f, 0.072169f),
+            max(color, 0.0f) * max(scale, 0.0f));
     }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] Float4 evaluate(
@@ -41,6 +45,7 @@ public:
         return make_float4(handle->v(), handle->alpha());
     }
     [[nodiscard]] bool is_black() const noexcept override { return _rsp_scale.w == 0.0f; }
+    [[nodiscard]] float average_luminance() const noexcept override { return _average_luminance; }
     [[nodiscard]] Category category() const noexcept override { return Category::ILLUMINANT; }
 };
 
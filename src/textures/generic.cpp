@@ -5,7 +5,9 @@
 #include <core/clock.h>
 #include <core/thread_pool.h>
 #include <util/imageio.h>
+#include <util/image_cache.h>
 #include <util/half.h>
+#include <util/mipmap.h>
 #include <base/texture.h>
 #include <base/pipeline.h>
 
@@ -16,16 +18,31 @@ using namespace luisa::compute;
 class GenericTexture final : public ImageTexture {
 
 private:
-    std::shared_future<LoadedImage> _img;
+    std::shared_future<MipmappedImage> _img;
 
 private:
-    [[nodiscard]] const LoadedImage &_image() const noexcept override { return _img.get(); }
+    [[nodiscard]] const LoadedImage &_image() const noexcept override { return _img.get().image; }
+    [[nodiscard]] luisa::span<const LoadedImage> _mip_levels() const noexcept override { return _img.get().levels; }
 
 public:
     GenericTexture(Scene *scene, const SceneNodeDesc *desc) noexcept
         : ImageTexture{scene, desc} {
         auto path = desc->property_path("file");
-        _img = ThreadPool::global().async([path = std::move(path), sloc = desc->source_location()] {
+        // texels are sampled as stored, but sRGB-encoded BYTE images
+        // are filtered in linear space when generating mip levels
+        auto encoding = desc->property_string_or_default("encoding", "linear");
+        for (auto &c : encoding) { c = static_cast<char>(tolower(c)); }
+        if (encoding != "linear" && encoding != "srgb") [[unlikely]] {
+            LUISA_ERROR(
+                "Unknown generic texture encoding '{}'. [{}]",
+                encoding, desc->source_location().string());
+        }
+        auto mip_encoding = encoding == "srgb" ? MipmapEncoding::SRGB : MipmapEncoding::LINEAR;
+        auto parameters = luisa::format("generic:{}", encoding);
+        if (_has_mip_levels()) { parameters.append(":mipmapped"); }
+        if (is_virtual()) { parameters.append(":virtual"); }
+        _img = ImageCache::load<MipmappedImage>(path, parameters, [path, spill = is_virtual(), mipmapped = _has_mip_levels(),
+                                                                   mip_encoding, sloc = desc->source_location()] {
             auto image = LoadedImage::load(path);
             if (auto s = image.pixel_storage();
                 s == PixelStorage::INT1 ||
@@ -37,7 +54,9 @@ public:
                     path.string(), pixel_storage_channel_count(s),
                     sloc.string());
             }
-            return image;
+            if (spill) { image = LoadedImage::spill(std::move(image), _spill_directory()); }
+            auto levels = mipmapped ? generate_mipmaps(image, mip_encoding) : luisa::vector<LoadedImage>{};
+            return MipmappedImage{std::move(image), std::move(levels)};
         });
     }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
@@ -5,7 +5,9 @@
 #include <core/clock.h>
 #include <core/thread_pool.h>
 #include <util/imageio.h>
-#include <util/half.h>
+#include <util/image_cache.h>
+#include <util/mipmap.h>
+#include <util/texel_conversion.h>
 #include <base/texture.h>
 #include <base/pipeline.h>
 
@@ -16,11 +18,12 @@ using namespace luisa::compute;
 class IlluminantTexture final : public ImageTexture {
 
 private:
-    std::shared_future<LoadedImage> _img;
+    std::shared_future<std::pair<MipmappedImage, float /* average luminance */>> _img;
     bool _is_black{};
 
 private:
-    [[nodiscard]] const LoadedImage &_image() const noexcept override { return _img.get(); }
+    [[nodiscard]] const LoadedImage &_image() const noexcept override { return _img.get().first.image; }
+    [[nodiscard]] luisa::span<const LoadedImage> _mip_levels() const noexcept override { return _img.get().first.levels; }
 
 public:
     IlluminantTexture(Scene *scene, const SceneNodeDesc *desc) noexcept
@@ -44,60 +47,82 @@ public:
             }));
         scale = clamp(scale, 0.0f, 1024.0f);
         _is_black = all(scale == 0.0f);
-        _img = ThreadPool::global().async([path = std::move(path), half = !fp32,
-                                           encoding = std::move(encoding), gamma,
-                                           sloc = desc->source_location(), scale] {
-            auto image = LoadedImage::load(path, half ? PixelStorage::HALF4 : PixelStorage::FLOAT4);
-            if (encoding == "rsp") { return image; }
-            auto process = [&]() -> luisa::function<float4(float3)> {
-                auto rgb2spec = [scale](auto p) noexcept {
-                    auto rsp_scale = RGB2SpectrumTable::srgb().decode_unbound(p * scale);
-                    return make_float4(rsp_scale.first, rsp_scale.second);
-                };
-                if (encoding == "linear") { return rgb2spec; }
-                if (encoding == "srgb") {
-                    return [rgb2spec](auto p) noexcept {
-                        auto s2l = [](auto x) noexcept {
-                            return x <= 0.04045f ?
-                                       x * (1.0f / 12.92f) :
-                                       std::pow((x + 0.055f) * (1.0f / 1.055f), 2.4f);
-                        };
-                        return rgb2spec(make_float3(s2l(p.x), s2l(p.y), s2l(p.z)));
-                    };
-                }
-                if (encoding == "gamma") {
-                    return [rgb2spec, gamma](auto p) noexcept {
-                        auto g = [gamma](auto x) noexcept { return std::pow(x, gamma); };
-                        return rgb2spec(make_float3(g(p.x), g(p.y), g(p.z)));
-                    };
-                }
-                LUISA_ERROR(
-                    "Unknown color texture encoding '{}'. [{}]",
-                    encoding, sloc.string());
-            }();
-            if (half) {
-                auto pixels = reinterpret_cast<std::array<uint16_t, 4u> *>(image.pixels());
-                for (auto i = 0u; i < image.size().x * image.size().y; i++) {
-                    auto [x, y, z, _] = pixels[i];
-                    auto f = make_float3(half_to_float(x), half_to_float(y), half_to_float(z));
-                    auto rsp = process(f);
-                    pixels[i][0] = float_to_half(rsp.x);
-                    pixels[i][1] = float_to_half(rsp.y);
-                    pixels[i][2] = float_to_half(rsp.z);
-                    pixels[i][3] = float_to_half(rsp.w);
+        auto parameters = luisa::format(
+            "illuminant:{}:{}:{}:{},{},{}", fp32 ? "fp32" : "fp16",
+            encoding, gamma, scale.x, scale.y, scale.z);
+        if (_has_mip_levels()) { parameters.append(":mipmapped"); }
+        if (is_virtual()) { parameters.append(":virtual"); }
+        _img = ImageCache::load<std::pair<MipmappedImage, float>>(
+            path, parameters, [path, half = !fp32, encoding = std::move(encoding), gamma, spill = is_virtual(),
+                               mipmapped = _has_mip_levels(), sloc = desc->source_location(), scale] {
+                auto image = LoadedImage::load(path, half ? PixelStorage::HALF4 : PixelStorage::FLOAT4);
+                auto pixel_count = image.size().x * image.size().y;
+                auto luminance_sum = 0.0;
+                luisa::vector<LoadedImage> levels;
+                if (encoding == "rsp") {
+                    // the rsp scale is twice the maximum channel, which
+                    // serves as a rough luminance estimate for importance
+                    if (half) {
+                        auto pixels = reinterpret_cast<const std::array<uint16_t, 4u> *>(image.pixels());
+                        for (auto i = 0u; i < pixel_count; i++) { luminance_sum += 0.5f * half_to_float(pixels[i][3]); }
+                    } else {
+                        auto pixels = reinterpret_cast<const float4 *>(image.pixels());
+                        for (auto i = 0u; i < pixel_count; i++) { luminance_sum += 0.5f * pixels[i].w; }
+                    }
+                    // already converted, so the levels can only be filtered as they are
+                    if (mipmapped) { levels = generate_mipmaps(image); }
+                    if (spill) { image = LoadedImage::spill(std::move(image), _spill_directory()); }
+                    return std::make_pair(MipmappedImage{std::move(image), std::move(levels)},
+                                          static_cast<float>(luminance_sum / pixel_count));
                 }
-            } else {
-                auto pixels = reinterpret_cast<float4 *>(image.pixels());
-                for (auto i = 0u; i < image.size().x * image.size().y; i++) {
-                    pixels[i] = process(pixels[i].xyz());
+                Clock clock;
+                // luminance is summed per chunk of rows to keep the conversion deterministic
+                luisa::vector<double> chunk_luminance_sums(texel_conversion_chunk_count(image), 0.0);
+                auto rgb2spec = RGB2SpectrumTable::srgb();
+                auto to_rsp = [&rgb2spec](float3 linear, float, size_t) noexcept {
+                    auto [rsp, rsp_scale] = rgb2spec.decode_unbound(linear);
+                    return make_float4(rsp, rsp_scale);
+                };
+                auto convert = [&](const auto &decode) noexcept {
+                    convert_texels(image, decode, [&](float3 p, float alpha, size_t chunk) noexcept {
+                        auto linear = p * scale;
+                        chunk_luminance_sums[chunk] += dot(make_float3(0.212671f, 0.715160f, 0.072169f), max(linear, 0.0f));
+                        // spectrum coefficients do not average linearly, so the
+                        // mip chain is filtered in linear RGB before the conversion
+                        return mipmapped ? make_float4(linear, alpha) : to_rsp(linear, alpha, chunk);
+                    });
+                    if (mipmapped) {
+                        levels = generate_mipmaps(image);
+                        convert_texels(image, LinearTexelDecoder{}, to_rsp);
+                        for (auto &&level : levels) { convert_texels(level, LinearTexelDecoder{}, to_rsp); }
+                    }
+                };
+                if (encoding == "linear") {
+                    convert(LinearTexelDecoder{});
+                } else if (encoding == "srgb") {
+                    convert(SRGBTexelDecoder{});
+                } else if (encoding == "gamma") {
+                    convert(GammaTexelDecoder{make_float3(gamma)});
+                } else [[unlikely]] {
+                    LUISA_ERROR(
+                        "Unknown color texture encoding '{}'. [{}]",
+                        encoding, sloc.string());
                 }
-            }
-            return image;
-        });
+                for (auto sum : chunk_luminance_sums) { luminance_sum += sum; }
+                LUISA_INFO(
+                    "Converted {}x{} illuminant texture '{}' with {} mip level(s) "
+                    "to spectrum coefficients in {} ms.",
+                    image.size().x, image.size().y, path.string(),
+                    levels.size() + 1u, clock.toc());
+                if (spill) { image = LoadedImage::spill(std::move(image), _spill_directory()); }
+                return std::make_pair(MipmappedImage{std::move(image), std::move(levels)},
+                                      static_cast<float>(luminance_sum / pixel_count));
+            });
     }
     [[nodiscard]] luisa::string_view impl_type() const noexcept override { return LUISA_RENDER_PLUGIN_NAME; }
     [[nodiscard]] Category category() const noexcept override { return Category::ILLUMINANT; }
     [[nodiscard]] bool is_black() const noexcept override { return _is_black; }
+    [[nodiscard]] float average_luminance() const noexcept override { return _img.get().second; }
 };
 
 }// namespace luisa::render
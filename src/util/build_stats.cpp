@@ -0,0 +1,153 @@
+#include <array>
+#include <algorithm>
+
+#include <core/logging.h>
+#include <util/build_stats.h>
+
+namespace luisa::render {
+
+namespace detail {
+
+[[nodiscard]] static auto format_bytes(size_t bytes) noexcept {
+    constexpr std::array units{"B", "KiB", "MiB", "GiB", "TiB"};
+    auto size = static_cast<double>(bytes);
+    auto unit = 0u;
+    while (size >= 1024.0 && unit + 1u < units.size()) {
+        size /= 1024.0;
+        unit++;
+    }
+    return luisa::format("{:.2f} {}", size, units[unit]);
+}
+
+[[nodiscard]] static auto format_time(double ms) noexcept {
+    return ms < 0.0 ? luisa::string{"-"} : luisa::format("{:.2f} ms", ms);
+}
+
+[[nodiscard]] static auto json_escape(luisa::string_view s) noexcept {
+    luisa::string escaped;
+    escaped.reserve(s.size() + 2u);
+    for (auto c : s) {
+        switch (c) {
+            case '"': escaped.append("\\\""); break;
+            case '\\': escaped.append("\\\\"); break;
+            case '\n': escaped.append("\\n"); break;
+            case '\r': escaped.append("\\r"); break;
+            case '\t': escaped.append("\\t"); break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20u) {
+                    escaped.append(luisa::format("\\u{:04x}", static_cast<uint>(c)));
+                } else {
+                    escaped.push_back(c);
+                }
+                break;
+        }
+    }
+    return escaped;
+}
+
+[[nodiscard]] static auto json_time(double ms) noexcept {
+    return ms < 0.0 ? luisa::string{"null"} : luisa::format("{}", ms);
+}
+
+[[nodiscard]] static auto mesh_bytes(const MeshBuildStats &m) noexcept {
+    return m.position_bytes + m.attribute_bytes + m.triangle_bytes + m.general_bytes;
+}
+
+}// namespace detail
+
+size_t BuildStats::dedup_hits() const noexcept {
+    auto hits = static_cast<size_t>(0u);
+    for (auto &&m : _meshes) { hits += m.shape_count - std::min(m.shape_count, 1u); }
+    return hits;
+}
+
+size_t BuildStats::total_bytes() const noexcept {
+    auto bytes = static_cast<size_t>(0u);
+    for (auto &&m : _meshes) { bytes += detail::mesh_bytes(m); }
+    return bytes;
+}
+
+luisa::string BuildStats::table() const noexcept {
+    // largest first, which is what one looks for when running out of memory
+    luisa::vector<const MeshBuildStats *> sorted;
+    sorted.reserve(_meshes.size());
+    for (auto &&m : _meshes) { sorted.emplace_back(&m); }
+    std::stable_sort(sorted.begin(), sorted.end(), [](auto lhs, auto rhs) noexcept {
+        return detail::mesh_bytes(*lhs) > detail::mesh_bytes(*rhs);
+    });
+    auto name_width = static_cast<size_t>(4u);
+    for (auto m : sorted) { name_width = std::max(name_width, m->name.size()); }
+    luisa::string s;
+    s.append(luisa::format(
+        "{:<{}}  {:>12}  {:>12}  {:>12}  {:>12}  {:>12}  {:>12}  {:>12}  {:>6}  {:>9}\n",
+        "Mesh", name_width, "Vertices", "Triangles", "Positions", "Attributes",
+        "Triangles", "General", "BLAS Build", "Shapes", "Instances"));
+    size_t vertices{}, triangles{}, position_bytes{}, attribute_bytes{}, triangle_bytes{}, general_bytes{};
+    auto blas_time = 0.0;
+    for (auto m : sorted) {
+        s.append(luisa::format(
+            "{:<{}}  {:>12}  {:>12}  {:>12}  {:>12}  {:>12}  {:>12}  {:>12}  {:>6}  {:>9}\n",
+            m->name, name_width, m->vertex_count, m->triangle_count,
+            detail::format_bytes(m->position_bytes),
+            detail::format_bytes(m->attribute_bytes),
+            detail::format_bytes(m->triangle_bytes),
+            detail::format_bytes(m->general_bytes),
+            detail::format_time(m->blas_build_time),
+            m->shape_count, m->instance_count));
+        vertices += m->vertex_count;
+        triangles += m->triangle_count;
+        position_bytes += m->position_bytes;
+        attribute_bytes += m->attribute_bytes;
+        triangle_bytes += m->triangle_bytes;
+        general_bytes += m->general_bytes;
+        blas_time += std::max(m->blas_build_time, 0.0);
+    }
+    auto timed = std::any_of(_meshes.cbegin(), _meshes.cend(), [](auto &&m) noexcept {
+        return m.blas_build_time >= 0.0;
+    });
+    s.append(luisa::format(
+        "{:<{}}  {:>12}  {:>12}  {:>12}  {:>12}  {:>12}  {:>12}  {:>12}  {:>6}  {:>9}\n",
+        "Total", name_width, vertices, triangles,
+        detail::format_bytes(position_bytes),
+        detail::format_bytes(attribute_bytes),
+        detail::format_bytes(triangle_bytes),
+        detail::format_bytes(general_bytes),
+        detail::format_time(timed ? blas_time : -1.0),
+        _meshes.size() + dedup_hits(), _instance_count));
+    s.append(luisa::format(
+        "Unique geometries: {}, dedup hits: {}, geometry memory: {}\n",
+        _meshes.size(), dedup_hits(),
+        detail::format_bytes(total_bytes())));
+    s.append(luisa::format(
+        "Bindless slots: {} buffer(s), {} tex2d, {} tex3d (capacity {} each, {:.2f}% of buffer slots used)",
+        _bindless_buffers, _bindless_tex2d, _bindless_tex3d, _bindless_capacity,
+        _bindless_capacity == 0u ? 0.0 : 100.0 * static_cast<double>(_bindless_buffers) / static_cast<double>(_bindless_capacity)));
+    return s;
+}
+
+luisa::string BuildStats::json() const noexcept {
+    luisa::string s;
+    s.append("{\n  \"meshes\": [");
+    for (auto i = 0u; i < _meshes.size(); i++) {
+        auto &&m = _meshes[i];
+        s.append(i == 0u ? "\n" : ",\n");
+        s.append(luisa::format(
+            R"(    {{"name": "{}", "vertices": {}, "triangles": {}, )"
+            R"("position_bytes": {}, "attribute_bytes": {}, "triangle_bytes": {}, "general_bytes": {}, )"
+            R"("blas_build_time_ms": {}, "shapes": {}, "instances": {}}})",
+            detail::json_escape(m.name), m.vertex_count, m.triangle_count,
+            m.position_bytes, m.attribute_bytes, m.triangle_bytes, m.general_bytes,
+            detail::json_time(m.blas_build_time), m.shape_count, m.instance_count));
+    }
+    s.append(_meshes.empty() ? "],\n" : "\n  ],\n");
+    s.append(luisa::format(
+        "  \"totals\": {{\"unique_geometries\": {}, \"dedup_hits\": {}, \"instances\": {}, "
+        "\"geometry_bytes\": {}}},\n",
+        _meshes.size(), dedup_hits(), _instance_count, total_bytes()));
+    s.append(luisa::format(
+        "  \"bindless\": {{\"buffers\": {}, \"tex2d\": {}, \"tex3d\": {}, \"capacity\": {}}}\n}}\n",
+        _bindless_buffers, _bindless_tex2d, _bindless_tex3d, _bindless_capacity));
+    return s;
+}
+
+}// namespace luisa::render
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <core/stl.h>
+#include <core/basic_types.h>
+
+namespace luisa::render {
+
+// Per-geometry record; shapes whose mesh data hash to the same geometry
+// share one record (see Pipeline::_mesh_cache).
+struct MeshBuildStats {
+    luisa::string name;// identifier of the first shape that created the geometry
+    size_t vertex_count{};
+    size_t triangle_count{};
+    size_t position_bytes{};  // from the position buffer arena
+    size_t attribute_bytes{}; // from the attribute buffer arena
+    size_t triangle_bytes{};  // dedicated triangle buffer
+    size_t general_bytes{};   // from the general buffer arena (alias table, pdf)
+    double blas_build_time{-1.};// in milliseconds, negative if not measured
+    uint shape_count{};       // shapes referencing the geometry, i.e., 1 + dedup hits
+    uint instance_count{};    // instances in the top-level accel
+};
+
+class BuildStats {
+
+private:
+    luisa::vector<MeshBuildStats> _meshes;
+    size_t _bindless_buffers{};
+    size_t _bindless_tex2d{};
+    size_t _bindless_tex3d{};
+    size_t _bindless_capacity{};
+    size_t _instance_count{};
+
+public:
+    [[nodiscard]] auto &add_mesh() noexcept { return _meshes.emplace_back(); }
+    [[nodiscard]] auto &mesh(size_t i) noexcept { return _meshes[i]; }
+    [[nodiscard]] auto meshes() const noexcept { return luisa::span{_meshes}; }
+    void set_bindless_usage(size_t buffers, size_t tex2d, size_t tex3d, size_t capacity) noexcept {
+        _bindless_buffers = buffers;
+        _bindless_tex2d = tex2d;
+        _bindless_tex3d = tex3d;
+        _bindless_capacity = capacity;
+    }
+    void set_instance_count(size_t n) noexcept { _instance_count = n; }
+    [[nodiscard]] size_t dedup_hits() const noexcept;
+    [[nodiscard]] size_t total_bytes() const noexcept;
+    [[nodiscard]] luisa::string table() const noexcept;
+    [[nodiscard]] luisa::string json() const noexcept;
+};
+
+}// namespace luisa::render
@@ -0,0 +1,335 @@
+#include <array>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+
+#include <miniz.h>
+
+#include <core/logging.h>
+#include <core/mathematics.h>
+#include <util/half.h>
+#include <util/parallel.h>
+#include <util/exr_writer.h>
+
+namespace luisa::render {
+
+namespace detail {
+
+class EXRHeaderBuilder {
+
+private:
+    luisa::vector<std::byte> _bytes;
+
+public:
+    template<typename T>
+    void put(T value) noexcept {
+        auto p = reinterpret_cast<const std::byte *>(&value);
+        _bytes.insert(_bytes.end(), p, p + sizeof(T));
+    }
+    void put(luisa::string_view s) noexcept {
+        auto p = reinterpret_cast<const std::byte *>(s.data());
+        _bytes.insert(_bytes.end(), p, p + s.size());
+        _bytes.emplace_back(std::byte{0});
+    }
+    void attribute(luisa::string_view name, luisa::string_view type, uint size) noexcept {
+        put(name);
+        put(type);
+        put(size);
+    }
+    [[nodiscard]] auto &bytes() const noexcept { return _bytes; }
+};
+
+// channels are stored in alphabetical order of their names; returns for
+// each stored channel the index of its samples in the interleaved pixels
+[[nodiscard]] luisa::vector<uint> exr_channel_order(luisa::span<const luisa::string> channels) noexcept {
+    luisa::vector<uint> order(channels.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [channels](auto lhs, auto rhs) noexcept {
+        return channels[lhs] < channels[rhs];
+    });
+    return order;
+}
+
+// magic number, version and the required attributes; tiled images
+// additionally set the single-part tiled flag and describe their tiles
+[[nodiscard]] EXRHeaderBuilder exr_header(uint2 resolution, bool fp16, uint8_t compression,
+                                          luisa::span<const luisa::string> channels,
+                                          luisa::span<const uint> channel_order,
+                                          luisa::optional<uint2> tile_size) noexcept {
+    EXRHeaderBuilder header;
+    header.put(20000630);
+    header.put(tile_size ? 2 | 0x200 : 2);
+
+    constexpr auto half_pixel_type = 1;
+    constexpr auto float_pixel_type = 2;
+    auto channel_list_size = 1u;
+    for (auto &&c : channels) { channel_list_size += static_cast<uint>(c.size()) + 1u + 16u; }
+    header.attribute("channels", "chlist", channel_list_size);
+    for (auto i : channel_order) {
+        header.put(luisa::string_view{channels[i]});
+        header.put(fp16 ? half_pixel_type : float_pixel_type);
+        header.put(0u);// pLinear and reserved
+        header.put(1);// x sampling
+        header.put(1);// y sampling
+    }
+    header.put(std::byte{0});
+    header.attribute("compression", "compression", 1u);
+    header.put(compression);
+    auto max_x = static_cast<int>(resolution.x) - 1;
+    auto max_y = static_cast<int>(resolution.y) - 1;
+    for (auto window : {"dataWindow", "displayWindow"}) {
+        header.attribute(window, "box2i", 16u);
+        header.put(0);
+        header.put(0);
+        header.put(max_x);
+        header.put(max_y);
+    }
+    header.attribute("lineOrder", "lineOrder", 1u);
+    header.put(std::byte{0});// INCREASING_Y
+    header.attribute("pixelAspectRatio", "float", 4u);
+    header.put(1.0f);
+    header.attribute("screenWindowCenter", "v2f", 8u);
+    header.put(0.0f);
+    header.put(0.0f);
+    header.attribute("screenWindowWidth", "float", 4u);
+    header.put(1.0f);
+    if (tile_size) {
+        header.attribute("tiles", "tiledesc", 9u);
+        header.put(tile_size->x);
+        header.put(tile_size->y);
+        header.put(std::byte{0});// ONE_LEVEL, ROUND_DOWN
+    }
+    header.put(std::byte{0});// end of header
+    return header;
+}
+
+// per scanline, the samples of all its pixels for each stored channel in turn
+void encode_exr_scanlines(const float *pixels, luisa::span<const uint> channel_order,
+                          uint width, uint rows, bool fp16, std::byte *data) noexcept {
+    auto sample_size = fp16 ? sizeof(uint16_t) : sizeof(float);
+    auto channel_count = static_cast<uint>(channel_order.size());
+    for (auto y = 0u; y < rows; y++) {
+        for (auto channel : channel_order) {
+            for (auto x = 0u; x < width; x++) {
+                auto v = pixels[(y * width + x) * channel_count + channel];
+                if (fp16) {
+                    auto h = static_cast<uint16_t>(float_to_half(v));
+                    std::memcpy(data, &h, sizeof(h));
+                } else {
+                    std::memcpy(data, &v, sizeof(v));
+                }
+                data += sample_size;
+            }
+        }
+    }
+}
+
+// ZIP compression as specified by OpenEXR: bytes are split into even and
+// odd halves, delta-encoded, and deflated; blocks that do not shrink are
+// stored uncompressed, which readers detect from the block size
+void compress_exr_block(luisa::span<const std::byte> raw, luisa::vector<std::byte> &scratch,
+                        luisa::vector<std::byte> &compressed) noexcept {
+    auto size = raw.size();
+    scratch.resize(size);
+    auto t1 = scratch.data();
+    auto t2 = scratch.data() + (size + 1u) / 2u;
+    for (auto i = 0u; i < size; i++) {
+        if (i % 2u == 0u) {
+            *(t1++) = raw[i];
+        } else {
+            *(t2++) = raw[i];
+        }
+    }
+    auto t = reinterpret_cast<uint8_t *>(scratch.data());
+    auto p = static_cast<int>(t[0]);
+    for (auto i = 1u; i < size; i++) {
+        auto d = static_cast<int>(t[i]) - p + (128 + 256);
+        p = t[i];
+        t[i] = static_cast<uint8_t>(d);
+    }
+    auto compressed_size = mz_compressBound(static_cast<mz_ulong>(size));
+    compressed.resize(compressed_size);
+    if (mz_compress(reinterpret_cast<uint8_t *>(compressed.data()), &compressed_size,
+                    reinterpret_cast<const uint8_t *>(scratch.data()),
+                    static_cast<mz_ulong>(size)) != MZ_OK ||
+        compressed_size >= size) {
+        compressed.resize(size);
+        std::memcpy(compressed.data(), raw.data(), size);
+    } else {
+        compressed.resize(compressed_size);
+    }
+}
+
+}// namespace detail
+
+bool write_exr(const std::filesystem::path &path, uint2 resolution, bool fp16,
+               luisa::span<const luisa::string> channels,
+               const luisa::function<void(uint row, float *pixels)> &scanline) noexcept {
+    constexpr auto zip_compression = static_cast<uint8_t>(3u);
+    constexpr auto rows_per_block = 16u;
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    if (!file) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Failed to create image '{}'.",
+            path.string());
+        return false;
+    }
+    auto channel_count = static_cast<uint>(channels.size());
+    auto channel_order = detail::exr_channel_order(channels);
+    auto header = detail::exr_header(resolution, fp16, zip_compression,
+                                     channels, channel_order, luisa::nullopt);
+    file.write(reinterpret_cast<const char *>(header.bytes().data()),
+               static_cast<std::streamsize>(header.bytes().size()));
+    auto block_count = (resolution.y + rows_per_block - 1u) / rows_per_block;
+    luisa::vector<uint64_t> offsets(block_count);
+    auto offset_table_position = file.tellp();
+    file.write(reinterpret_cast<const char *>(offsets.data()),
+               static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+
+    // blocks are encoded in batches to bound the memory held by compressed
+    // blocks waiting to be written in order
+    struct Block {
+        luisa::vector<float> pixels;
+        luisa::vector<std::byte> raw;
+        luisa::vector<std::byte> scratch;
+        luisa::vector<std::byte> compressed;
+    };
+    auto sample_size = fp16 ? sizeof(uint16_t) : sizeof(float);
+    auto batch_size = std::max(std::thread::hardware_concurrency(), 1u) * 4u;
+    luisa::vector<Block> blocks(std::min(batch_size, block_count));
+    for (auto batch_begin = 0u; batch_begin < block_count; batch_begin += batch_size) {
+        auto batch_end = std::min(batch_begin + batch_size, block_count);
+        parallel_for_with_caller(batch_end - batch_begin, [&](size_t i) noexcept {
+            auto &block = blocks[i];
+            auto first_row = static_cast<uint>(batch_begin + i) * rows_per_block;
+            auto rows = std::min(rows_per_block, resolution.y - first_row);
+            block.pixels.resize(resolution.x * rows * channel_count);
+            for (auto y = 0u; y < rows; y++) {
+                scanline(first_row + y, block.pixels.data() + y * resolution.x * channel_count);
+            }
+            block.raw.resize(resolution.x * rows * channel_count * sample_size);
+            detail::encode_exr_scanlines(block.pixels.data(), channel_order,
+                                         resolution.x, rows, fp16, block.raw.data());
+            detail::compress_exr_block(
+                luisa::span<const std::byte>{block.raw.data(), block.raw.size()},
+                block.scratch, block.compressed);
+        });
+        for (auto i = batch_begin; i < batch_end; i++) {
+            auto &block = blocks[i - batch_begin];
+            offsets[i] = static_cast<uint64_t>(file.tellp());
+            std::array<int, 2u> block_header{
+                static_cast<int>(i * rows_per_block),
+                static_cast<int>(block.compressed.size())};
+            file.write(reinterpret_cast<const char *>(block_header.data()), sizeof(block_header));
+            file.write(reinterpret_cast<const char *>(block.compressed.data()),
+                       static_cast<std::streamsize>(block.compressed.size()));
+        }
+    }
+    file.seekp(offset_table_position);
+    file.write(reinterpret_cast<const char *>(offsets.data()),
+               static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+    file.close();
+    if (!file) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Failed to write image '{}'.",
+            path.string());
+        return false;
+    }
+    return true;
+}
+
+TiledEXRWriter::TiledEXRWriter(std::filesystem::path path, std::ofstream file,
+                               uint2 resolution, uint2 tile_size, bool fp16,
+                               luisa::span<const luisa::string> channels) noexcept
+    : _path{std::move(path)}, _file{std::move(file)},
+      _resolution{resolution}, _tile_size{tile_size},
+      _tile_count{(resolution + tile_size - 1u) / tile_size},
+      _fp16{fp16}, _channel_count{static_cast<uint>(channels.size())},
+      _channel_order{detail::exr_channel_order(channels)},
+      _offsets(_tile_count.x * _tile_count.y, 0u) {
+    constexpr auto no_compression = static_cast<uint8_t>(0u);
+    auto header = detail::exr_header(resolution, fp16, no_compression,
+                                     channels, _channel_order, tile_size);
+    _file.write(reinterpret_cast<const char *>(header.bytes().data()),
+                static_cast<std::streamsize>(header.bytes().size()));
+    _offset_table_position = header.bytes().size();
+    _file.write(reinterpret_cast<const char *>(_offsets.data()),
+                static_cast<std::streamsize>(_offsets.size() * sizeof(uint64_t)));
+}
+
+TiledEXRWriter::~TiledEXRWriter() noexcept {
+    if (_file.is_open()) { static_cast<void>(close()); }
+}
+
+luisa::unique_ptr<TiledEXRWriter> TiledEXRWriter::open(
+    const std::filesystem::path &path, uint2 resolution,
+    uint2 tile_size, bool fp16,
+    luisa::span<const luisa::string> channels) noexcept {
+    if (resolution.x == 0u || resolution.y == 0u ||
+        tile_size.x == 0u || tile_size.y == 0u) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Invalid resolution {}x{} or tile size {}x{} for tiled image '{}'.",
+            resolution.x, resolution.y, tile_size.x, tile_size.y, path.string());
+        return nullptr;
+    }
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    if (!file) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Failed to create tiled image '{}'.",
+            path.string());
+        return nullptr;
+    }
+    return luisa::make_unique<TiledEXRWriter>(
+        path, std::move(file), resolution, tile_size, fp16, channels);
+}
+
+uint2 TiledEXRWriter::tile_extent(uint2 tile) const noexcept {
+    return min(_tile_size, _resolution - tile * _tile_size);
+}
+
+void TiledEXRWriter::write(uint2 tile, const float *pixels) noexcept {
+    if (tile.x >= _tile_count.x || tile.y >= _tile_count.y) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Tile ({}, {}) is out of range for image '{}'.",
+            tile.x, tile.y, _path.string());
+        return;
+    }
+    // block: tile coordinates, level (always 0), data size, and pixel data
+    auto extent = tile_extent(tile);
+    auto sample_size = _fp16 ? sizeof(uint16_t) : sizeof(float);
+    auto data_size = static_cast<size_t>(extent.x) * extent.y * _channel_count * sample_size;
+    _block.resize(5u * sizeof(int) + data_size);
+    auto header = reinterpret_cast<int *>(_block.data());
+    header[0] = static_cast<int>(tile.x);
+    header[1] = static_cast<int>(tile.y);
+    header[2] = 0;
+    header[3] = 0;
+    header[4] = static_cast<int>(data_size);
+    detail::encode_exr_scanlines(pixels, _channel_order, extent.x, extent.y,
+                                 _fp16, _block.data() + 5u * sizeof(int));
+    _offsets[tile.y * _tile_count.x + tile.x] = static_cast<uint64_t>(_file.tellp());
+    _file.write(reinterpret_cast<const char *>(_block.data()),
+                static_cast<std::streamsize>(_block.size()));
+}
+
+bool TiledEXRWriter::close() noexcept {
+    if (!_file.is_open()) { return false; }
+    if (auto missing = std::count(_offsets.cbegin(), _offsets.cend(), 0u); missing != 0) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "{} tile(s) of image '{}' were not written.",
+            missing, _path.string());
+    }
+    _file.seekp(static_cast<std::streamoff>(_offset_table_position));
+    _file.write(reinterpret_cast<const char *>(_offsets.data()),
+                static_cast<std::streamsize>(_offsets.size() * sizeof(uint64_t)));
+    _file.close();
+    if (!_file) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Failed to write tiled image '{}'.",
+            _path.string());
+        return false;
+    }
+    return true;
+}
+
+}// namespace luisa::render
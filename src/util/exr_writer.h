@@ -0,0 +1,72 @@
+#pragma once
+
+#include <fstream>
+#include <filesystem>
+
+#include <core/stl.h>
+#include <core/basic_types.h>
+
+namespace luisa::render {
+
+// Both writers take the channel names (e.g., "R", "G", "B", and layered ones
+// like "heatmap.rays") in the order in which the pixel data interleaves them;
+// they are sorted as required by OpenEXR when written.
+
+// Writes an OpenEXR scanline image with ZIP compression. Blocks of 16
+// scanlines are filled by `scanline` (given the row index and an output of
+// resolution.x pixels with one float per channel), converted and compressed
+// in parallel on the global thread pool, and streamed to disk in order. Safe
+// to be called from inside a thread pool task. Returns false (with a warning)
+// on failure.
+[[nodiscard]] bool write_exr(
+    const std::filesystem::path &path, uint2 resolution, bool fp16,
+    luisa::span<const luisa::string> channels,
+    const luisa::function<void(uint row, float *pixels)> &scanline) noexcept;
+
+// Streams an uncompressed, single-level tiled OpenEXR image to disk tile by
+// tile, so that only one tile has to be held in memory at a time. The offset
+// table is reserved up front and filled in by close(). tinyexr can only
+// encode whole images, hence this minimal writer.
+class TiledEXRWriter {
+
+private:
+    std::filesystem::path _path;
+    std::ofstream _file;
+    uint2 _resolution;
+    uint2 _tile_size;
+    uint2 _tile_count;
+    bool _fp16;
+    uint _channel_count;
+    luisa::vector<uint> _channel_order;// pixel data index of each sorted channel
+    size_t _offset_table_position{};
+    luisa::vector<uint64_t> _offsets;
+    luisa::vector<std::byte> _block;
+
+public:
+    // for internal use only; use TiledEXRWriter::open() instead
+    TiledEXRWriter(std::filesystem::path path, std::ofstream file,
+                   uint2 resolution, uint2 tile_size, bool fp16,
+                   luisa::span<const luisa::string> channels) noexcept;
+    ~TiledEXRWriter() noexcept;
+    TiledEXRWriter(TiledEXRWriter &&) noexcept = delete;
+    TiledEXRWriter(const TiledEXRWriter &) noexcept = delete;
+    TiledEXRWriter &operator=(TiledEXRWriter &&) noexcept = delete;
+    TiledEXRWriter &operator=(const TiledEXRWriter &) noexcept = delete;
+    // returns nullptr (with a warning) if the file cannot be created
+    [[nodiscard]] static luisa::unique_ptr<TiledEXRWriter> open(
+        const std::filesystem::path &path, uint2 resolution,
+        uint2 tile_size, bool fp16,
+        luisa::span<const luisa::string> channels) noexcept;
+    [[nodiscard]] auto resolution() const noexcept { return _resolution; }
+    [[nodiscard]] auto tile_size() const noexcept { return _tile_size; }
+    [[nodiscard]] auto tile_count() const noexcept { return _tile_count; }
+    // extent of the tile, smaller than tile_size() for tiles on the border
+    [[nodiscard]] uint2 tile_extent(uint2 tile) const noexcept;
+    // `pixels` holds tile_extent(tile) pixels with one float per channel in
+    // row-major order; tiles may be written in any order, but each exactly once
+    void write(uint2 tile, const float *pixels) noexcept;
+    // completes the offset table; returns false (with a warning) on failure
+    bool close() noexcept;
+};
+
+}// namespace luisa::render
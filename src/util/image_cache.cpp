@@ -0,0 +1,267 @@
+#include <mutex>
+#include <random>
+#include <fstream>
+#include <algorithm>
+
+#include <core/hash.h>
+#include <core/clock.h>
+#include <core/logging.h>
+#include <util/mapped_file.h>
+#include <util/image_cache.h>
+
+namespace luisa::render {
+
+namespace detail {
+
+struct ImageCacheState {
+    std::mutex mutex;
+    luisa::unordered_map<uint64_t, luisa::shared_ptr<void>> by_file;
+    luisa::unordered_map<uint64_t, luisa::shared_ptr<void>> by_content;
+    // keyed by file size and parameters; lists the files whose content has
+    // not been hashed, as no other file of the same size has shown up yet
+    luisa::unordered_map<uint64_t, luisa::vector<std::pair<std::filesystem::path, luisa::shared_ptr<void>>>> by_size;
+    std::filesystem::path disk_directory;
+    size_t disk_capacity{0u};
+    std::mutex eviction_mutex;
+};
+
+[[nodiscard]] static auto &image_cache_state() noexcept {
+    static ImageCacheState state;
+    return state;
+}
+
+[[nodiscard]] static auto image_cache_hash(const void *data, size_t size, uint64_t seed) noexcept {
+    return luisa::detail::xxh3_hash64(data, size, seed);
+}
+
+// unreadable files are not hashed and left to the loader to report
+[[nodiscard]] static auto image_content_hash(const std::filesystem::path &path, uint64_t parameter_hash) noexcept {
+    auto content_key = luisa::optional<uint64_t>{};
+    if (auto file = MappedFile::open(path)) {
+        content_key = image_cache_hash(file->data(), file->size(), parameter_hash);
+    }
+    return content_key;
+}
+
+// raw pixels preceded by this header; bump the version whenever the
+// conversions of the loaders change, so that stale entries are ignored
+struct CachedImageHeader {
+    static constexpr auto current_magic = 0x314547414d49524cull;// "LRIMAGE1"
+    static constexpr auto current_version = 1u;
+    uint64_t magic;
+    uint32_t version;
+    uint32_t storage;
+    uint32_t width;
+    uint32_t height;
+    uint64_t key;
+};
+
+[[nodiscard]] static LoadedImage read_cached_image(const std::filesystem::path &path, uint64_t key) noexcept {
+    std::ifstream file{path, std::ios::binary};
+    if (!file) { return {}; }
+    CachedImageHeader header{};
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        header.magic != CachedImageHeader::current_magic ||
+        header.version != CachedImageHeader::current_version ||
+        header.key != key || header.width == 0u || header.height == 0u) [[unlikely]] {
+        return {};
+    }
+    auto image = LoadedImage::create(
+        make_uint2(header.width, header.height),
+        static_cast<LoadedImage::storage_type>(header.storage));
+    if (!file.read(static_cast<char *>(image.pixels()), static_cast<std::streamsize>(image.size_bytes()))) [[unlikely]] {
+        return {};
+    }
+    // refresh the entry, which is then evicted last (see evict_cached_images())
+    std::error_code ec;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+    return image;
+}
+
+static void write_cached_image(const std::filesystem::path &path, uint64_t key, const LoadedImage &image) noexcept {
+    if (!image) { return; }
+    CachedImageHeader header{
+        .magic = CachedImageHeader::current_magic,
+        .version = CachedImageHeader::current_version,
+        .storage = static_cast<uint32_t>(luisa::to_underlying(image.pixel_storage())),
+        .width = image.size().x,
+        .height = image.size().y,
+        .key = key};
+    // written under a unique name and renamed, so that concurrent processes
+    // never read a partially written entry
+    std::random_device random;
+    auto temp_path = path;
+    temp_path += luisa::format(".{:08x}{:08x}.tmp", random(), random());
+    auto written = [&] {
+        std::ofstream file{temp_path, std::ios::binary};
+        return file &&
+               file.write(reinterpret_cast<const char *>(&header), sizeof(header)) &&
+               file.write(static_cast<const char *>(image.pixels()), static_cast<std::streamsize>(image.size_bytes()));
+    }();
+    std::error_code ec;
+    if (written) { std::filesystem::rename(temp_path, path, ec); }
+    if (!written || ec) [[unlikely]] {
+        std::filesystem::remove(temp_path, ec);
+        LUISA_WARNING_WITH_LOCATION(
+            "Failed to write image cache entry '{}'.",
+            path.string());
+    }
+}
+
+// removes the least recently used entries until the entries in `directory`
+// fit in `capacity` bytes; other files in the directory are left alone
+static void evict_cached_images(const std::filesystem::path &directory, size_t capacity) noexcept {
+    struct Entry {
+        std::filesystem::path path;
+        std::filesystem::file_time_type last_use;
+        size_t size;
+    };
+    std::scoped_lock lock{image_cache_state().eviction_mutex};
+    luisa::vector<Entry> entries;
+    auto total = static_cast<size_t>(0u);
+    std::error_code ec;
+    for (auto &&file : std::filesystem::directory_iterator{directory, ec}) {
+        if (file.path().extension() != ".image" || !file.is_regular_file(ec)) { continue; }
+        auto size = static_cast<size_t>(file.file_size(ec));
+        if (ec) { continue; }
+        auto last_use = file.last_write_time(ec);
+        if (ec) { continue; }
+        entries.emplace_back(Entry{file.path(), last_use, size});
+        total += size;
+    }
+    if (total <= capacity) { return; }
+    std::sort(entries.begin(), entries.end(), [](auto &&lhs, auto &&rhs) noexcept {
+        return lhs.last_use < rhs.last_use;
+    });
+    auto evicted = 0u;
+    for (auto &&e : entries) {
+        if (total <= capacity) { break; }
+        if (std::filesystem::remove(e.path, ec)) {
+            total -= e.size;
+            evicted++;
+        }
+    }
+    LUISA_INFO(
+        "Evicted {} image cache entry(s) from '{}' "
+        "({} MiB left).",
+        evicted, directory.string(), total >> 20u);
+}
+
+}// namespace detail
+
+void ImageCache::set_disk_cache(std::filesystem::path directory, size_t capacity) noexcept {
+    if (!directory.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+        if (ec) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Failed to create image cache directory '{}': {}. "
+                "The disk cache is disabled.",
+                directory.string(), ec.message());
+            directory.clear();
+        }
+    }
+    auto &state = detail::image_cache_state();
+    std::scoped_lock lock{state.mutex};
+    state.disk_directory = std::move(directory);
+    state.disk_capacity = capacity;
+}
+
+std::shared_future<LoadedImage> ImageCache::load_persistent(
+    const std::filesystem::path &path, luisa::string_view parameters,
+    luisa::function<LoadedImage()> loader) noexcept {
+    auto parameter_hash = detail::image_cache_hash(parameters.data(), parameters.size(), Hash64::default_seed);
+    auto entry = _find_or_create(path, parameters, [&](luisa::optional<uint64_t> content_key) noexcept -> luisa::shared_ptr<void> {
+        auto &&state = detail::image_cache_state();
+        // the content is hashed by the task unless deduplication already did
+        return luisa::make_shared<std::shared_future<LoadedImage>>(ThreadPool::global().async(
+            [loader = std::move(loader), directory = state.disk_directory, capacity = state.disk_capacity,
+             content_key, parameter_hash, path = std::filesystem::path{path}] {
+                if (directory.empty()) { return loader(); }
+                Clock clock;
+                auto key = content_key ? content_key : detail::image_content_hash(path, parameter_hash);
+                if (!key) { return loader(); }
+                auto cache_file = directory / luisa::format("{:016x}.image", *key);
+                if (auto image = detail::read_cached_image(cache_file, *key)) {
+                    LUISA_INFO(
+                        "Loaded '{}' from image cache entry '{}' in {} ms.",
+                        path.string(), cache_file.string(), clock.toc());
+                    return image;
+                }
+                auto image = loader();
+                detail::write_cached_image(cache_file, *key, image);
+                detail::evict_cached_images(directory, capacity);
+                return image;
+            }));
+    });
+    return *static_cast<const std::shared_future<LoadedImage> *>(entry.get());
+}
+
+luisa::shared_ptr<void> ImageCache::_find_or_create(
+    const std::filesystem::path &path, luisa::string_view parameters,
+    const luisa::function<luisa::shared_ptr<void>(luisa::optional<uint64_t>)> &create) noexcept {
+
+    std::error_code ec;
+    auto canonical_path = std::filesystem::canonical(path, ec);
+    if (ec) { canonical_path = std::filesystem::absolute(path); }
+    auto file_size = std::filesystem::file_size(canonical_path, ec);
+    auto modified = ec ? 0 : std::filesystem::last_write_time(canonical_path, ec).time_since_epoch().count();
+    auto parameter_hash = detail::image_cache_hash(parameters.data(), parameters.size(), Hash64::default_seed);
+    auto file_key = [&] {
+        auto name = canonical_path.string();
+        auto hash = detail::image_cache_hash(name.data(), name.size(), parameter_hash);
+        hash = detail::image_cache_hash(&file_size, sizeof(file_size), hash);
+        return detail::image_cache_hash(&modified, sizeof(modified), hash);
+    }();
+
+    auto size_key = detail::image_cache_hash(&file_size, sizeof(file_size), parameter_hash);
+
+    // the first file of a size is not hashed, as it cannot have a duplicate yet
+    auto &state = detail::image_cache_state();
+    luisa::vector<std::pair<std::filesystem::path, luisa::shared_ptr<void>>> unhashed;
+    {
+        std::scoped_lock lock{state.mutex};
+        if (auto iter = state.by_file.find(file_key); iter != state.by_file.end()) {
+            return iter->second;
+        }
+        auto [iter, first] = state.by_size.try_emplace(size_key);
+        if (first) {
+            auto entry = create(luisa::nullopt);
+            state.by_file.emplace(file_key, entry);
+            iter->second.emplace_back(canonical_path, entry);
+            return entry;
+        }
+        unhashed = std::move(iter->second);
+        iter->second.clear();
+    }
+
+    // hash this file and the earlier ones of the same size outside the lock
+    auto content_key = detail::image_content_hash(canonical_path, parameter_hash);
+    luisa::vector<std::pair<uint64_t, luisa::shared_ptr<void>>> hashed;
+    hashed.reserve(unhashed.size());
+    for (auto &&[p, e] : unhashed) {
+        if (auto key = detail::image_content_hash(p, parameter_hash)) {
+            hashed.emplace_back(*key, std::move(e));
+        }
+    }
+
+    std::scoped_lock lock{state.mutex};
+    for (auto &&[key, e] : hashed) { state.by_content.try_emplace(key, std::move(e)); }
+    if (auto iter = state.by_file.find(file_key); iter != state.by_file.end()) {
+        return iter->second;
+    }
+    if (content_key) {
+        if (auto iter = state.by_content.find(*content_key); iter != state.by_content.end()) {
+            LUISA_INFO(
+                "Sharing cached image with identical content for '{}'.",
+                canonical_path.string());
+            return state.by_file.emplace(file_key, iter->second).first->second;
+        }
+    }
+    auto entry = create(content_key);
+    state.by_file.emplace(file_key, entry);
+    if (content_key) { state.by_content.emplace(*content_key, entry); }
+    return entry;
+}
+
+}// namespace luisa::render
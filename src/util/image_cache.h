@@ -0,0 +1,61 @@
+#pragma once
+
+#include <future>
+#include <filesystem>
+
+#include <core/stl.h>
+#include <core/thread_pool.h>
+#include <util/imageio.h>
+
+namespace luisa::render {
+
+// Process-wide cache of decoded (and converted) images, so that texture nodes
+// referring to the same file with the same decode parameters share a single
+// result. Entries are found by canonical path, size and modification time of
+// the file and, failing that, by the hash of its content, so that copies of
+// a file under different names are shared as well. Contents are only hashed
+// once a second file of the same size is loaded with the same parameters.
+// Entries are kept for the lifetime of the process; edited files get new
+// entries.
+//
+// Images loaded with load_persistent() are additionally stored in a disk
+// cache (if enabled with set_disk_cache()) under the hash of the file content
+// and the parameters, so that later runs read back the converted pixels
+// instead of decoding and converting the file again. The least recently used
+// entries are evicted whenever the cache grows beyond its capacity.
+class ImageCache {
+
+private:
+    // `create` is called with the cache locked and receives the content key
+    // of the file, if it was hashed for deduplication and could be read
+    [[nodiscard]] static luisa::shared_ptr<void> _find_or_create(
+        const std::filesystem::path &path, luisa::string_view parameters,
+        const luisa::function<luisa::shared_ptr<void>(luisa::optional<uint64_t>)> &create) noexcept;
+
+public:
+    // `parameters` must identify both the decoding and the result type T,
+    // e.g., by starting with the plugin name; `loader` runs on the global
+    // thread pool and only if no entry matches
+    template<typename T>
+    [[nodiscard]] static std::shared_future<T> load(
+        const std::filesystem::path &path, luisa::string_view parameters,
+        luisa::function<T()> loader) noexcept {
+        auto entry = _find_or_create(path, parameters, [&loader](auto) noexcept -> luisa::shared_ptr<void> {
+            return luisa::make_shared<std::shared_future<T>>(
+                ThreadPool::global().async(std::move(loader)));
+        });
+        return *static_cast<const std::shared_future<T> *>(entry.get());
+    }
+
+    // like load(), but also goes through the disk cache; meant for results
+    // that are expensive to compute and cheap to read back
+    [[nodiscard]] static std::shared_future<LoadedImage> load_persistent(
+        const std::filesystem::path &path, luisa::string_view parameters,
+        luisa::function<LoadedImage()> loader) noexcept;
+
+    // an empty path disables the disk cache, which is the default;
+    // `capacity` bounds the total size of the entries in bytes
+    static void set_disk_cache(std::filesystem::path directory, size_t capacity) noexcept;
+};
+
+}// namespace luisa::render
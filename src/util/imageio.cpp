@@ -3,6 +3,8 @@
 //
 
 #include <array>
+#include <random>
+#include <fstream>
 
 #include <tinyexr.h>
 #include <stb/stb_image.h>
@@ -10,6 +12,7 @@
 #include <core/logging.h>
 #include <util/imageio.h>
 #include <util/half.h>
+#include <util/mapped_file.h>
 
 namespace luisa::render {
 
@@ -446,4 +449,46 @@ LoadedImage LoadedImage::load(const std::filesystem::path &path) noexcept {
     return {pixels, storage, make_uint2(width, height), stbi_image_free};
 }
 
+LoadedImage LoadedImage::create(uint2 resolution, LoadedImage::storage_type storage) noexcept {
+    auto size = static_cast<size_t>(resolution.x) * resolution.y * compute::pixel_storage_size(storage);
+    return {
+        luisa::allocate<std::byte>(size), storage, resolution,
+        [](void *p) noexcept {
+            luisa::deallocate(static_cast<std::byte *>(p));
+        }};
+}
+
+LoadedImage LoadedImage::spill(LoadedImage image, const std::filesystem::path &directory) noexcept {
+    if (!image) { return image; }
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    std::random_device random;
+    auto path = directory / luisa::format(
+                                "{:08x}{:08x}.pixels",
+                                random(), random());
+    auto written = [&] {
+        std::ofstream file{path, std::ios::binary};
+        return file && file.write(static_cast<const char *>(image.pixels()),
+                                  static_cast<std::streamsize>(image.size_bytes()));
+    }();
+    auto mapping = written ? MappedFile::open(path) : nullptr;
+    if (mapping == nullptr) [[unlikely]] {
+        std::filesystem::remove(path, ec);
+        LUISA_WARNING_WITH_LOCATION(
+            "Failed to spill {}x{} image to '{}'. "
+            "Keeping the pixels in memory.",
+            image.size().x, image.size().y, path.string());
+        return image;
+    }
+    auto pixels = const_cast<std::byte *>(mapping->data());
+    // shared by the copies of the deleter made when the image is moved
+    auto file = luisa::make_shared<luisa::unique_ptr<MappedFile>>(std::move(mapping));
+    return {pixels, image.pixel_storage(), image.size(),
+            [file = std::move(file), path = std::move(path)](void *) noexcept {
+                file->reset();
+                std::error_code ec;
+                std::filesystem::remove(path, ec);
+            }};
+}
+
 }// namespace luisa::render
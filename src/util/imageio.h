@@ -11,7 +11,7 @@
 
 namespace luisa::render {
 
-// TODO: texture cache
+// see ImageCache for sharing loaded images across texture nodes
 class LoadedImage {
 
 public:
@@ -65,6 +65,14 @@ public:
     [[nodiscard]] explicit operator bool() const noexcept { return _pixels != nullptr; }
     [[nodiscard]] static LoadedImage load(const std::filesystem::path &path) noexcept;
     [[nodiscard]] static LoadedImage load(const std::filesystem::path &path, storage_type storage) noexcept;
+    // allocates an image with uninitialized pixels, e.g., for generated content
+    [[nodiscard]] static LoadedImage create(uint2 resolution, storage_type storage) noexcept;
+    // moves the pixels into a new file under `directory` and returns an image
+    // backed by a read-only mapping of it, so that the pixels are paged in from
+    // disk on access and their memory can be reclaimed by the OS; the file is
+    // removed with the image. Returns `image` unchanged if the file cannot be
+    // written or mapped.
+    [[nodiscard]] static LoadedImage spill(LoadedImage image, const std::filesystem::path &directory) noexcept;
 };
 
 }// namespace luisa::render
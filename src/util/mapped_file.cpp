@@ -0,0 +1,106 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#include <core/logging.h>
+#include <util/mapped_file.h>
+
+namespace luisa::render {
+
+#ifdef _WIN32
+
+MappedFile::~MappedFile() noexcept {
+    if (_data != nullptr) { UnmapViewOfFile(_data); }
+    if (_mapping != nullptr) { CloseHandle(_mapping); }
+    if (_file != nullptr) { CloseHandle(_file); }
+}
+
+luisa::unique_ptr<MappedFile> MappedFile::open(const std::filesystem::path &path) noexcept {
+    auto file = luisa::make_unique<MappedFile>();
+    auto handle = CreateFileW(
+        path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Failed to open file '{}' for mapping (error = {}).",
+            path.string(), GetLastError());
+        return nullptr;
+    }
+    file->_file = handle;
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Cannot map empty or unreadable file '{}'.",
+            path.string());
+        return nullptr;
+    }
+    file->_size = static_cast<size_t>(size.QuadPart);
+    file->_mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (file->_mapping == nullptr) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Failed to create mapping for file '{}' (error = {}).",
+            path.string(), GetLastError());
+        return nullptr;
+    }
+    file->_data = static_cast<const std::byte *>(
+        MapViewOfFile(file->_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (file->_data == nullptr) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Failed to map file '{}' (error = {}).",
+            path.string(), GetLastError());
+        return nullptr;
+    }
+    return file;
+}
+
+#else
+
+MappedFile::~MappedFile() noexcept {
+    if (_data != nullptr) {
+        munmap(const_cast<std::byte *>(_data), _size);
+    }
+}
+
+luisa::unique_ptr<MappedFile> MappedFile::open(const std::filesystem::path &path) noexcept {
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Failed to open file '{}' for mapping: {}.",
+            path.string(), strerror(errno));
+        return nullptr;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Cannot map empty or unreadable file '{}'.",
+            path.string());
+        ::close(fd);
+        return nullptr;
+    }
+    auto size = static_cast<size_t>(st.st_size);
+    auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);// the mapping keeps its own reference to the file
+    if (data == MAP_FAILED) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "Failed to map file '{}': {}.",
+            path.string(), strerror(errno));
+        return nullptr;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+    auto file = luisa::make_unique<MappedFile>();
+    file->_data = static_cast<const std::byte *>(data);
+    file->_size = size;
+    return file;
+}
+
+#endif
+
+}// namespace luisa::render
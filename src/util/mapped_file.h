@@ -0,0 +1,40 @@
+#pragma once
+
+#include <filesystem>
+
+#include <core/stl.h>
+
+namespace luisa::render {
+
+// Read-only memory mapping of a whole file. Pages are faulted in lazily by
+// the OS and are backed by the file itself, so they can be evicted under
+// memory pressure instead of counting against anonymous host memory.
+class MappedFile {
+
+private:
+    const std::byte *_data{nullptr};
+    size_t _size{0u};
+#ifdef _WIN32
+    void *_file{nullptr};
+    void *_mapping{nullptr};
+#endif
+
+public:
+    // for internal use only; use MappedFile::open() instead
+    MappedFile() noexcept = default;
+    ~MappedFile() noexcept;
+    MappedFile(MappedFile &&) noexcept = delete;
+    MappedFile(const MappedFile &) noexcept = delete;
+    MappedFile &operator=(MappedFile &&) noexcept = delete;
+    MappedFile &operator=(const MappedFile &) noexcept = delete;
+    // returns nullptr (with a warning) if the file cannot be mapped
+    [[nodiscard]] static luisa::unique_ptr<MappedFile> open(const std::filesystem::path &path) noexcept;
+    [[nodiscard]] auto data() const noexcept { return _data; }
+    [[nodiscard]] auto size() const noexcept { return _size; }
+    template<typename T>
+    [[nodiscard]] auto view(size_t offset_bytes, size_t count) const noexcept {
+        return luisa::span{reinterpret_cast<const T *>(_data + offset_bytes), count};
+    }
+};
+
+}// namespace luisa::render
@@ -0,0 +1,136 @@
+#include <bit>
+#include <cmath>
+#include <array>
+#include <algorithm>
+
+#include <core/logging.h>
+#include <util/half.h>
+#include <util/parallel.h>
+#include <util/mipmap.h>
+
+namespace luisa::render {
+
+namespace detail {
+
+// averages each 2x2 block of `src` into `dst`; odd borders repeat the last texel
+template<typename T, typename Decode, typename Encode>
+void downsample_mip_level(const T *src, uint2 src_size, T *dst, uint2 dst_size,
+                          uint channels, const Decode &decode, const Encode &encode) noexcept {
+    parallel_for_with_caller(dst_size.y, [=](size_t y) noexcept {
+        auto y0 = std::min(static_cast<uint>(y) * 2u, src_size.y - 1u);
+        auto y1 = std::min(y0 + 1u, src_size.y - 1u);
+        for (auto x = 0u; x < dst_size.x; x++) {
+            auto x0 = std::min(x * 2u, src_size.x - 1u);
+            auto x1 = std::min(x0 + 1u, src_size.x - 1u);
+            for (auto c = 0u; c < channels; c++) {
+                auto texel = [&](auto px, auto py) noexcept {
+                    return decode(src[(static_cast<size_t>(py) * src_size.x + px) * channels + c], c);
+                };
+                auto sum = texel(x0, y0) + texel(x1, y0) + texel(x0, y1) + texel(x1, y1);
+                dst[(y * dst_size.x + x) * channels + c] = encode(0.25f * sum, c);
+            }
+        }
+    });
+}
+
+// byte values to linear through the sRGB transfer function
+[[nodiscard]] const std::array<float, 256u> &srgb_byte_to_linear_table() noexcept {
+    static auto table = [] {
+        std::array<float, 256u> t{};
+        for (auto i = 0u; i < t.size(); i++) {
+            auto x = static_cast<float>(i) * (1.0f / 255.0f);
+            t[i] = x <= 0.04045f ?
+                       x * (1.0f / 12.92f) :
+                       std::pow((x + 0.055f) * (1.0f / 1.055f), 2.4f);
+        }
+        return t;
+    }();
+    return table;
+}
+
+[[nodiscard]] inline float linear_to_srgb(float x) noexcept {
+    return x <= 0.0031308f ?
+               x * 12.92f :
+               1.055f * std::pow(x, 1.0f / 2.4f) - 0.055f;
+}
+
+}// namespace detail
+
+uint mip_level_count(uint2 resolution) noexcept {
+    return std::bit_width(std::max(std::max(resolution.x, resolution.y), 1u));
+}
+
+luisa::vector<LoadedImage> generate_mipmaps(const LoadedImage &image, MipmapEncoding encoding) noexcept {
+    using storage_type = LoadedImage::storage_type;
+    auto storage = image.pixel_storage();
+    auto channels = image.channels();
+    auto srgb = encoding == MipmapEncoding::SRGB;
+    if (srgb && storage != storage_type::BYTE1 &&
+        storage != storage_type::BYTE2 &&
+        storage != storage_type::BYTE4) [[unlikely]] {
+        LUISA_WARNING_WITH_LOCATION(
+            "sRGB mipmaps are only supported for BYTE storages. "
+            "Filtering pixel storage 0x{:02x} as linear.",
+            luisa::to_underlying(storage));
+        srgb = false;
+    }
+    // the last channel of two- and four-channel images is alpha
+    auto has_alpha = channels == 2u || channels == 4u;
+    auto downsample = [storage, channels, srgb, has_alpha](const LoadedImage &src, LoadedImage &dst) noexcept {
+        switch (storage) {
+            case storage_type::BYTE1:
+            case storage_type::BYTE2:
+            case storage_type::BYTE4: {
+                auto &&to_linear = detail::srgb_byte_to_linear_table();
+                auto is_color = [=](uint c) noexcept { return srgb && !(has_alpha && c == channels - 1u); };
+                detail::downsample_mip_level(
+                    static_cast<const uint8_t *>(src.pixels()), src.size(),
+                    static_cast<uint8_t *>(dst.pixels()), dst.size(), channels,
+                    [&](uint8_t v, uint c) noexcept { return is_color(c) ? to_linear[v] : static_cast<float>(v) * (1.0f / 255.0f); },
+                    [&](float v, uint c) noexcept {
+                        auto x = is_color(c) ? detail::linear_to_srgb(v) : v;
+                        return static_cast<uint8_t>(std::clamp(std::round(x * 255.0f), 0.0f, 255.0f));
+                    });
+                return true;
+            }
+            case storage_type::HALF1:
+            case storage_type::HALF2:
+            case storage_type::HALF4:
+                detail::downsample_mip_level(
+                    static_cast<const uint16_t *>(src.pixels()), src.size(),
+                    static_cast<uint16_t *>(dst.pixels()), dst.size(), channels,
+                    [](uint16_t v, uint) noexcept { return half_to_float(static_cast<uint>(v)); },
+                    [](float v, uint) noexcept { return static_cast<uint16_t>(float_to_half(v)); });
+                return true;
+            case storage_type::FLOAT1:
+            case storage_type::FLOAT2:
+            case storage_type::FLOAT4:
+                detail::downsample_mip_level(
+                    static_cast<const float *>(src.pixels()), src.size(),
+                    static_cast<float *>(dst.pixels()), dst.size(), channels,
+                    [](float v, uint) noexcept { return v; },
+                    [](float v, uint) noexcept { return v; });
+                return true;
+            default: break;
+        }
+        return false;
+    };
+    luisa::vector<LoadedImage> levels;
+    auto level_count = mip_level_count(image.size());
+    if (level_count > 1u) { levels.reserve(level_count - 1u); }
+    for (auto i = 1u; i < level_count; i++) {
+        auto &&src = i == 1u ? image : levels.back();
+        auto size = make_uint2(std::max(src.size().x / 2u, 1u), std::max(src.size().y / 2u, 1u));
+        auto dst = LoadedImage::create(size, storage);
+        if (!downsample(src, dst)) [[unlikely]] {
+            LUISA_WARNING_WITH_LOCATION(
+                "Mipmaps are not supported for pixel storage 0x{:02x}.",
+                luisa::to_underlying(storage));
+            return {};
+        }
+        levels.emplace_back(std::move(dst));
+    }
+    return levels;
+}
+
+}// namespace luisa::render
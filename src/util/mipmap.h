@@ -0,0 +1,32 @@
+#pragma once
+
+#include <core/stl.h>
+#include <util/imageio.h>
+
+namespace luisa::render {
+
+// An image with levels 1 and up of its mip chain, if it is mipmapped.
+struct MipmappedImage {
+    LoadedImage image;
+    luisa::vector<LoadedImage> levels;
+};
+
+// Number of levels in a full mip chain of the given resolution, including level 0.
+[[nodiscard]] uint mip_level_count(uint2 resolution) noexcept;
+
+// Transfer function of the texel values, which are box filtered in linear space.
+enum struct MipmapEncoding {
+    LINEAR,
+    SRGB// BYTE storages only; alpha channels are always linear
+};
+
+// Generates levels 1 and up of the mip chain of `image` by 2x2 box filtering,
+// with each level computed from the previous one in parallel over rows on the
+// global thread pool (safe to be called from inside a pool task). Only BYTE,
+// HALF and FLOAT storages are supported; for others, no levels are generated.
+// Textures whose texels are converted nonlinearly (e.g., to spectrum
+// coefficients) must generate the levels before the conversion.
+[[nodiscard]] luisa::vector<LoadedImage> generate_mipmaps(
+    const LoadedImage &image, MipmapEncoding encoding = MipmapEncoding::LINEAR) noexcept;
+
+}// namespace luisa::render
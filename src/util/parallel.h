@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <functional>
+
+#include <core/stl.h>
+#include <core/thread_pool.h>
+
+namespace luisa::render {
+
+// Runs body(i) for i in [0, n) on the global thread pool, with the calling
+// thread taking part in the work. Unlike waiting on nested futures, this
+// cannot deadlock when invoked from inside a pool task: the caller alone is
+// able to drain all items, and only waits for items already being executed.
+template<typename F>
+void parallel_for_with_caller(size_t n, F &&body) noexcept {
+    if (n == 0u) { return; }
+    struct State {
+        std::atomic<size_t> next{0u};
+        std::atomic<size_t> done{0u};
+        size_t count{};
+        std::function<void(size_t)> body;
+    };
+    auto state = luisa::make_shared<State>();
+    state->count = n;
+    state->body = std::forward<F>(body);
+    auto work = [state]() noexcept {
+        for (auto i = state->next.fetch_add(1u); i < state->count;
+             i = state->next.fetch_add(1u)) {
+            state->body(i);
+            state->done.fetch_add(1u, std::memory_order_release);
+        }
+    };
+    auto helper_count = std::min<size_t>(n - 1u, std::thread::hardware_concurrency());
+    for (auto i = 0u; i < helper_count; i++) { ThreadPool::global().async(work); }
+    work();
+    while (state->done.load(std::memory_order_acquire) < n) { std::this_thread::yield(); }
+}
+
+}// namespace luisa::render
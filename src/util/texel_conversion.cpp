@@ -0,0 +1,15 @@
+#include <util/texel_conversion.h>
+
+namespace luisa::render {
+
+const std::array<float, 65536u> &srgb_half_to_linear_table() noexcept {
+    static auto table = [] {
+        std::array<float, 65536u> t{};
+        SRGBTexelDecoder decoder{nullptr};
+        for (auto h = 0u; h < t.size(); h++) { t[h] = decoder(half_to_float(h), 0u); }
+        return t;
+    }();
+    return table;
+}
+
+}// namespace luisa::render
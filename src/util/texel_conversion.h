@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cmath>
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+#include <core/stl.h>
+#include <core/basic_types.h>
+#include <util/half.h>
+#include <util/imageio.h>
+#include <util/parallel.h>
+
+namespace luisa::render {
+
+// Decoders of image texture encodings to linear values. Each is callable on
+// float channels and on the raw bits of half channels, so that HALF4 images
+// can skip the half-to-float conversion where a lookup table does both.
+struct LinearTexelDecoder {
+    [[nodiscard]] float operator()(float x, uint) const noexcept { return x; }
+    [[nodiscard]] float operator()(uint16_t h, uint) const noexcept { return half_to_float(h); }
+};
+
+// the sRGB transfer function applied to all 2^16 half values
+[[nodiscard]] const std::array<float, 65536u> &srgb_half_to_linear_table() noexcept;
+
+struct SRGBTexelDecoder {
+    const float *table{srgb_half_to_linear_table().data()};
+    [[nodiscard]] float operator()(float x, uint) const noexcept {
+        return x <= 0.04045f ?
+                   x * (1.0f / 12.92f) :
+                   std::pow((x + 0.055f) * (1.0f / 1.055f), 2.4f);
+    }
+    [[nodiscard]] float operator()(uint16_t h, uint) const noexcept { return table[h]; }
+};
+
+struct GammaTexelDecoder {
+    float3 gamma;
+    [[nodiscard]] float operator()(float x, uint c) const noexcept { return std::pow(x, gamma[c]); }
+    [[nodiscard]] float operator()(uint16_t h, uint c) const noexcept { return (*this)(half_to_float(h), c); }
+};
+
+namespace detail {
+inline constexpr auto texel_conversion_chunk_rows = 32u;
+}// namespace detail
+
+// Number of row chunks convert_texels() splits `image` into.
+[[nodiscard]] inline size_t texel_conversion_chunk_count(const LoadedImage &image) noexcept {
+    return (image.size().y + detail::texel_conversion_chunk_rows - 1u) /
+           detail::texel_conversion_chunk_rows;
+}
+
+// Converts the pixels of a HALF4 or FLOAT4 image in place, with chunks of
+// rows processed in parallel on the global thread pool (safe to be called
+// from inside a pool task). The first three channels are mapped to linear
+// by `decode`, and `convert(float3 linear, float alpha, size_t chunk)` returns
+// the new pixel. Both are inlined into the loops instead of being called
+// through luisa::function, which lets the compiler vectorize the simple ones.
+template<typename Decode, typename Convert>
+void convert_texels(LoadedImage &image, const Decode &decode, const Convert &convert) noexcept {
+    auto width = static_cast<size_t>(image.size().x);
+    auto height = static_cast<size_t>(image.size().y);
+    auto half = image.pixel_storage() == compute::PixelStorage::HALF4;
+    parallel_for_with_caller(texel_conversion_chunk_count(image), [&](size_t chunk) noexcept {
+        auto begin = chunk * detail::texel_conversion_chunk_rows * width;
+        auto end = std::min(chunk * detail::texel_conversion_chunk_rows + detail::texel_conversion_chunk_rows, height) * width;
+        if (half) {
+            auto pixels = static_cast<std::array<uint16_t, 4u> *>(image.pixels());
+            for (auto i = begin; i < end; i++) {
+                auto &&p = pixels[i];
+                auto linear = make_float3(decode(p[0], 0u), decode(p[1], 1u), decode(p[2], 2u));
+                auto q = convert(linear, half_to_float(p[3]), chunk);
+                p = {static_cast<uint16_t>(float_to_half(q.x)), static_cast<uint16_t>(float_to_half(q.y)),
+                     static_cast<uint16_t>(float_to_half(q.z)), static_cast<uint16_t>(float_to_half(q.w))};
+            }
+        } else {
+            auto pixels = static_cast<float4 *>(image.pixels());
+            for (auto i = begin; i < end; i++) {
+                auto p = pixels[i];
+                auto linear = make_float3(decode(p.x, 0u), decode(p.y, 1u), decode(p.z, 2u));
+                pixels[i] = convert(linear, p.w, chunk);
+            }
+        }
+    });
+}
+
+}// namespace luisa::render